@@ -18,6 +18,12 @@
    are allocated. However, the parent thread deallocates a result block 
    previously allocated by a child thread, consistent with 
    https://man7.org/linux/man-pages/man3/pthread_create.3.html
+
+   Each thread fills its segment of the array with a counter-based
+   random number generator, where the i-th number is a function of the seed
+   and i, so that the data is independent of the number of threads.
+   The summation loop of each thread is timed with the calibrated cycle
+   counter, and the parallel section is timed with the monotonic clock.
 */
 
 #define _XOPEN_SOURCE 600
@@ -28,9 +34,8 @@
 #include <pthread.h>
 #include "utilities-mem.h"
 #include "utilities-pthread.h"
-
-#define DRAND_SEED() do{srand48(time(NULL));}while (0)
-#define DRAND() (drand48()) /* basic Linux random number generator */
+#include "utilities-time.h"
+#include "utilities-rand.h"
 
 const char *C_USAGE = "usage: ./avg count num_threads";
 
@@ -38,28 +43,39 @@ typedef struct{
   int id;
   int start;
   int count;
+  uint64_t seed; /* key of the counter-based random number stream */
   double *data; /* pointer to parent data */
+  const tsc_cal_t *cal; /* pointer to parent cycle counter calibration */
 } sum_arg_t;
 
 typedef struct{
   double sum;
+  uint64_t cycles; /* overhead-corrected cycles of the summation loop */
 } sum_res_t;
 
 void *sum_thread(void *arg){
   int i;
+  uint64_t start;
   sum_arg_t *a = arg;
   sum_res_t *r = NULL;
   r = malloc_perror(1, sizeof(sum_res_t));
   r->sum = 0.0;
+  for (i = a->start; i < a->start + a->count; i++){
+    a->data[i] = rng_ctr_unif(a->seed, i);
+  }
   printf("sum thread %d running, starting at %d for %d\n",
 	 a->id,
 	 a->start,
 	 a->count);
   fflush(stdout);
+  start = tsc_start();
   for (i = a->start; i < a->start + a->count; i++){
     r->sum += a->data[i];
   }
-  printf("sum thread %d done, returning\n", a->id);
+  r->cycles = tsc_elapsed(a->cal, start, tsc_end());
+  printf("sum thread %d done in %.0f ns, returning\n",
+	 a->id,
+	 tsc_to_ns(a->cal, r->cycles));
   fflush(stdout);
   return r;
 }
@@ -69,14 +85,16 @@ int main(int argc, char **argv){
   int count, seg_count, rem_count;
   int num_threads;
   int start = 0;
+  uint64_t seed = time(NULL);
+  uint64_t start_ns, end_ns;
   double sum = 0.0;
   double *data = NULL; /* parent data block */
   pthread_t *sids = NULL;
   sum_arg_t *sas = NULL;
   sum_res_t *sr = NULL;
+  tsc_cal_t cal;
 
   /* input checking and initialization */
-  DRAND_SEED();
   if (argc < 3){
     fprintf(stderr,"must specify count and number of threads\n%s\n",
 	    C_USAGE);
@@ -90,16 +108,15 @@ int main(int argc, char **argv){
   }
   sids = malloc_perror(num_threads, sizeof(pthread_t));
   sas = malloc_perror(num_threads, sizeof(sum_arg_t));
-  data = malloc_perror(count, sizeof(double));
-  for (i = 0; i < count; i++){
-    data[i] = DRAND();
-  }
+  data = malloc_perror(count, sizeof(double)); /* filled by sum threads */
   seg_count = count / num_threads;
   rem_count = count % num_threads; /* to distribute among threads */
+  tsc_calibrate(&cal);
 
   /* spawn threads */
   printf("main thread about to create %d sum threads\n", num_threads);
   fflush(stdout);
+  start_ns = time_mono_ns_perror();
   for (i = 0; i < num_threads; i++){
     sas[i].id = i;
     sas[i].count = seg_count;
@@ -108,7 +125,9 @@ int main(int argc, char **argv){
       rem_count--;
     }
     sas[i].start = start;
+    sas[i].seed = seed;
     sas[i].data = data;
+    sas[i].cal = &cal;
     printf("main thread creating sum thread %d\n", i);
     fflush(stdout);
     thread_create_perror(&sids[i], sum_thread, &sas[i]);
@@ -128,6 +147,9 @@ int main(int argc, char **argv){
     free(sr); /* result block allocated by a child thread */
     sr = NULL;
   }
+  end_ns = time_mono_ns_perror();
+  printf("spawning, filling, summing, and joining took %.6f sec\n",
+	 (end_ns - start_ns) / 1e9);
   printf("the average over %d random numbers on [0.0 ,1.0) is %f\n",
 	 count, (double)sum / count);
   free(sids);
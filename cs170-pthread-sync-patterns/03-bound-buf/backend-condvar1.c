@@ -0,0 +1,455 @@
+/**
+   backend-condvar1.c
+
+   A bound-buf backend that synchronizes by using mutex locks and condition
+   variables for the queue, the latter to reduce while loop polling in time
+   slices, adopted from bound-buf-condvar1.c. A client polls the completion
+   flag of its order. The condition variable queue is shared with the
+   condvar2 and latch backends.
+
+   The queue counts the threads waiting on each condition variable and
+   signals only if a thread is waiting, so that an enqueue or dequeue
+   without contention does not enter the kernel. Testing for an
+   empty-to-non-empty or full-to-not-full transition alone is not
+   sufficient, because a signaled waiter may not yet have reacquired the
+   lock when a next order is queued or dequeued.
+
+   In the inline mode, the queue copies order records into
+   cache-line-aligned slots at enqueue, so that a trader reads an order
+   from a slot that is owned by the queue, instead of following a
+   pointer to an order that was last written by a client on another
+   core. A trader prefetches the slot of the next queued order, if any.
+
+   A trader waits on an empty queue according to the wait strategy of the
+   queue, by polling head and tail without locking before blocking on
+   cond_nempty. The time spent in the spin, yield, and block phases, and
+   the number of dequeues that ended in each phase, are printed by
+   queue_cond_print.
+
+   An order that arrives at a full queue is admitted according to the
+   admission policy of the queue. In the CoDel policy, a trader measures
+   the queuing delay of a dequeued order from its (intended) send time.
+   If the delay stays above target_ns for interval_ns, the queue enters a
+   rejecting state, in which arriving orders are rejected until a
+   dequeued order is below target_ns or the queue drains. In contrast to
+   the control law of CoDel, which spaces drops for senders that back off,
+   all arrivals are rejected, because an open-loop client does not reduce
+   its rate on a rejection. Orders are rejected at enqueue instead of
+   being dropped at dequeue, because a client waits for the fulfillment
+   of each queued order. An order with a deadline waits for a full queue
+   at most until its deadline. A nonblocking enqueue applies the same
+   policy at a full queue, with the timed admission timed out from the
+   send time of the order, and leaves the retry of an order that would
+   wait to the caller.
+*/
+
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <sched.h>
+#include <pthread.h>
+#include "bound-buf.h"
+#include "utilities-mem.h"
+#include "utilities-pthread.h"
+#include "utilities-time.h"
+
+#define CACHE_LINE (64) /* used as int */
+
+static const double C_NS_PER_MS = 1000000.0;
+
+typedef union{
+  order_rec_t rec;
+  char line[CACHE_LINE];
+} order_slot_t;
+
+typedef enum{WAIT_SPIN, WAIT_YIELD, WAIT_BLOCK, WAIT_NUM_PHASES} wait_phase_t;
+
+typedef struct{
+  int count; /* count - 1 is fixed count of the queue -> bounded buffer */
+  int head; /* written under lock; read atomically when polling */
+  int tail; /* written under lock; read atomically when polling */
+  boolean_t done; /* written under lock; read atomically when polling */
+  wait_strategy_t ws;
+  admit_t admit;
+  order_t **orders; /* NULL in the inline mode */
+  order_slot_t *slots; /* NULL in the pointer mode */
+  pthread_mutex_t lock;
+  pthread_cond_t cond_nfull;
+  pthread_cond_t cond_nempty;
+  int num_wait_nfull; /* clients waiting on cond_nfull */
+  int num_wait_nempty; /* traders waiting on cond_nempty */
+  unsigned long num_signals; /* issued */
+  unsigned long num_signals_skipped; /* not issued without waiters */
+  uint64_t wait_ns[WAIT_NUM_PHASES]; /* accumulated under lock */
+  unsigned long num_waits[WAIT_NUM_PHASES]; /* dequeues ended in phase */
+  uint64_t first_above_ns; /* CoDel: end of the interval above target */
+  boolean_t rejecting; /* CoDel: delay above target for the interval */
+  unsigned long num_rejecting; /* CoDel: rejecting states entered */
+} order_q_t;
+
+/**
+   Signals cond if a thread is waiting on cond, and counts the issued and
+   skipped signals. Requires holding the lock of the queue.
+*/
+static void signal_waiter(order_q_t *q, pthread_cond_t *cond, int num_wait){
+  if (num_wait > 0){
+    cond_signal_perror(cond);
+    q->num_signals++;
+  }else{
+    q->num_signals_skipped++;
+  }
+}
+
+/**
+   Returns TRUE if the queue is non-empty or done, without locking.
+*/
+static boolean_t poll_nempty(order_q_t *q){
+  return (__atomic_load_n(&q->head, __ATOMIC_RELAXED) !=
+	  __atomic_load_n(&q->tail, __ATOMIC_RELAXED) ||
+	  __atomic_load_n(&q->done, __ATOMIC_RELAXED));
+}
+
+/**
+   Polls an empty queue in the spin and yield phases of the wait strategy,
+   and adds the time of each phase to wait_ns. Returns the phase in which
+   the queue was found non-empty or done, or WAIT_BLOCK.
+*/
+static wait_phase_t wait_poll(order_q_t *q, uint64_t *wait_ns){
+  int i;
+  uint64_t start, end;
+  wait_phase_t phase = WAIT_BLOCK;
+  start = time_mono_ns_perror();
+  for (i = 0; i < q->ws.num_spins; i++){
+    if (poll_nempty(q)){
+      phase = WAIT_SPIN;
+      break;
+    }
+    cpu_pause();
+  }
+  end = time_mono_ns_perror();
+  wait_ns[WAIT_SPIN] += end - start;
+  if (phase != WAIT_BLOCK) return phase;
+  start = end;
+  for (i = 0; i < q->ws.num_yields; i++){
+    if (poll_nempty(q)){
+      phase = WAIT_YIELD;
+      break;
+    }
+    sched_yield();
+  }
+  end = time_mono_ns_perror();
+  wait_ns[WAIT_YIELD] += end - start;
+  return phase;
+}
+
+/**
+   Adds the wait times and the end phase of a dequeue to the statistics of
+   the queue. Requires holding the lock of the queue.
+*/
+static void wait_add(order_q_t *q,
+		     const uint64_t *wait_ns,
+		     wait_phase_t phase){
+  int i;
+  for (i = 0; i < WAIT_NUM_PHASES; i++){
+    q->wait_ns[i] += wait_ns[i];
+  }
+  q->num_waits[phase]++;
+}
+
+/**
+   Signals cond for each of n queued or dequeued orders while a thread is
+   waiting on cond, and counts the issued and skipped signals. Requires
+   holding the lock of the queue.
+*/
+static void signal_waiters(order_q_t *q,
+			   pthread_cond_t *cond,
+			   int num_wait,
+			   int n){
+  int i;
+  for (i = 0; i < n; i++){
+    signal_waiter(q, cond, num_wait - i);
+  }
+}
+
+/**
+   Updates the CoDel state with the queuing delay of a dequeued order at
+   now_ns. Requires holding the lock of the queue.
+*/
+static void codel_update(order_q_t *q, uint64_t delay_ns, uint64_t now_ns){
+  if (delay_ns < q->admit.target_ns || q->head == q->tail){
+    /* below target, or the queue drained */
+    q->first_above_ns = 0;
+    q->rejecting = FALSE;
+  }else if (q->first_above_ns == 0){
+    q->first_above_ns = now_ns + q->admit.interval_ns;
+  }else if (!q->rejecting && now_ns >= q->first_above_ns){
+    q->rejecting = TRUE;
+    q->num_rejecting++;
+  }
+}
+
+static order_q_t *queue_cond_init(const queue_conf_t *conf,
+				  boolean_t inline_slots){
+  order_q_t *q = NULL;
+  q = malloc_perror(1, sizeof(order_q_t));
+  memset(q, 0, sizeof(order_q_t)); /* head = 0 and tail = 0 */
+  q->count = conf->count + 1; /* + 1 due to fifo queue implementation */
+  q->done = FALSE;
+  q->ws = conf->ws;
+  q->admit = conf->admit;
+  q->rejecting = FALSE;
+  if (inline_slots){
+    q->slots = malloc_align_perror(CACHE_LINE, q->count, sizeof(order_slot_t));
+  }else{
+    q->orders = calloc_perror(q->count, sizeof(order_t *));
+  }
+  mutex_init_perror(&q->lock);
+  cond_init_mono_perror(&q->cond_nfull); /* timed admission */
+  cond_init_perror(&q->cond_nempty);
+  return q;
+}
+
+/**
+   Condition variable queue, shared by the condvar1, condvar2, and latch
+   backends.
+*/
+
+void *queue_cond_new(const queue_conf_t *conf){
+  return queue_cond_init(conf, FALSE);
+}
+
+void *queue_cond_new_inline(const queue_conf_t *conf){
+  return queue_cond_init(conf, TRUE);
+}
+
+/**
+   Queues an order at next, the slot after the tail, and signals a waiting
+   trader. Requires holding the lock of the queue.
+*/
+static void queue_cond_put(order_q_t *q, order_t *order, int next){
+  if (q->slots != NULL){
+    order_rec_set(&q->slots[next].rec, order);
+  }else{
+    q->orders[next] = order;
+  }
+  __atomic_store_n(&q->tail, next, __ATOMIC_RELAXED);
+  signal_waiter(q, &q->cond_nempty, q->num_wait_nempty);
+}
+
+boolean_t queue_cond_enqueue(void *queue, order_t *order){
+  int next;
+  boolean_t timed_out = FALSE;
+  uint64_t deadline_ns = 0;
+  uint64_t timeout_ns;
+  order_q_t *q = queue;
+  mutex_lock_perror(&q->lock);
+  if (q->admit.policy == ADMIT_CODEL && q->rejecting){
+    mutex_unlock_perror(&q->lock);
+    return FALSE;
+  }
+  next = (q->tail + 1) % q->count;
+  while (next == q->head){
+    /* queue is full; reject the order by the admission policy, or wait
+       for cond_nfull signal and retest because "at least one" waiting
+       thread is unblocked */
+    if (q->admit.policy == ADMIT_FAIL || timed_out){
+      mutex_unlock_perror(&q->lock);
+      return FALSE;
+    }
+    q->num_wait_nfull++;
+    if (q->admit.policy == ADMIT_TIMED || order->deadline_ns > 0){
+      if (deadline_ns == 0){
+	/* the earlier of the admission timeout and the order deadline */
+	deadline_ns = order->deadline_ns;
+	if (q->admit.policy == ADMIT_TIMED){
+	  timeout_ns = time_mono_ns_perror() + q->admit.timeout_ns;
+	  if (deadline_ns == 0 || timeout_ns < deadline_ns){
+	    deadline_ns = timeout_ns;
+	  }
+	}
+      }
+      timed_out = (cond_timedwait_mono_perror(&q->cond_nfull,
+					      &q->lock,
+					      deadline_ns) != 0);
+    }else{
+      cond_wait_perror(&q->cond_nfull, &q->lock);
+    }
+    q->num_wait_nfull--;
+    next = (q->tail + 1) % q->count;
+  }
+  /* queue is not full; queue the order and unlock mutex */
+  queue_cond_put(q, order, next);
+  mutex_unlock_perror(&q->lock);
+  return TRUE;
+}
+
+enqueue_t queue_cond_try_enqueue(void *queue, order_t *order){
+  int next;
+  uint64_t now_ns;
+  enqueue_t ret = ENQUEUE_QUEUED;
+  order_q_t *q = queue;
+  mutex_lock_perror(&q->lock);
+  next = (q->tail + 1) % q->count;
+  if (q->admit.policy == ADMIT_CODEL && q->rejecting){
+    ret = ENQUEUE_REJECTED;
+  }else if (next == q->head){
+    /* queue is full; reject the order by the admission policy, or leave
+       the retry to the caller instead of waiting */
+    now_ns = time_mono_ns_perror();
+    if (q->admit.policy == ADMIT_FAIL ||
+	(q->admit.policy == ADMIT_TIMED &&
+	 now_ns >= order->start_ns + q->admit.timeout_ns) ||
+	(order->deadline_ns > 0 && now_ns >= order->deadline_ns)){
+      ret = ENQUEUE_REJECTED;
+    }else{
+      ret = ENQUEUE_FULL;
+    }
+  }else{
+    queue_cond_put(q, order, next);
+  }
+  mutex_unlock_perror(&q->lock);
+  return ret;
+}
+
+void queue_cond_enqueue_batch(void *queue, order_t *orders, int n){
+  int i = 0;
+  int k, next;
+  order_q_t *q = queue;
+  mutex_lock_perror(&q->lock);
+  while (i < n){
+    next = (q->tail + 1) % q->count;
+    while (next == q->head){
+      q->num_wait_nfull++;
+      cond_wait_perror(&q->cond_nfull, &q->lock);
+      q->num_wait_nfull--;
+      next = (q->tail + 1) % q->count;
+    }
+    /* queue as many orders as fit */
+    for (k = 0; i < n && next != q->head; k++, i++){
+      if (q->slots != NULL){
+	order_rec_set(&q->slots[next].rec, &orders[i]);
+      }else{
+	q->orders[next] = &orders[i];
+      }
+      __atomic_store_n(&q->tail, next, __ATOMIC_RELAXED);
+      next = (q->tail + 1) % q->count;
+    }
+    signal_waiters(q, &q->cond_nempty, q->num_wait_nempty, k);
+  }
+  mutex_unlock_perror(&q->lock);
+}
+
+boolean_t queue_cond_dequeue(void *queue, order_rec_t *rec){
+  int next;
+  boolean_t waited = FALSE;
+  uint64_t now_ns, start_ns;
+  uint64_t block_start = 0;
+  uint64_t wait_ns[WAIT_NUM_PHASES] = {0, 0, 0};
+  wait_phase_t phase = WAIT_BLOCK;
+  order_t *order = NULL;
+  order_q_t *q = queue;
+  if ((q->ws.num_spins > 0 || q->ws.num_yields > 0) && !poll_nempty(q)){
+    waited = TRUE;
+    phase = wait_poll(q, wait_ns);
+  }
+  mutex_lock_perror(&q->lock);
+  while (q->head == q->tail && !q->done){
+    if (block_start == 0) block_start = time_mono_ns_perror();
+    waited = TRUE;
+    phase = WAIT_BLOCK;
+    q->num_wait_nempty++;
+    cond_wait_perror(&q->cond_nempty, &q->lock);
+    q->num_wait_nempty--;
+  }
+  if (block_start > 0){
+    wait_ns[WAIT_BLOCK] = time_mono_ns_perror() - block_start;
+  }
+  if (waited) wait_add(q, wait_ns, phase);
+  if (q->head == q->tail){
+    /* done; blocked traders were unblocked by queue_cond_done */
+    mutex_unlock_perror(&q->lock);
+    return FALSE;
+  }
+  next = (q->head + 1) % q->count;
+  if (q->slots != NULL){
+    *rec = q->slots[next].rec;
+    if (next != q->tail){
+      __builtin_prefetch(&q->slots[(next + 1) % q->count], 0);
+    }
+    start_ns = rec->start_ns;
+  }else{
+    order = q->orders[next];
+    start_ns = order->start_ns;
+  }
+  __atomic_store_n(&q->head, next, __ATOMIC_RELAXED);
+  if (q->admit.policy == ADMIT_CODEL){
+    now_ns = time_mono_ns_perror();
+    codel_update(q, (now_ns > start_ns) ? now_ns - start_ns : 0, now_ns);
+  }
+  signal_waiter(q, &q->cond_nfull, q->num_wait_nfull);
+  mutex_unlock_perror(&q->lock);
+  if (order != NULL) order_rec_set(rec, order);
+  return TRUE;
+}
+
+void queue_cond_done(void *queue){
+  order_q_t *q = queue;
+  /* unblock all blocked trader threads at once */
+  mutex_lock_perror(&q->lock);
+  __atomic_store_n(&q->done, TRUE, __ATOMIC_RELAXED);
+  if (q->num_wait_nempty > 0){
+    cond_broadcast_perror(&q->cond_nempty);
+    q->num_signals++;
+  }
+  mutex_unlock_perror(&q->lock);
+}
+
+int queue_cond_length(void *queue){
+  order_q_t *q = queue;
+  return (__atomic_load_n(&q->tail, __ATOMIC_RELAXED) -
+	  __atomic_load_n(&q->head, __ATOMIC_RELAXED) +
+	  q->count) % q->count;
+}
+
+void queue_cond_print(void *queue){
+  order_q_t *q = queue;
+  printf("queue: %lu signals issued, %lu skipped without waiters\n",
+	 q->num_signals, q->num_signals_skipped);
+  printf("trader wait (ms, dequeues): spin %.3f, %lu; yield %.3f, %lu; "
+	 "block %.3f, %lu\n",
+	 q->wait_ns[WAIT_SPIN] / C_NS_PER_MS, q->num_waits[WAIT_SPIN],
+	 q->wait_ns[WAIT_YIELD] / C_NS_PER_MS, q->num_waits[WAIT_YIELD],
+	 q->wait_ns[WAIT_BLOCK] / C_NS_PER_MS, q->num_waits[WAIT_BLOCK]);
+  if (q->admit.policy == ADMIT_CODEL){
+    printf("queue: %lu codel rejecting states\n", q->num_rejecting);
+  }
+}
+
+void queue_cond_free(void *queue){
+  order_q_t *q = queue;
+  free(q->orders);
+  free(q->slots);
+  q->orders = NULL;
+  q->slots = NULL;
+  free(q);
+}
+
+const backend_t C_BACKEND_CONDVAR1 = {"condvar1",
+				      sizeof(order_t),
+				      TRUE,
+				      queue_cond_new,
+				      queue_cond_enqueue,
+				      queue_cond_try_enqueue,
+				      queue_cond_enqueue_batch,
+				      queue_cond_dequeue,
+				      queue_cond_done,
+				      queue_cond_length,
+				      queue_cond_free,
+				      queue_cond_print,
+				      order_poll_init,
+				      order_poll_wait,
+				      order_poll_fulfill,
+				      order_poll_free};
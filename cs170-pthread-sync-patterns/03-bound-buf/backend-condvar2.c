@@ -0,0 +1,73 @@
+/**
+   backend-condvar2.c
+
+   A bound-buf backend that synchronizes by using mutex locks and
+   additional condition variables, adopted from bound-buf-condvar2.c. The
+   queue is the condition variable queue of the condvar1 backend, and a
+   client waits on a condition variable of its order instead of polling.
+*/
+
+#define _XOPEN_SOURCE 600
+
+#include <pthread.h>
+#include "bound-buf.h"
+#include "utilities-pthread.h"
+
+/**
+   An order followed by the completion state of the backend. order is
+   the first member, so that an order of the backend is its order_t
+   converted by a cast.
+*/
+typedef struct{
+  order_t order;
+  boolean_t fulfilled;
+  pthread_mutex_t lock;
+  pthread_cond_t cond_fulfilled;
+} cond_order_t;
+
+static void order_init(order_t *order){
+  cond_order_t *c = (cond_order_t *)order;
+  c->fulfilled = FALSE;
+  mutex_init_perror(&c->lock);
+  cond_init_perror(&c->cond_fulfilled);
+}
+
+static void order_wait(order_t *order){
+  cond_order_t *c = (cond_order_t *)order;
+  mutex_lock_perror(&c->lock);
+  while (!c->fulfilled){
+    cond_wait_perror(&c->cond_fulfilled, &c->lock);
+  }
+  c->fulfilled = FALSE;
+  mutex_unlock_perror(&c->lock);
+}
+
+static void order_fulfill(order_t *order){
+  cond_order_t *c = (cond_order_t *)order;
+  /* signal cond_fulfilled for the next order to be produced, if any */
+  mutex_lock_perror(&c->lock);
+  c->fulfilled = TRUE;
+  cond_signal_perror(&c->cond_fulfilled);
+  mutex_unlock_perror(&c->lock);
+}
+
+static void order_free(order_t *order){
+  (void)order;
+}
+
+const backend_t C_BACKEND_CONDVAR2 = {"condvar2",
+				      sizeof(cond_order_t),
+				      TRUE,
+				      queue_cond_new,
+				      queue_cond_enqueue,
+				      queue_cond_try_enqueue,
+				      queue_cond_enqueue_batch,
+				      queue_cond_dequeue,
+				      queue_cond_done,
+				      queue_cond_length,
+				      queue_cond_free,
+				      queue_cond_print,
+				      order_init,
+				      order_wait,
+				      order_fulfill,
+				      order_free};
@@ -0,0 +1,283 @@
+/**
+   backend-drr.c
+
+   A bound-buf backend that schedules orders across clients by deficit
+   round robin (DRR), with a bounded fifo sub-queue of count orders for
+   each client and the latch completion of the latch backend.
+
+   A client is active while its sub-queue is non-empty, and the active
+   clients take turns in a ring. At the start of its turn, the deficit of
+   a client is incremented by its weight, and the client is served one
+   order per unit of deficit. A client whose deficit is less than one
+   order is moved to the end of the ring and keeps its deficit for the
+   next turn; a client whose sub-queue becomes empty leaves the ring and
+   loses its deficit. Over a backlogged period, the clients are served in
+   proportion to their weights, and a client with a full sub-queue cannot
+   delay the orders of another client by more than one turn per order,
+   regardless of the order rate of the former.
+
+   The sub-queues share a mutex lock, and traders block on a condition
+   variable that is signaled only if a trader is waiting. A client blocks
+   on the condition variable of its full sub-queue. The wait strategy of
+   the queue configuration is ignored.
+*/
+
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "bound-buf.h"
+#include "utilities-mem.h"
+#include "utilities-pthread.h"
+
+typedef struct{
+  int count; /* count - 1 is fixed count of the sub-queue */
+  int head;
+  int tail;
+  order_t **orders;
+  double weight;
+  double deficit; /* orders that may be served in the current turn */
+  boolean_t active; /* in the ring of active clients */
+  int num_wait_nfull; /* the client, if waiting on cond_nfull */
+  pthread_cond_t cond_nfull;
+  unsigned long num_dequeued;
+} sub_q_t;
+
+typedef struct{
+  int num_clients;
+  int num_active;
+  int active_head; /* the client of the current turn */
+  int *active; /* ring of active client ids */
+  boolean_t turn; /* the deficit of the current turn was incremented */
+  boolean_t done;
+  sub_q_t *sqs;
+  pthread_mutex_t lock;
+  pthread_cond_t cond_nempty;
+  int num_wait_nempty; /* traders waiting on cond_nempty */
+  unsigned long num_signals; /* issued */
+  unsigned long num_signals_skipped; /* not issued without waiters */
+} drr_q_t;
+
+/**
+   Signals cond if a thread is waiting on cond, and counts the issued and
+   skipped signals. Requires holding the lock of the queue.
+*/
+static void signal_waiter(drr_q_t *q, pthread_cond_t *cond, int num_wait){
+  if (num_wait > 0){
+    cond_signal_perror(cond);
+    q->num_signals++;
+  }else{
+    q->num_signals_skipped++;
+  }
+}
+
+static void *queue_new(const queue_conf_t *conf){
+  int i;
+  drr_q_t *q = NULL;
+  q = malloc_perror(1, sizeof(drr_q_t));
+  memset(q, 0, sizeof(drr_q_t));
+  q->num_clients = conf->num_clients;
+  q->turn = FALSE;
+  q->done = FALSE;
+  q->active = malloc_perror(q->num_clients, sizeof(int));
+  q->sqs = calloc_perror(q->num_clients, sizeof(sub_q_t));
+  for (i = 0; i < q->num_clients; i++){
+    q->sqs[i].count = conf->count + 1; /* + 1 due to fifo implementation */
+    q->sqs[i].orders = calloc_perror(q->sqs[i].count, sizeof(order_t *));
+    q->sqs[i].weight = conf->weights[i];
+    q->sqs[i].active = FALSE;
+    cond_init_perror(&q->sqs[i].cond_nfull);
+  }
+  mutex_init_perror(&q->lock);
+  cond_init_perror(&q->cond_nempty);
+  return q;
+}
+
+/**
+   Queues orders of a client while its sub-queue is not full, and adds the
+   client to the end of the ring of active clients if it was inactive.
+   Returns the number of queued orders. Requires holding the lock.
+*/
+static int sub_q_put(drr_q_t *q, order_t *orders, int n){
+  int i = 0;
+  int id = orders[0].client_id;
+  int next;
+  sub_q_t *sq = &q->sqs[id];
+  next = (sq->tail + 1) % sq->count;
+  while (next == sq->head){
+    /* sub-queue is full; wait for the dequeue of an order of the client */
+    sq->num_wait_nfull++;
+    cond_wait_perror(&sq->cond_nfull, &q->lock);
+    sq->num_wait_nfull--;
+    next = (sq->tail + 1) % sq->count;
+  }
+  while (i < n && next != sq->head){
+    sq->orders[next] = &orders[i];
+    sq->tail = next;
+    next = (sq->tail + 1) % sq->count;
+    i++;
+  }
+  if (!sq->active){
+    sq->active = TRUE;
+    q->active[(q->active_head + q->num_active) % q->num_clients] = id;
+    q->num_active++;
+  }
+  return i;
+}
+
+static boolean_t queue_enqueue(void *queue, order_t *order){
+  drr_q_t *q = queue;
+  mutex_lock_perror(&q->lock);
+  sub_q_put(q, order, 1);
+  signal_waiter(q, &q->cond_nempty, q->num_wait_nempty);
+  mutex_unlock_perror(&q->lock);
+  return TRUE;
+}
+
+static enqueue_t queue_try_enqueue(void *queue, order_t *order){
+  drr_q_t *q = queue;
+  sub_q_t *sq = &q->sqs[order->client_id];
+  mutex_lock_perror(&q->lock);
+  if ((sq->tail + 1) % sq->count == sq->head){
+    mutex_unlock_perror(&q->lock);
+    return ENQUEUE_FULL;
+  }
+  sub_q_put(q, order, 1);
+  signal_waiter(q, &q->cond_nempty, q->num_wait_nempty);
+  mutex_unlock_perror(&q->lock);
+  return ENQUEUE_QUEUED;
+}
+
+static void queue_enqueue_batch(void *queue, order_t *orders, int n){
+  int i = 0;
+  int j, k;
+  drr_q_t *q = queue;
+  mutex_lock_perror(&q->lock);
+  while (i < n){
+    k = sub_q_put(q, &orders[i], n - i);
+    for (j = 0; j < k; j++){
+      signal_waiter(q, &q->cond_nempty, q->num_wait_nempty - j);
+    }
+    i += k;
+  }
+  mutex_unlock_perror(&q->lock);
+}
+
+static boolean_t queue_dequeue(void *queue, order_rec_t *rec){
+  int id;
+  order_t *order = NULL;
+  sub_q_t *sq = NULL;
+  drr_q_t *q = queue;
+  mutex_lock_perror(&q->lock);
+  while (q->num_active == 0){
+    if (q->done){
+      /* blocked traders were unblocked by queue_done */
+      mutex_unlock_perror(&q->lock);
+      return FALSE;
+    }
+    q->num_wait_nempty++;
+    cond_wait_perror(&q->cond_nempty, &q->lock);
+    q->num_wait_nempty--;
+  }
+  /* find the next client with a deficit of at least one order */
+  while (TRUE){
+    id = q->active[q->active_head];
+    sq = &q->sqs[id];
+    if (!q->turn){
+      sq->deficit += sq->weight;
+      q->turn = TRUE;
+    }
+    if (sq->deficit >= 1.0) break;
+    /* move the client to the end of the ring and keep its deficit */
+    q->active[(q->active_head + q->num_active) % q->num_clients] = id;
+    q->active_head = (q->active_head + 1) % q->num_clients;
+    q->turn = FALSE;
+  }
+  sq->head = (sq->head + 1) % sq->count;
+  order = sq->orders[sq->head];
+  sq->deficit -= 1.0;
+  sq->num_dequeued++;
+  if (sq->head == sq->tail){
+    /* the client leaves the ring and loses its deficit */
+    sq->active = FALSE;
+    sq->deficit = 0.0;
+    q->active_head = (q->active_head + 1) % q->num_clients;
+    q->num_active--;
+    q->turn = FALSE;
+  }
+  signal_waiter(q, &sq->cond_nfull, sq->num_wait_nfull);
+  mutex_unlock_perror(&q->lock);
+  order_rec_set(rec, order);
+  return TRUE;
+}
+
+static void queue_done(void *queue){
+  drr_q_t *q = queue;
+  /* unblock all blocked trader threads at once */
+  mutex_lock_perror(&q->lock);
+  q->done = TRUE;
+  if (q->num_wait_nempty > 0){
+    cond_broadcast_perror(&q->cond_nempty);
+    q->num_signals++;
+  }
+  mutex_unlock_perror(&q->lock);
+}
+
+static int queue_length(void *queue){
+  int i;
+  int n = 0;
+  sub_q_t *sq = NULL;
+  drr_q_t *q = queue;
+  for (i = 0; i < q->num_clients; i++){
+    sq = &q->sqs[i];
+    n += (__atomic_load_n(&sq->tail, __ATOMIC_RELAXED) -
+	  __atomic_load_n(&sq->head, __ATOMIC_RELAXED) +
+	  sq->count) % sq->count;
+  }
+  return n;
+}
+
+static void queue_print(void *queue){
+  int i;
+  drr_q_t *q = queue;
+  printf("queue: %lu signals issued, %lu skipped without waiters\n",
+	 q->num_signals, q->num_signals_skipped);
+  printf("queue: dequeued per client (weight):");
+  for (i = 0; i < q->num_clients; i++){
+    printf(" %lu (%g)", q->sqs[i].num_dequeued, q->sqs[i].weight);
+  }
+  printf("\n");
+}
+
+static void queue_free(void *queue){
+  int i;
+  drr_q_t *q = queue;
+  for (i = 0; i < q->num_clients; i++){
+    free(q->sqs[i].orders);
+    q->sqs[i].orders = NULL;
+  }
+  free(q->sqs);
+  free(q->active);
+  q->sqs = NULL;
+  q->active = NULL;
+  free(q);
+}
+
+const backend_t C_BACKEND_DRR = {"drr",
+				 sizeof(order_t),
+				 FALSE,
+				 queue_new,
+				 queue_enqueue,
+				 queue_try_enqueue,
+				 queue_enqueue_batch,
+				 queue_dequeue,
+				 queue_done,
+				 queue_length,
+				 queue_free,
+				 queue_print,
+				 order_latch_init,
+				 order_latch_wait,
+				 order_latch_fulfill,
+				 order_latch_free};
@@ -0,0 +1,75 @@
+/**
+   backend-latch.c
+
+   A bound-buf backend that synchronizes by using the condition variable
+   queue of the condvar1 backend, and a one-shot latch of a single 32-bit
+   word in each order for completion. A client polls the latch for a
+   bounded number of times before sleeping on a futex, and a trader
+   fulfills an order with an atomic exchange, followed by a wakeup only
+   if the client is asleep. The latch-inline backend uses the inline mode
+   of the condition variable queue.
+*/
+
+#define _XOPEN_SOURCE 600
+
+#include <pthread.h>
+#include "bound-buf.h"
+#include "utilities-pthread.h"
+
+static const int C_LATCH_NUM_SPINS = 100;
+
+/**
+   Latch completion, shared by the latch, latch-inline, drr, and prio
+   backends.
+*/
+
+void order_latch_init(order_t *order){
+  latch_init(&order->sync.latch);
+}
+
+void order_latch_wait(order_t *order){
+  latch_wait_perror(&order->sync.latch, C_LATCH_NUM_SPINS);
+  latch_reset(&order->sync.latch); /* no other thread refers to the order */
+}
+
+void order_latch_fulfill(order_t *order){
+  latch_set_perror(&order->sync.latch);
+}
+
+void order_latch_free(order_t *order){
+  (void)order;
+}
+
+const backend_t C_BACKEND_LATCH = {"latch",
+				   sizeof(order_t),
+				   TRUE,
+				   queue_cond_new,
+				   queue_cond_enqueue,
+				   queue_cond_try_enqueue,
+				   queue_cond_enqueue_batch,
+				   queue_cond_dequeue,
+				   queue_cond_done,
+				   queue_cond_length,
+				   queue_cond_free,
+				   queue_cond_print,
+				   order_latch_init,
+				   order_latch_wait,
+				   order_latch_fulfill,
+				   order_latch_free};
+
+const backend_t C_BACKEND_LATCH_INLINE = {"latch-inline",
+					  sizeof(order_t),
+					  TRUE,
+					  queue_cond_new_inline,
+					  queue_cond_enqueue,
+					  queue_cond_try_enqueue,
+					  queue_cond_enqueue_batch,
+					  queue_cond_dequeue,
+					  queue_cond_done,
+					  queue_cond_length,
+					  queue_cond_free,
+					  queue_cond_print,
+					  order_latch_init,
+					  order_latch_wait,
+					  order_latch_fulfill,
+					  order_latch_free};
@@ -0,0 +1,171 @@
+/**
+   backend-mutex.c
+
+   A bound-buf backend that synchronizes by using only mutex locks, adopted
+   from bound-buf-mutex.c. A full (empty) queue is polled by unlocking and
+   relocking the queue mutex, and a client polls the completion flag of its
+   order. The polling completion is shared with the condvar1 backend.
+*/
+
+#define _XOPEN_SOURCE 600
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "bound-buf.h"
+#include "utilities-mem.h"
+#include "utilities-pthread.h"
+
+typedef struct{
+  int count; /* count - 1 is fixed count of the queue -> bounded buffer */
+  int head;
+  int tail;
+  boolean_t done;
+  order_t **orders;
+  pthread_mutex_t lock;
+} order_q_t;
+
+static void *queue_new(const queue_conf_t *conf){
+  order_q_t *q = NULL;
+  q = malloc_perror(1, sizeof(order_q_t));
+  memset(q, 0, sizeof(order_q_t)); /* head = 0 and tail = 0 */
+  q->count = conf->count + 1; /* + 1 due to fifo queue implementation */
+  q->done = FALSE;
+  q->orders = calloc_perror(q->count, sizeof(order_t *));
+  mutex_init_perror(&q->lock);
+  return q;
+}
+
+static boolean_t queue_enqueue(void *queue, order_t *order){
+  int next;
+  order_q_t *q = queue;
+  while (TRUE){
+    mutex_lock_perror(&q->lock);
+    next = (q->tail + 1) % q->count;
+    if (next != q->head) break;
+    /* queue is full; unlock mutex to dequeue another order */
+    mutex_unlock_perror(&q->lock);
+  }
+  q->orders[next] = order;
+  q->tail = next;
+  mutex_unlock_perror(&q->lock);
+  return TRUE;
+}
+
+static enqueue_t queue_try_enqueue(void *queue, order_t *order){
+  int next;
+  order_q_t *q = queue;
+  mutex_lock_perror(&q->lock);
+  next = (q->tail + 1) % q->count;
+  if (next == q->head){
+    mutex_unlock_perror(&q->lock);
+    return ENQUEUE_FULL;
+  }
+  q->orders[next] = order;
+  q->tail = next;
+  mutex_unlock_perror(&q->lock);
+  return ENQUEUE_QUEUED;
+}
+
+static void queue_enqueue_batch(void *queue, order_t *orders, int n){
+  int i = 0;
+  int next;
+  order_q_t *q = queue;
+  while (i < n){
+    mutex_lock_perror(&q->lock);
+    next = (q->tail + 1) % q->count;
+    /* queue as many orders as fit; unlock mutex if full */
+    while (i < n && next != q->head){
+      q->orders[next] = &orders[i];
+      q->tail = next;
+      next = (q->tail + 1) % q->count;
+      i++;
+    }
+    mutex_unlock_perror(&q->lock);
+  }
+}
+
+static boolean_t queue_dequeue(void *queue, order_rec_t *rec){
+  int next;
+  order_t *order = NULL;
+  order_q_t *q = queue;
+  while (TRUE){
+    mutex_lock_perror(&q->lock);
+    if (q->head != q->tail) break;
+    /* empty queue; unlock mutex to let new orders in, if any */
+    if (q->done){
+      mutex_unlock_perror(&q->lock);
+      return FALSE;
+    }
+    mutex_unlock_perror(&q->lock);
+  }
+  next = (q->head + 1) % q->count;
+  order = q->orders[next]; /* allocated and deallocated by client */
+  q->head = next;
+  mutex_unlock_perror(&q->lock);
+  order_rec_set(rec, order);
+  return TRUE;
+}
+
+static void queue_done(void *queue){
+  order_q_t *q = queue;
+  mutex_lock_perror(&q->lock);
+  q->done = TRUE;
+  mutex_unlock_perror(&q->lock);
+}
+
+static int queue_length(void *queue){
+  order_q_t *q = queue;
+  return (__atomic_load_n(&q->tail, __ATOMIC_RELAXED) -
+	  __atomic_load_n(&q->head, __ATOMIC_RELAXED) +
+	  q->count) % q->count;
+}
+
+static void queue_free(void *queue){
+  order_q_t *q = queue;
+  free(q->orders);
+  q->orders = NULL;
+  free(q);
+}
+
+static void queue_print(void *queue){
+  (void)queue;
+}
+
+/**
+   Polling completion, shared by the mutex and condvar1 backends.
+*/
+
+void order_poll_init(order_t *order){
+  order->sync.fulfilled = FALSE;
+}
+
+void order_poll_wait(order_t *order){
+  while (!__atomic_load_n(&order->sync.fulfilled, __ATOMIC_ACQUIRE));
+  order->sync.fulfilled = FALSE; /* no other thread refers to the order */
+}
+
+void order_poll_fulfill(order_t *order){
+  __atomic_store_n(&order->sync.fulfilled, TRUE, __ATOMIC_RELEASE);
+}
+
+void order_poll_free(order_t *order){
+  (void)order;
+}
+
+const backend_t C_BACKEND_MUTEX = {"mutex",
+				   sizeof(order_t),
+				   FALSE,
+				   queue_new,
+				   queue_enqueue,
+				   queue_try_enqueue,
+				   queue_enqueue_batch,
+				   queue_dequeue,
+				   queue_done,
+				   queue_length,
+				   queue_free,
+				   queue_print,
+				   order_poll_init,
+				   order_poll_wait,
+				   order_poll_fulfill,
+				   order_poll_free};
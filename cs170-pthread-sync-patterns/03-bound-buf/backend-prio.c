@@ -0,0 +1,269 @@
+/**
+   backend-prio.c
+
+   A bound-buf backend that schedules orders across two priority lanes,
+   with a bounded fifo sub-queue of count orders for each lane and the
+   latch completion of the latch backend. Urgent orders, e.g. cancels,
+   are dequeued ahead of normal orders, so that their latency does not
+   grow with a backlog of normal orders.
+
+   The normal lane is protected from starvation under a saturating urgent
+   load in two ways. A waiting normal order is dequeued after at most
+   lane_burst urgent orders in a row, and, if lane_age_ns is not 0, is
+   dequeued next if it was sent at least lane_age_ns before the next
+   urgent order. The former bounds the share of the traders that urgent
+   orders can take while normal orders are waiting, and the latter bounds
+   how long a normal order can be overtaken by later urgent orders, by
+   comparing (intended) send times instead of reading the clock.
+
+   The lanes share a mutex lock, and traders block on a condition
+   variable that is signaled only if a trader is waiting. A client blocks
+   on the condition variable of the full lane of its order, so that a
+   full normal lane does not delay an urgent order. The wait strategy of
+   the queue configuration is ignored.
+*/
+
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include "bound-buf.h"
+#include "utilities-mem.h"
+#include "utilities-pthread.h"
+
+typedef struct{
+  int count; /* count - 1 is fixed count of the lane */
+  int head;
+  int tail;
+  order_t **orders;
+  int num_wait_nfull; /* clients waiting on cond_nfull */
+  pthread_cond_t cond_nfull;
+  unsigned long num_dequeued;
+} lane_q_t;
+
+typedef struct{
+  int burst; /* urgent orders dequeued in a row while normal are waiting */
+  int lane_burst;
+  uint64_t lane_age_ns;
+  boolean_t done;
+  lane_q_t lanes[NUM_LANES];
+  pthread_mutex_t lock;
+  pthread_cond_t cond_nempty;
+  int num_wait_nempty; /* traders waiting on cond_nempty */
+  unsigned long num_signals; /* issued */
+  unsigned long num_signals_skipped; /* not issued without waiters */
+  unsigned long num_burst; /* normal orders dequeued after a full burst */
+  unsigned long num_aged; /* normal orders dequeued at lane_age_ns */
+} prio_q_t;
+
+/**
+   Signals cond if a thread is waiting on cond, and counts the issued and
+   skipped signals. Requires holding the lock of the queue.
+*/
+static void signal_waiter(prio_q_t *q, pthread_cond_t *cond, int num_wait){
+  if (num_wait > 0){
+    cond_signal_perror(cond);
+    q->num_signals++;
+  }else{
+    q->num_signals_skipped++;
+  }
+}
+
+static boolean_t lane_empty(const lane_q_t *lq){
+  return lq->head == lq->tail;
+}
+
+static void *queue_new(const queue_conf_t *conf){
+  int i;
+  prio_q_t *q = NULL;
+  q = malloc_perror(1, sizeof(prio_q_t));
+  memset(q, 0, sizeof(prio_q_t));
+  q->lane_burst = conf->lane_burst;
+  q->lane_age_ns = conf->lane_age_ns;
+  q->done = FALSE;
+  for (i = 0; i < NUM_LANES; i++){
+    q->lanes[i].count = conf->count + 1; /* + 1 due to fifo implementation */
+    q->lanes[i].orders = calloc_perror(q->lanes[i].count, sizeof(order_t *));
+    cond_init_perror(&q->lanes[i].cond_nfull);
+  }
+  mutex_init_perror(&q->lock);
+  cond_init_perror(&q->cond_nempty);
+  return q;
+}
+
+/**
+   Queues an order in its lane, and blocks while the lane is full.
+   Requires holding the lock.
+*/
+static void lane_put(prio_q_t *q, order_t *order){
+  int next;
+  lane_q_t *lq = &q->lanes[order->lane];
+  next = (lq->tail + 1) % lq->count;
+  while (next == lq->head){
+    /* lane is full; wait for the dequeue of an order of the lane */
+    lq->num_wait_nfull++;
+    cond_wait_perror(&lq->cond_nfull, &q->lock);
+    lq->num_wait_nfull--;
+    next = (lq->tail + 1) % lq->count;
+  }
+  lq->orders[next] = order;
+  lq->tail = next;
+  signal_waiter(q, &q->cond_nempty, q->num_wait_nempty);
+}
+
+static boolean_t queue_enqueue(void *queue, order_t *order){
+  prio_q_t *q = queue;
+  mutex_lock_perror(&q->lock);
+  lane_put(q, order);
+  mutex_unlock_perror(&q->lock);
+  return TRUE;
+}
+
+static enqueue_t queue_try_enqueue(void *queue, order_t *order){
+  prio_q_t *q = queue;
+  lane_q_t *lq = &q->lanes[order->lane];
+  mutex_lock_perror(&q->lock);
+  if ((lq->tail + 1) % lq->count == lq->head){
+    mutex_unlock_perror(&q->lock);
+    return ENQUEUE_FULL;
+  }
+  lane_put(q, order);
+  mutex_unlock_perror(&q->lock);
+  return ENQUEUE_QUEUED;
+}
+
+static void queue_enqueue_batch(void *queue, order_t *orders, int n){
+  int i;
+  prio_q_t *q = queue;
+  mutex_lock_perror(&q->lock);
+  for (i = 0; i < n; i++){
+    lane_put(q, &orders[i]);
+  }
+  mutex_unlock_perror(&q->lock);
+}
+
+/**
+   Returns the lane of the next order of a non-empty queue, and updates
+   the burst of urgent orders. Requires holding the lock.
+*/
+static lane_t lane_next(prio_q_t *q){
+  lane_q_t *urgent = &q->lanes[LANE_URGENT];
+  lane_q_t *normal = &q->lanes[LANE_NORMAL];
+  uint64_t urgent_ns, normal_ns;
+  if (lane_empty(urgent)) return LANE_NORMAL;
+  if (lane_empty(normal)){
+    q->burst = 0;
+    return LANE_URGENT;
+  }
+  if (q->burst >= q->lane_burst){
+    q->num_burst++;
+    return LANE_NORMAL;
+  }
+  if (q->lane_age_ns > 0){
+    urgent_ns = urgent->orders[(urgent->head + 1) % urgent->count]->start_ns;
+    normal_ns = normal->orders[(normal->head + 1) % normal->count]->start_ns;
+    if (normal_ns + q->lane_age_ns <= urgent_ns){
+      q->num_aged++;
+      return LANE_NORMAL;
+    }
+  }
+  q->burst++;
+  return LANE_URGENT;
+}
+
+static boolean_t queue_dequeue(void *queue, order_rec_t *rec){
+  lane_t lane;
+  order_t *order = NULL;
+  lane_q_t *lq = NULL;
+  prio_q_t *q = queue;
+  mutex_lock_perror(&q->lock);
+  while (lane_empty(&q->lanes[LANE_URGENT]) &&
+	 lane_empty(&q->lanes[LANE_NORMAL])){
+    if (q->done){
+      /* blocked traders were unblocked by queue_done */
+      mutex_unlock_perror(&q->lock);
+      return FALSE;
+    }
+    q->num_wait_nempty++;
+    cond_wait_perror(&q->cond_nempty, &q->lock);
+    q->num_wait_nempty--;
+  }
+  lane = lane_next(q);
+  if (lane == LANE_NORMAL) q->burst = 0;
+  lq = &q->lanes[lane];
+  lq->head = (lq->head + 1) % lq->count;
+  order = lq->orders[lq->head];
+  lq->num_dequeued++;
+  signal_waiter(q, &lq->cond_nfull, lq->num_wait_nfull);
+  mutex_unlock_perror(&q->lock);
+  order_rec_set(rec, order);
+  return TRUE;
+}
+
+static void queue_done(void *queue){
+  prio_q_t *q = queue;
+  /* unblock all blocked trader threads at once */
+  mutex_lock_perror(&q->lock);
+  q->done = TRUE;
+  if (q->num_wait_nempty > 0){
+    cond_broadcast_perror(&q->cond_nempty);
+    q->num_signals++;
+  }
+  mutex_unlock_perror(&q->lock);
+}
+
+static int queue_length(void *queue){
+  int i;
+  int n = 0;
+  lane_q_t *lq = NULL;
+  prio_q_t *q = queue;
+  for (i = 0; i < NUM_LANES; i++){
+    lq = &q->lanes[i];
+    n += (__atomic_load_n(&lq->tail, __ATOMIC_RELAXED) -
+	  __atomic_load_n(&lq->head, __ATOMIC_RELAXED) +
+	  lq->count) % lq->count;
+  }
+  return n;
+}
+
+static void queue_print(void *queue){
+  prio_q_t *q = queue;
+  printf("queue: %lu signals issued, %lu skipped without waiters\n",
+	 q->num_signals, q->num_signals_skipped);
+  printf("queue: dequeued urgent %lu, normal %lu, normal ahead of urgent "
+	 "after a burst %lu, at age %lu\n",
+	 q->lanes[LANE_URGENT].num_dequeued,
+	 q->lanes[LANE_NORMAL].num_dequeued,
+	 q->num_burst,
+	 q->num_aged);
+}
+
+static void queue_free(void *queue){
+  int i;
+  prio_q_t *q = queue;
+  for (i = 0; i < NUM_LANES; i++){
+    free(q->lanes[i].orders);
+    q->lanes[i].orders = NULL;
+  }
+  free(q);
+}
+
+const backend_t C_BACKEND_PRIO = {"prio",
+				  sizeof(order_t),
+				  FALSE,
+				  queue_new,
+				  queue_enqueue,
+				  queue_try_enqueue,
+				  queue_enqueue_batch,
+				  queue_dequeue,
+				  queue_done,
+				  queue_length,
+				  queue_free,
+				  queue_print,
+				  order_latch_init,
+				  order_latch_wait,
+				  order_latch_fulfill,
+				  order_latch_free};
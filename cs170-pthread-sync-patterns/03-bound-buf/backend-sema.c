@@ -0,0 +1,185 @@
+/**
+   backend-sema.c
+
+   A bound-buf backend that synchronizes by using semaphores for
+   implementing mutex locks and condition variables, adopted from
+   bound-buf-sema.c. sema_nempty and sema_nfull are signaled outside the
+   critical sections for queuing and dequeuing, because once a (de)queue
+   op is reserved, it is allowed under the mutex semaphore, and the mutex
+   semaphore can be released before the ops availability is updated.
+*/
+
+#define _XOPEN_SOURCE 600
+
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "bound-buf.h"
+#include "utilities-mem.h"
+#include "utilities-pthread.h"
+
+typedef struct{
+  int count; /* count - 1 is fixed count of the queue -> bounded buffer */
+  int head;
+  int tail;
+  boolean_t done;
+  order_t **orders;
+  sema_t sema_lock; /* mutex, initialize to 1 */
+  sema_t sema_nfull; /* initialize to queue count */
+  sema_t sema_nempty; /* initialize to 0 */
+} order_q_t;
+
+static void *queue_new(const queue_conf_t *conf){
+  order_q_t *q = NULL;
+  q = malloc_perror(1, sizeof(order_q_t));
+  memset(q, 0, sizeof(order_q_t)); /* head = 0 and tail = 0 */
+  q->count = conf->count + 1; /* + 1 due to fifo queue implementation */
+  q->done = FALSE;
+  q->orders = calloc_perror(q->count, sizeof(order_t *));
+  sema_init_perror(&q->sema_lock, 1);
+  sema_init_perror(&q->sema_nfull, conf->count);
+  sema_init_perror(&q->sema_nempty, 0);
+  return q;
+}
+
+/**
+   Queues an order after a queue op was reserved.
+*/
+static void queue_put(order_q_t *q, order_t *order){
+  int next;
+  sema_wait_perror(&q->sema_lock); /* queue under mutex */
+  next = (q->tail + 1) % q->count;
+  q->orders[next] = order;
+  q->tail = next;
+  sema_signal_perror(&q->sema_lock); /* release for reserved ops */
+  sema_signal_perror(&q->sema_nempty); /* update ops availability */
+}
+
+static boolean_t queue_enqueue(void *queue, order_t *order){
+  order_q_t *q = queue;
+  sema_wait_perror(&q->sema_nfull); /* reserve a queue op */
+  queue_put(q, order);
+  return TRUE;
+}
+
+static enqueue_t queue_try_enqueue(void *queue, order_t *order){
+  order_q_t *q = queue;
+  if (sema_trywait_n_perror(&q->sema_nfull, 1) == 0) return ENQUEUE_FULL;
+  queue_put(q, order);
+  return ENQUEUE_QUEUED;
+}
+
+static void queue_enqueue_batch(void *queue, order_t *orders, int n){
+  int i = 0;
+  int j, k, next;
+  order_q_t *q = queue;
+  while (i < n){
+    /* reserve as many queue ops as available, or block for one */
+    k = sema_trywait_n_perror(&q->sema_nfull, n - i);
+    if (k == 0){
+      sema_wait_perror(&q->sema_nfull);
+      k = 1;
+    }
+    sema_wait_perror(&q->sema_lock); /* queue under mutex */
+    for (j = 0; j < k; j++){
+      next = (q->tail + 1) % q->count;
+      q->orders[next] = &orders[i + j];
+      q->tail = next;
+    }
+    sema_signal_perror(&q->sema_lock); /* release for reserved ops */
+    sema_signal_n_perror(&q->sema_nempty, k); /* update ops availability */
+    i += k;
+  }
+}
+
+static boolean_t queue_dequeue(void *queue, order_rec_t *rec){
+  int next;
+  order_t *order = NULL;
+  order_q_t *q = queue;
+  sema_wait_perror(&q->sema_nempty); /* reserve a dequeue op */
+  sema_wait_perror(&q->sema_lock); /* dequeue under mutex */
+  if (q->head == q->tail && q->done){
+    /* reserved by queue_done; propagate the exit to the next trader */
+    sema_signal_perror(&q->sema_lock);
+    sema_signal_perror(&q->sema_nempty);
+    return FALSE;
+  }
+  next = (q->head + 1) % q->count;
+  order = q->orders[next];
+  q->head = next;
+  sema_signal_perror(&q->sema_lock); /* release for reserved ops */
+  sema_signal_perror(&q->sema_nfull); /* update ops availability */
+  order_rec_set(rec, order);
+  return TRUE;
+}
+
+static void queue_done(void *queue){
+  order_q_t *q = queue;
+  /* all orders were dequeued and fulfilled; signal sema_nempty to trigger
+     trader exit propagation */
+  sema_wait_perror(&q->sema_lock);
+  q->done = TRUE;
+  sema_signal_perror(&q->sema_lock);
+  sema_signal_perror(&q->sema_nempty);
+}
+
+static int queue_length(void *queue){
+  order_q_t *q = queue;
+  return (__atomic_load_n(&q->tail, __ATOMIC_RELAXED) -
+	  __atomic_load_n(&q->head, __ATOMIC_RELAXED) +
+	  q->count) % q->count;
+}
+
+static void queue_free(void *queue){
+  order_q_t *q = queue;
+  free(q->orders);
+  q->orders = NULL;
+  free(q);
+}
+
+static void queue_print(void *queue){
+  (void)queue;
+}
+
+/**
+   An order followed by the completion state of the backend. order is
+   the first member, so that an order of the backend is its order_t
+   converted by a cast.
+*/
+typedef struct{
+  order_t order;
+  sema_t sema_fulfilled;
+} sema_order_t;
+
+static void order_init(order_t *order){
+  sema_init_perror(&((sema_order_t *)order)->sema_fulfilled, 0);
+}
+
+static void order_wait(order_t *order){
+  sema_wait_perror(&((sema_order_t *)order)->sema_fulfilled);
+}
+
+static void order_fulfill(order_t *order){
+  sema_signal_perror(&((sema_order_t *)order)->sema_fulfilled);
+}
+
+static void order_free(order_t *order){
+  (void)order;
+}
+
+const backend_t C_BACKEND_SEMA = {"sema",
+				  sizeof(sema_order_t),
+				  FALSE,
+				  queue_new,
+				  queue_enqueue,
+				  queue_try_enqueue,
+				  queue_enqueue_batch,
+				  queue_dequeue,
+				  queue_done,
+				  queue_length,
+				  queue_free,
+				  queue_print,
+				  order_init,
+				  order_wait,
+				  order_fulfill,
+				  order_free};
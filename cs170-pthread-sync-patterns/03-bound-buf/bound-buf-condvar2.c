@@ -29,7 +29,12 @@
       are fixed; the names of condition variables are changed to negated
       names to reflect their use,
    -  the outer polling while loops are removed due to the use of
-      pthread_cond_wait within dedicated predicate re-testing while loops.
+      pthread_cond_wait within dedicated predicate re-testing while loops,
+   -  the queue counts the threads waiting on cond_nfull and cond_nempty,
+      and a condition variable is signaled only if a thread is waiting,
+      so that an enqueue or dequeue without contention does not enter the
+      kernel; the number of issued and skipped signals is printed if
+      verbose.
 */
 
 #define _XOPEN_SOURCE 600
@@ -40,12 +45,12 @@
 #include <string.h>
 #include <limits.h>
 #include <pthread.h>
-#include "ctimer.h"
 #include "utilities-mem.h"
 #include "utilities-pthread.h"
+#include "utilities-rand.h"
+#include "utilities-log.h"
+#include "utilities-time.h"
 
-#define DRAND_SEED() do{srand48(time(NULL));}while (0)
-#define DRAND() (drand48()) /* basic Linux random number generator */
 #define ARGS "c:t:o:q:s:V"
 
 typedef enum{FALSE, TRUE} boolean_t;
@@ -58,6 +63,10 @@ const int C_DEF_QUEUE_COUNT = 1;
 const int C_DEF_NUM_STOCKS = 1;
 const int C_DEF_QUANTITY = 5000;
 const double C_PROB_HALF = 0.5; 
+const int C_LOG_RING_COUNT = 1024;
+const char *C_LOG_QUEUED_BUY = "client %ld: queued stock %ld, for %ld, BUY\n";
+const char *C_LOG_QUEUED_SELL = "client %ld: queued stock %ld, for %ld, SELL\n";
+const char *C_LOG_FULFILLED = "trader: %ld fulfilled stock %ld for %ld\n";
 
 const char *C_USAGE =
   "bound-buf-mutex "
@@ -90,6 +99,10 @@ typedef struct{
   pthread_mutex_t lock;
   pthread_cond_t cond_nfull;
   pthread_cond_t cond_nempty;
+  int num_wait_nfull; /* clients waiting on cond_nfull */
+  int num_wait_nempty; /* traders waiting on cond_nempty */
+  unsigned long num_signals; /* issued */
+  unsigned long num_signals_skipped; /* not issued without waiters */
 } order_q_t;
 
 void order_q_init(order_q_t *q, int count){
@@ -101,6 +114,19 @@ void order_q_init(order_q_t *q, int count){
   cond_init_perror(&q->cond_nempty);
 }
 
+/**
+   Signals cond if a thread is waiting on cond, and counts the issued and
+   skipped signals. Requires holding the lock of the queue.
+*/
+void order_q_signal(order_q_t *q, pthread_cond_t *cond, int num_wait){
+  if (num_wait > 0){
+    cond_signal_perror(cond);
+    q->num_signals++;
+  }else{
+    q->num_signals_skipped++;
+  }
+}
+
 void order_q_free(order_q_t *q){
   while (q->head != q->tail){
     q->head = (q->head + 1) % q->count;
@@ -154,15 +180,19 @@ typedef struct{
   int num_stocks;
   int quantity;
   boolean_t verbose;
+  rng_t rng; /* non-overlapping stream of each client */
+  log_t *log; /* ring id is id; only if verbose */
   order_q_t *q; /* clients (producers) and traders (consumers) */
 } client_arg_t;
 
 typedef struct{
   int id;
+  int log_id; /* ring id follows the client ring ids */
   boolean_t *done;
   boolean_t verbose;
   order_q_t *q; /* clients (producers) and traders (consumers) */
   market_t *m; /* only traders (consumers) */
+  log_t *log; /* only if verbose */
 } trader_arg_t;
 
 /**
@@ -174,15 +204,16 @@ void *client_thread(void *arg){
   int next;
   order_t *order = NULL;
   client_arg_t *ca = arg;
+  rng_t rng = ca->rng; /* thread-local state; no sharing of cache lines */
   order = malloc_perror(1, sizeof(order_t));
   /* initialize here to avoid undefined behavior */
   mutex_init_perror(&order->lock);
   cond_init_perror(&order->cond_fulfilled);
   for (i = 0; i < ca->order_count; i++){
     /* produce an order */
-    order->stock_id = DRAND() * (ca->num_stocks - 1);
-    order->quantity = DRAND() * ca->quantity;
-    order->action = (DRAND() > C_PROB_HALF) ? BUY : SELL;
+    order->stock_id = rng_unif(&rng) * (ca->num_stocks - 1);
+    order->quantity = rng_unif(&rng) * ca->quantity;
+    order->action = (rng_unif(&rng) > C_PROB_HALF) ? BUY : SELL;
     order->fulfilled = FALSE;
     /* queue the order */
     mutex_lock_perror(&ca->q->lock);
@@ -190,20 +221,20 @@ void *client_thread(void *arg){
     while (next == ca->q->head){
       /* queue is full; wait for cond_nfull signal and retest
          because "at least one" waiting thread is unblocked */
+      ca->q->num_wait_nfull++;
       cond_wait_perror(&ca->q->cond_nfull, &ca->q->lock);
+      ca->q->num_wait_nfull--;
       next = (ca->q->tail + 1) % ca->q->count;
     }
     /* queue is not full; queue, signal cond_nempty, and unlock mutex */
     if (ca->verbose){
-      printf("%10.6f client %d: ", ctimer(), ca->id);
-      printf("queued stock %d, for %d, %s\n",
-	     order->stock_id,
-	     order->quantity,
-	     (order->action ? "SELL" : "BUY"));
+      log_write(ca->log, ca->id,
+		(order->action ? C_LOG_QUEUED_SELL : C_LOG_QUEUED_BUY),
+		ca->id, order->stock_id, order->quantity, 0);
     }
     ca->q->orders[next] = order;
     ca->q->tail = next;
-    cond_signal_perror(&ca->q->cond_nempty);
+    order_q_signal(ca->q, &ca->q->cond_nempty, ca->q->num_wait_nempty);
     mutex_unlock_perror(&ca->q->lock);
     /* wait for cond_fulfilled signal before producing another order */
     mutex_lock_perror(&order->lock);
@@ -229,18 +260,19 @@ void *trader_thread(void *arg){
     mutex_lock_perror(&ta->q->lock);
     while (ta->q->head == ta->q->tail){
       if (*ta->done){
-	cond_signal_perror(&ta->q->cond_nempty);
 	mutex_unlock_perror(&ta->q->lock);
 	return NULL;
       }
       /* after the last order is processed, all trader threads may be blocked;
-         need to signal cond_nempty from main after done is set to TRUE */
+         need to broadcast cond_nempty from main after done is set to TRUE */
+      ta->q->num_wait_nempty++;
       cond_wait_perror(&ta->q->cond_nempty, &ta->q->lock);
+      ta->q->num_wait_nempty--;
     }
     next = (ta->q->head + 1) % ta->q->count;
     order = ta->q->orders[next];
     ta->q->head = next;
-    cond_signal_perror(&ta->q->cond_nfull);
+    order_q_signal(ta->q, &ta->q->cond_nfull, ta->q->num_wait_nfull);
     mutex_unlock_perror(&ta->q->lock);
     /* process a dequeued order */
     mutex_lock_perror(&ta->m->lock);
@@ -253,10 +285,8 @@ void *trader_thread(void *arg){
       ta->m->quantities[order->stock_id] += order->quantity;
     }
     if (ta->verbose){
-      printf("%10.6f trader: %d ", ctimer(), ta->id);
-      printf("fulfilled stock %d for %d\n",
-	     order->stock_id,
-	     order->quantity);
+      log_write(ta->log, ta->log_id, C_LOG_FULFILLED,
+		ta->id, order->stock_id, order->quantity, 0);
     }
     mutex_unlock_perror(&ta->m->lock);
     /* signal cond_fulfilled for the next order to be produced, if any */
@@ -276,16 +306,19 @@ int main(int argc, char **argv){
   int num_stocks = C_DEF_NUM_STOCKS;
   int quantity = C_DEF_QUANTITY;
   int c;
+  unsigned long num_dropped;
   double start, end;
   boolean_t verbose = FALSE;
   boolean_t done = FALSE;
   order_q_t *q = NULL;
   market_t *m = NULL;
+  log_t *log = NULL;
   pthread_t *cids = NULL;
   pthread_t *tids = NULL;
   client_arg_t *cas = NULL;
   trader_arg_t *tas = NULL;
-  DRAND_SEED();
+  rng_t rng;
+  rng_seed(&rng, time(NULL));
   while ((c = getopt(argc, argv, ARGS)) != -1){
     switch (c){
     case 'c':
@@ -340,7 +373,15 @@ int main(int argc, char **argv){
   tas = malloc_perror(num_trader_threads, sizeof(trader_arg_t));
   order_q_init(q, queue_count);
   market_init(m, num_stocks, quantity);
-  start = ctimer();
+  if (verbose){
+    /* records are formatted and written by the flusher thread of the log */
+    log = malloc_perror(1, sizeof(log_t));
+    log_init_perror(log,
+		    num_client_threads + num_trader_threads,
+		    C_LOG_RING_COUNT,
+		    stdout);
+  }
+  start = time_mono_sec_perror();
   /* spawn threads */
   for (i = 0; i < num_client_threads; i++){
     cas[i].id = i;
@@ -349,6 +390,9 @@ int main(int argc, char **argv){
     cas[i].quantity = quantity;
     cas[i].q = q;
     cas[i].verbose = verbose;
+    cas[i].log = log;
+    cas[i].rng = rng;
+    rng_jump(&rng);
     thread_create_perror(&cids[i], client_thread, &cas[i]);
   }
   for (i = 0; i < num_trader_threads; i++){
@@ -356,35 +400,49 @@ int main(int argc, char **argv){
     tas[i].q = q;
     tas[i].m = m;
     tas[i].done = &done;
+    tas[i].log_id = num_client_threads + i;
     tas[i].verbose = verbose;
+    tas[i].log = log;
     thread_create_perror(&tids[i], trader_thread, &tas[i]);
   }
   /* join client threads after each client's orders are fulfilled */
   for (i = 0; i < num_client_threads; i++){
     thread_join_perror(cids[i], NULL);
   }
-  /* signal cond_nempty because all trader threads may be blocked */
+  /* broadcast cond_nempty because all trader threads may be blocked */
   mutex_lock_perror(&q->lock);
   done = TRUE;
-  cond_signal_perror(&q->cond_nempty);
+  if (q->num_wait_nempty > 0){
+    cond_broadcast_perror(&q->cond_nempty);
+    q->num_signals++;
+  }
   mutex_unlock_perror(&q->lock);
   for (i = 0; i < num_trader_threads; i++){
     thread_join_perror(tids[i], NULL);
   }
-  end = ctimer();
-  if (verbose) market_print(m);
+  end = time_mono_sec_perror();
+  if (verbose){
+    num_dropped = log_num_dropped(log); /* exact after joining */
+    log_free_perror(log); /* write remaining records */
+    if (num_dropped > 0) printf("%lu log records dropped\n", num_dropped);
+    printf("queue: %lu signals issued, %lu skipped without waiters\n",
+	   q->num_signals, q->num_signals_skipped);
+    market_print(m);
+  }
   printf("%f transactions / sec\n",
 	 orders_per_client * num_client_threads / (end - start));
   order_q_free(q);
   market_free(m);
   free(q);
   free(m);
+  free(log);
   free(cids);
   free(tids);
   free(cas);
   free(tas);
   q = NULL;
   m = NULL;
+  log = NULL;
   cids = NULL;
   tids = NULL;
   cas = NULL;
@@ -31,12 +31,12 @@
 #include <string.h>
 #include <limits.h>
 #include <pthread.h>
-#include "ctimer.h"
 #include "utilities-mem.h"
 #include "utilities-pthread.h"
+#include "utilities-rand.h"
+#include "utilities-log.h"
+#include "utilities-time.h"
 
-#define DRAND_SEED() do{srand48(time(NULL));}while (0)
-#define DRAND() (drand48()) /* basic Linux random number generator */
 #define ARGS "c:t:o:q:s:V"
 
 typedef enum{FALSE, TRUE} boolean_t;
@@ -49,6 +49,10 @@ const int C_DEF_QUEUE_COUNT = 1;
 const int C_DEF_NUM_STOCKS = 1;
 const int C_DEF_QUANTITY = 5000;
 const double C_PROB_HALF = 0.5; 
+const int C_LOG_RING_COUNT = 1024;
+const char *C_LOG_QUEUED_BUY = "client %ld: queued stock %ld, for %ld, BUY\n";
+const char *C_LOG_QUEUED_SELL = "client %ld: queued stock %ld, for %ld, SELL\n";
+const char *C_LOG_FULFILLED = "trader: %ld fulfilled stock %ld for %ld\n";
 
 const char *C_USAGE =
   "bound-buf-mutex "
@@ -139,15 +143,19 @@ typedef struct{
   int num_stocks;
   int quantity;
   boolean_t verbose;
+  rng_t rng; /* non-overlapping stream of each client */
+  log_t *log; /* ring id is id; only if verbose */
   order_q_t *q; /* clients (producers) and traders (consumers) */
 } client_arg_t;
 
 typedef struct{
   int id;
+  int log_id; /* ring id follows the client ring ids */
   boolean_t *done;
   boolean_t verbose;
   order_q_t *q; /* clients (producers) and traders (consumers) */
   market_t *m; /* only traders (consumers) */
+  log_t *log; /* only if verbose */
 } trader_arg_t;
 
 /**
@@ -160,12 +168,13 @@ void *client_thread(void *arg){
   boolean_t queued;
   order_t *order = NULL;
   client_arg_t *ca = arg;
+  rng_t rng = ca->rng; /* thread-local state; no sharing of cache lines */
   order = malloc_perror(1, sizeof(order_t));
   for (i = 0; i < ca->order_count; i++){
     /* produce an order */
-    order->stock_id = DRAND() * (ca->num_stocks - 1);
-    order->quantity = DRAND() * ca->quantity;
-    order->action = (DRAND() > C_PROB_HALF) ? BUY : SELL;
+    order->stock_id = rng_unif(&rng) * (ca->num_stocks - 1);
+    order->quantity = rng_unif(&rng) * ca->quantity;
+    order->action = (rng_unif(&rng) > C_PROB_HALF) ? BUY : SELL;
     order->fulfilled = FALSE;
     /* queue the order */
     queued = FALSE;
@@ -178,11 +187,9 @@ void *client_thread(void *arg){
       }else{
 	/* queue is not full; queue the order and unlock mutex */
 	if (ca->verbose){
-	  printf("%10.6f client %d: ", ctimer(), ca->id);
-	  printf("queued stock %d, for %d, %s\n",
-		 order->stock_id,
-		 order->quantity,
-		 (order->action ? "SELL" : "BUY"));
+	  log_write(ca->log, ca->id,
+		    (order->action ? C_LOG_QUEUED_SELL : C_LOG_QUEUED_BUY),
+		    ca->id, order->stock_id, order->quantity, 0);
 	}
 	ca->q->orders[next] = order;
 	ca->q->tail = next;
@@ -234,10 +241,8 @@ void *trader_thread(void *arg){
       ta->m->quantities[order->stock_id] += order->quantity;
     }
     if (ta->verbose){
-      printf("%10.6f trader: %d ", ctimer(), ta->id);
-      printf("fulfilled stock %d for %d\n",
-	     order->stock_id,
-	     order->quantity);
+      log_write(ta->log, ta->log_id, C_LOG_FULFILLED,
+		ta->id, order->stock_id, order->quantity, 0);
     }
     mutex_unlock_perror(&ta->m->lock);
     /* atomic memory write on x86; inform the reading client thread */
@@ -254,16 +259,19 @@ int main(int argc, char **argv){
   int num_stocks = C_DEF_NUM_STOCKS;
   int quantity = C_DEF_QUANTITY;
   int c;
+  unsigned long num_dropped;
   double start, end;
   boolean_t verbose = FALSE;
   boolean_t done = FALSE;
   order_q_t *q = NULL;
   market_t *m = NULL;
+  log_t *log = NULL;
   pthread_t *cids = NULL;
   pthread_t *tids = NULL;
   client_arg_t *cas = NULL;
   trader_arg_t *tas = NULL;
-  DRAND_SEED();
+  rng_t rng;
+  rng_seed(&rng, time(NULL));
   while ((c = getopt(argc, argv, ARGS)) != -1){
     switch (c){
     case 'c':
@@ -318,7 +326,15 @@ int main(int argc, char **argv){
   tas = malloc_perror(num_trader_threads, sizeof(trader_arg_t));
   order_q_init(q, queue_count);
   market_init(m, num_stocks, quantity);
-  start = ctimer();
+  if (verbose){
+    /* records are formatted and written by the flusher thread of the log */
+    log = malloc_perror(1, sizeof(log_t));
+    log_init_perror(log,
+		    num_client_threads + num_trader_threads,
+		    C_LOG_RING_COUNT,
+		    stdout);
+  }
+  start = time_mono_sec_perror();
   /* spawn threads */
   for (i = 0; i < num_client_threads; i++){
     cas[i].id = i;
@@ -327,6 +343,9 @@ int main(int argc, char **argv){
     cas[i].quantity = quantity;
     cas[i].q = q;
     cas[i].verbose = verbose;
+    cas[i].log = log;
+    cas[i].rng = rng;
+    rng_jump(&rng);
     thread_create_perror(&cids[i], client_thread, &cas[i]);
   }
   for (i = 0; i < num_trader_threads; i++){
@@ -334,7 +353,9 @@ int main(int argc, char **argv){
     tas[i].q = q;
     tas[i].m = m;
     tas[i].done = &done;
+    tas[i].log_id = num_client_threads + i;
     tas[i].verbose = verbose;
+    tas[i].log = log;
     thread_create_perror(&tids[i], trader_thread, &tas[i]);
   }
   /* join client threads after each client's orders are fulfilled */
@@ -346,20 +367,27 @@ int main(int argc, char **argv){
   for (i = 0; i < num_trader_threads; i++){
     thread_join_perror(tids[i], NULL);
   }
-  end = ctimer();
-  if (verbose) market_print(m);
+  end = time_mono_sec_perror();
+  if (verbose){
+    num_dropped = log_num_dropped(log); /* exact after joining */
+    log_free_perror(log); /* write remaining records */
+    if (num_dropped > 0) printf("%lu log records dropped\n", num_dropped);
+    market_print(m);
+  }
   printf("%f transactions / sec\n",
 	 orders_per_client * num_client_threads / (end - start));
   order_q_free(q);
   market_free(m);
   free(q);
   free(m);
+  free(log);
   free(cids);
   free(tids);
   free(cas);
   free(tas);
   q = NULL;
   m = NULL;
+  log = NULL;
   cids = NULL;
   tids = NULL;
   cas = NULL;
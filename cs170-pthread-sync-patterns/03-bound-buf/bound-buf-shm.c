@@ -0,0 +1,370 @@
+/**
+   bound-buf-shm.c
+
+   A program for running the bounded buffer example with clients and
+   traders in separate processes, which share the order queue and the
+   market in a POSIX shared memory segment (shm-queue.h). Each client and
+   each trader is a process, and an order is handed off in the segment
+   without copying it through a socket or pipe.
+
+   roles (-R):
+   all     : creates the segment, forks the trader and client processes,
+             and reports (default)
+   traders : creates the segment for -c clients, forks -t trader
+             processes, waits until -c clients finished, and reports over
+             all clients; the clients are started by other runs with
+             -R clients, e.g. in isolated gateway processes
+   clients : maps the segment of a traders run, claims -c consecutive
+             client ids, forks a process for each, and reports over its
+             clients
+   The segment is removed by the run that created it. A traders run
+   detects a client process that crashed, and exits with an error after
+   the other clients finished; a crashed trader process is not detected
+   and blocks its clients.
+
+   usage examples on a 4-core machine:
+   ./bound-buf-shm -c 3 -t 1 -q 16 -s 100 -o 100000
+   ./bound-buf-shm -c 2 -t 2 -q 16 -s 100 -o 100000 -L 4 -V
+   ./bound-buf-shm -R traders -c 4 -t 2 -q 16 -s 100 -n /bb-demo &
+   ./bound-buf-shm -R clients -c 2 -o 100000 -n /bb-demo &
+   ./bound-buf-shm -R clients -c 2 -o 100000 -n /bb-demo
+
+   ./bound-buf-condvar2 -c 3 -t 1 -q 16 -s 100 -o 100000
+   ./bound-buf -b condvar2 -c 3 -t 1 -q 16 -s 100 -o 100000
+*/
+
+#define _XOPEN_SOURCE 600
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include "bound-buf.h"
+#include "workload.h"
+#include "shm-queue.h"
+#include "utilities-mem.h"
+#include "utilities-rand.h"
+#include "utilities-time.h"
+#include "utilities-hist.h"
+
+#define ARGS "c:t:o:q:s:L:n:R:V"
+
+typedef enum{ROLE_ALL, ROLE_TRADERS, ROLE_CLIENTS} role_t;
+
+const int C_DEF_NUM_CLIENTS = 1;
+const int C_DEF_NUM_TRADERS = 1;
+const int C_DEF_ORDERS_PER_CLIENT = 1;
+const int C_DEF_QUEUE_COUNT = 1;
+const int C_DEF_NUM_STOCKS = 1;
+const int C_DEF_QUANTITY = 5000; /* as in bound-buf */
+const int C_DEF_NUM_MARKET_LOCKS = 1;
+const char *C_DEF_SHM_NAME = "/bound-buf";
+const char *C_ROLE_NAMES[] = {"all", "traders", "clients"};
+
+const char *C_USAGE =
+  "bound-buf-shm "
+  "-c clients "
+  "-t traders "
+  "-o orders "
+  "-q queue-count "
+  "-s number-stocks "
+  "-L market-lock-stripes "
+  "-n shm-name "
+  "-R all|traders|clients "
+  "-V <verbose on>\n";
+
+/**
+   Produces orders_per_client orders of a client into its record in the
+   segment, and submits each order after the previous order is fulfilled.
+   Runs in a client process.
+*/
+void client_proc(shmq_t *s,
+		 int id,
+		 int orders_per_client,
+		 const workload_t *w,
+		 rng_t rng){
+  int i;
+  uint64_t now;
+  order_t order;
+  hist_t hist;
+  shmq_order_t *so = &s->clients[id].order;
+  hist_init(&hist);
+  shmq_client_start(s, id);
+  for (i = 0; i < orders_per_client; i++){
+    workload_next(w, &rng, &order);
+    so->stock_id = order.stock_id;
+    so->quantity = order.quantity;
+    so->action = order.action;
+    so->start_ns = time_mono_ns_perror();
+    shmq_submit(s, id);
+    now = time_mono_ns_perror();
+    hist_add(&hist, now - so->start_ns);
+  }
+  shmq_client_finish(s, id, &hist);
+  hist_free(&hist);
+}
+
+/**
+   Dequeues and fulfills orders, as long as there are orders. Runs in a
+   trader process.
+*/
+void trader_proc(shmq_t *s){
+  int id;
+  while ((id = shmq_dequeue(s)) >= 0){
+    shmq_fulfill(s, id);
+  }
+}
+
+/**
+   Forks a process that runs a client if id >= 0 or a trader otherwise.
+   The stdio buffers are flushed before the fork, so that the child does
+   not write the output of the parent again, and the child exits with
+   _exit after flushing its own output.
+*/
+pid_t fork_perror(shmq_t *s,
+		  int id,
+		  int orders_per_client,
+		  const workload_t *w,
+		  rng_t rng){
+  pid_t pid;
+  fflush(NULL);
+  pid = fork();
+  if (pid < 0){
+    perror("fork failed");
+    exit(EXIT_FAILURE);
+  }
+  if (pid == 0){
+    if (id >= 0){
+      client_proc(s, id, orders_per_client, w, rng);
+    }else{
+      trader_proc(s);
+    }
+    fflush(NULL);
+    _exit(EXIT_SUCCESS);
+  }
+  return pid;
+}
+
+/**
+   Waits for n processes, and returns the number of processes that did not
+   exit successfully.
+*/
+int wait_all_perror(const pid_t *pids, int n){
+  int i;
+  int status;
+  int num_failed = 0;
+  for (i = 0; i < n; i++){
+    if (waitpid(pids[i], &status, 0) < 0){
+      perror("waitpid failed");
+      exit(EXIT_FAILURE);
+    }
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != EXIT_SUCCESS){
+      num_failed++;
+    }
+  }
+  return num_failed;
+}
+
+void latency_print(const char *label, const hist_t *h){
+  printf("%s (ns): mean %.0f, p50 %lu, p90 %lu, p99 %lu, "
+	 "p99.9 %lu, max %lu\n",
+	 label,
+	 hist_mean(h),
+	 (unsigned long)hist_quantile(h, 0.5),
+	 (unsigned long)hist_quantile(h, 0.9),
+	 (unsigned long)hist_quantile(h, 0.99),
+	 (unsigned long)hist_quantile(h, 0.999),
+	 (unsigned long)h->max);
+}
+
+void market_print(const shmq_t *s){
+  int i;
+  for (i = 0; i < s->hdr->num_stocks; i++){
+    printf("stock: %d, quantity: %d\n", i, s->quantities[i]);
+  }
+}
+
+int main(int argc, char **argv){
+  int i;
+  int c;
+  int first_id = 0;
+  int num_clients = C_DEF_NUM_CLIENTS;
+  int num_traders = C_DEF_NUM_TRADERS;
+  int orders_per_client = C_DEF_ORDERS_PER_CLIENT;
+  int queue_count = C_DEF_QUEUE_COUNT;
+  int num_stocks = C_DEF_NUM_STOCKS;
+  int num_market_locks = C_DEF_NUM_MARKET_LOCKS;
+  int num_failed = 0;
+  int num_crashed = 0;
+  int num_cpids = 0;
+  double start, end;
+  const char *name = C_DEF_SHM_NAME;
+  boolean_t verbose = FALSE;
+  role_t role = ROLE_ALL;
+  pid_t *cpids = NULL;
+  pid_t *tpids = NULL;
+  workload_t *w = NULL;
+  shmq_t s;
+  hist_t hist;
+  rng_t rng, client_rng;
+  rng_seed(&rng, time(NULL));
+  while ((c = getopt(argc, argv, ARGS)) != -1){
+    switch (c){
+    case 'c':
+      num_clients = atoi(optarg);
+      if (num_clients < 1){
+	fprintf(stderr,"number of clients must be > 0\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 't':
+      num_traders = atoi(optarg);
+      if (num_traders < 1){
+	fprintf(stderr,"number of traders must be > 0\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'o':
+      orders_per_client = atoi(optarg);
+      if (orders_per_client < 0){
+	fprintf(stderr,"orders per client must be non-negative\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'q':
+      queue_count = atoi(optarg);
+      if (queue_count < 1 || queue_count > INT_MAX - 1){
+	fprintf(stderr,"invalid queue count\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 's':
+      num_stocks = atoi(optarg);
+      if (num_stocks < 1){
+	fprintf(stderr,"number of stocks must be > 0\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'L':
+      num_market_locks = atoi(optarg);
+      if (num_market_locks < 1){
+	fprintf(stderr,"number of market lock stripes must be > 0\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'n':
+      name = optarg;
+      if (name[0] != '/' || strchr(name + 1, '/') != NULL){
+	fprintf(stderr,"shm name must be /name without further slashes\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'R':
+      if (strcmp(optarg, "all") == 0){
+	role = ROLE_ALL;
+      }else if (strcmp(optarg, "traders") == 0){
+	role = ROLE_TRADERS;
+      }else if (strcmp(optarg, "clients") == 0){
+	role = ROLE_CLIENTS;
+      }else{
+	fprintf(stderr,"role must be all, traders, or clients\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'V':
+      verbose = TRUE;
+      break;
+    default:
+      fprintf(stderr, "unrecognized command %c\n", (char)c);
+      fprintf(stderr,"usage: %s", C_USAGE);
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (role == ROLE_CLIENTS){
+    shmq_open_perror(&s, name);
+    /* claim consecutive ids, so that the orders of a client are drawn
+       from the stream of its id, as in bound-buf */
+    first_id = shmq_claim(&s, num_clients);
+    if (first_id < 0){
+      fprintf(stderr,"%s has no %d free client ids\n", name, num_clients);
+      exit(EXIT_FAILURE);
+    }
+    num_stocks = s.hdr->num_stocks;
+  }else{
+    shmq_create_perror(&s, name, queue_count, num_clients, num_stocks,
+		       C_DEF_QUANTITY, num_market_locks);
+  }
+  w = malloc_perror(1, sizeof(workload_t));
+  workload_defaults(w);
+  workload_init(w, num_stocks, C_DEF_QUANTITY);
+  cpids = malloc_perror(num_clients, sizeof(pid_t));
+  tpids = malloc_perror(num_traders, sizeof(pid_t));
+  start = time_mono_sec_perror();
+  /* fork processes */
+  if (role != ROLE_CLIENTS){
+    for (i = 0; i < num_traders; i++){
+      tpids[i] = fork_perror(&s, -1, 0, w, rng);
+    }
+  }
+  if (role != ROLE_TRADERS){
+    for (i = 0; i < first_id; i++){
+      rng_jump(&rng);
+    }
+    for (i = 0; i < num_clients; i++){
+      client_rng = rng;
+      rng_jump(&rng);
+      cpids[i] = fork_perror(&s, first_id + i, orders_per_client, w,
+			     client_rng);
+      num_cpids++;
+    }
+  }
+  num_failed += wait_all_perror(cpids, num_cpids);
+  if (role == ROLE_CLIENTS){
+    end = time_mono_sec_perror();
+  }else{
+    if (num_failed == 0) num_crashed = shmq_wait_clients(&s);
+    shmq_done(&s);
+    num_failed += wait_all_perror(tpids, num_traders);
+    shmq_unlink_perror(name);
+    start = s.hdr->start_ns / 1e9;
+    end = s.hdr->end_ns / 1e9;
+  }
+  if (num_failed > 0){
+    fprintf(stderr,"%d processes failed\n", num_failed);
+    exit(EXIT_FAILURE);
+  }
+  if (num_crashed > 0){
+    fprintf(stderr,"%d clients of other runs crashed\n", num_crashed);
+    exit(EXIT_FAILURE);
+  }
+  hist_init(&hist);
+  for (i = first_id; i < first_id + num_clients; i++){
+    shmq_client_hist(&s, i, &hist);
+  }
+  if (verbose && role != ROLE_CLIENTS){
+    printf("queue: %lu signals issued, %lu skipped without waiters\n",
+	   s.hdr->num_signals, s.hdr->num_signals_skipped);
+    printf("orders: %lu invalid, locks: %lu acquired after owner died\n",
+	   s.hdr->num_invalid, s.hdr->num_owner_dead);
+    market_print(&s);
+  }
+  printf("shm %s, %s: %f transactions / sec\n",
+	 name,
+	 C_ROLE_NAMES[role],
+	 hist.count / (end - start));
+  latency_print("latency", &hist);
+  hist_free(&hist);
+  shmq_close_perror(&s);
+  workload_free(w);
+  free(w);
+  free(cpids);
+  free(tpids);
+  w = NULL;
+  cpids = NULL;
+  tpids = NULL;
+  return 0;
+}
@@ -0,0 +1,189 @@
+#!/bin/sh
+#
+# bound-buf-sweep.sh
+#
+# A harness for sweeping the number of clients, traders, queue count, and
+# number of stocks across bound-buf backends. Each configuration is run
+# with warmup runs, which are discarded, and repetitions, which are
+# reduced to the median, minimum, and maximum of transactions / sec, and
+# the relative spread (max - min) / median, and to the medians of the
+# p50 and p99 order latencies. The results are written to <out>.csv and,
+# together with the host topology, to <out>.json.
+#
+# With -R, each configuration is also swept across open-loop arrival
+# rates in orders / sec per client, where a rate of 0 selects closed-loop
+# clients.
+#
+# usage: ./bound-buf-sweep.sh [-b backends] [-c clients] [-t traders]
+#                             [-q queue-counts] [-s stocks] [-R rates]
+#                             [-o orders] [-w warmups] [-r repetitions]
+#                             [-f out]
+# where each of backends, clients, traders, queue-counts, stocks, and
+# rates is a quoted space-separated list.
+#
+# usage examples on a 4-core machine:
+# ./bound-buf-sweep.sh -b "condvar2 sema" -c "1 2 3" -t "1 2" -q "1 4 16" \
+#                      -s "10 100" -o 100000 -w 1 -r 5 -f sweep
+# ./bound-buf-sweep.sh -b "condvar2 sema" -c 2 -t 2 -q 16 -s 100 \
+#                      -R "10000 50000 100000 200000" -o 100000 -f latency
+
+set -e
+
+BIN=./bound-buf
+BACKENDS="mutex condvar1 condvar2 sema latch latch-inline drr prio"
+CLIENTS="1 3"
+TRADERS="1 3"
+QUEUES="1 4"
+STOCKS="100"
+RATES="0"
+ORDERS=10000
+WARMUPS=1
+REPS=5
+OUT=bound-buf-sweep
+
+USAGE="usage: $0 [-b backends] [-c clients] [-t traders] [-q queue-counts]
+       [-s stocks] [-R rates] [-o orders] [-w warmups] [-r repetitions]
+       [-f out]"
+
+while getopts "b:c:t:q:s:R:o:w:r:f:" opt; do
+  case $opt in
+    b) BACKENDS=$OPTARG ;;
+    c) CLIENTS=$OPTARG ;;
+    t) TRADERS=$OPTARG ;;
+    q) QUEUES=$OPTARG ;;
+    s) STOCKS=$OPTARG ;;
+    R) RATES=$OPTARG ;;
+    o) ORDERS=$OPTARG ;;
+    w) WARMUPS=$OPTARG ;;
+    r) REPS=$OPTARG ;;
+    f) OUT=$OPTARG ;;
+    *) echo "$USAGE" >&2; exit 1 ;;
+  esac
+done
+
+if [ "$REPS" -lt 1 ]; then
+  echo "number of repetitions must be > 0" >&2
+  exit 1
+fi
+if [ ! -x "$BIN" ]; then
+  echo "$BIN not found; run make first" >&2
+  exit 1
+fi
+
+# host topology; fields that are unavailable are left empty
+cpu_field(){
+  lscpu 2>/dev/null | sed -n "s/^$1:[[:space:]]*//p" | head -n 1
+}
+HOST_NAME=$(uname -n)
+HOST_KERNEL=$(uname -r)
+HOST_ARCH=$(uname -m)
+HOST_CPUS=$(getconf _NPROCESSORS_ONLN 2>/dev/null || echo "")
+HOST_MODEL=$(cpu_field "Model name" | sed 's/"/\\"/g')
+HOST_SOCKETS=$(cpu_field "Socket(s)")
+HOST_CORES=$(cpu_field "Core(s) per socket")
+HOST_THREADS=$(cpu_field "Thread(s) per core")
+HOST_NUMA=$(cpu_field "NUMA node(s)")
+HOST_DATE=$(date -u +%Y-%m-%dT%H:%M:%SZ)
+
+# median of a space-separated list of numbers
+median(){
+  echo $1 | tr ' ' '\n' | sort -n | awk '
+    { v[NR] = $1 }
+    END {
+      if (NR % 2) printf "%f", v[(NR + 1) / 2]
+      else printf "%f", (v[NR / 2] + v[NR / 2 + 1]) / 2
+    }'
+}
+
+CSV=$OUT.csv
+JSON=$OUT.json
+ROWS=$OUT.rows.tmp
+: > "$ROWS"
+
+echo "backend,clients,traders,queue_count,stocks,rate,orders_per_client,\
+reps,median_tps,min_tps,max_tps,rel_spread,median_p50_ns,median_p99_ns" \
+     > "$CSV"
+
+for b in $BACKENDS; do
+  for c in $CLIENTS; do
+    for t in $TRADERS; do
+      for q in $QUEUES; do
+        for s in $STOCKS; do
+          for R in $RATES; do
+            args="-b $b -c $c -t $t -q $q -s $s -o $ORDERS -F csv"
+            if [ "$R" != "0" ]; then
+              args="$args -r $R"
+            fi
+            i=0
+            while [ $i -lt "$WARMUPS" ]; do
+              $BIN $args > /dev/null
+              i=$((i + 1))
+            done
+            i=0
+            tps=""
+            p50=""
+            p99=""
+            while [ $i -lt "$REPS" ]; do
+              res=$($BIN $args)
+              tps="$tps $(echo "$res" | cut -d, -f8)"
+              p50="$p50 $(echo "$res" | cut -d, -f10)"
+              p99="$p99 $(echo "$res" | cut -d, -f11)"
+              i=$((i + 1))
+            done
+            # median, min, max, and relative spread of the repetitions
+            stats=$(echo $tps | tr ' ' '\n' | sort -n | awk '
+              { v[NR] = $1 }
+              END {
+                if (NR % 2) med = v[(NR + 1) / 2]
+                else med = (v[NR / 2] + v[NR / 2 + 1]) / 2
+                spread = (med > 0) ? (v[NR] - v[1]) / med : 0
+                printf "%f,%f,%f,%f", med, v[1], v[NR], spread
+              }')
+            row="$b,$c,$t,$q,$s,$R,$ORDERS,$REPS,$stats"
+            row="$row,$(median "$p50"),$(median "$p99")"
+            echo "$row" >> "$CSV"
+            echo "$row" >> "$ROWS"
+            echo "$row"
+          done
+        done
+      done
+    done
+  done
+done
+
+{
+  echo "{"
+  echo "  \"host\": {"
+  echo "    \"name\": \"$HOST_NAME\","
+  echo "    \"kernel\": \"$HOST_KERNEL\","
+  echo "    \"arch\": \"$HOST_ARCH\","
+  echo "    \"model\": \"$HOST_MODEL\","
+  echo "    \"online_cpus\": \"$HOST_CPUS\","
+  echo "    \"sockets\": \"$HOST_SOCKETS\","
+  echo "    \"cores_per_socket\": \"$HOST_CORES\","
+  echo "    \"threads_per_core\": \"$HOST_THREADS\","
+  echo "    \"numa_nodes\": \"$HOST_NUMA\","
+  echo "    \"date\": \"$HOST_DATE\""
+  echo "  },"
+  echo "  \"warmups\": $WARMUPS,"
+  echo "  \"results\": ["
+  awk -F, '
+    {
+      if (NR > 1) printf ",\n"
+      printf "    {\"backend\": \"%s\", \"clients\": %s, \"traders\": %s, ", \
+             $1, $2, $3
+      printf "\"queue_count\": %s, \"stocks\": %s, \"rate\": %s, ", \
+             $4, $5, $6
+      printf "\"orders_per_client\": %s, \"reps\": %s, ", $7, $8
+      printf "\"median_tps\": %s, \"min_tps\": %s, \"max_tps\": %s, ", \
+             $9, $10, $11
+      printf "\"rel_spread\": %s, ", $12
+      printf "\"median_p50_ns\": %s, \"median_p99_ns\": %s}", $13, $14
+    }
+    END { if (NR > 0) printf "\n" }' "$ROWS"
+  echo "  ]"
+  echo "}"
+} > "$JSON"
+rm -f "$ROWS"
+
+echo "wrote $CSV and $JSON"
@@ -0,0 +1,1661 @@
+/**
+   bound-buf.c
+
+   A program for running a bounded buffer (producer-consumer) example
+   with a synchronization backend that is selected at runtime. All
+   backends share the order production, timers, and reporting in this
+   file, and the market (market.h) and traders (trader.h), and differ only
+   in how the queue and the order completion are synchronized
+   (bound-buf.h).
+
+   backends:
+   mutex    : mutex locks only, polling (backend-mutex.c)
+   condvar1 : mutex locks and condition variables for the queue, polling
+              for order completion (backend-condvar1.c)
+   condvar2 : mutex locks and condition variables for the queue and order
+              completion (backend-condvar2.c)
+   sema     : semaphores for the queue and order completion
+              (backend-sema.c)
+   latch    : mutex locks and condition variables for the queue, and a
+              one-shot futex latch for order completion (backend-latch.c)
+   latch-inline : as latch, with order records copied into
+              cache-line-aligned queue slots instead of queuing order
+              pointers (backend-latch.c)
+   drr      : deficit round robin across a sub-queue of -q orders for
+              each client, with client weights, and a latch for order
+              completion (backend-drr.c)
+   prio     : urgent and normal lanes, with urgent orders first and
+              anti-starvation of normal orders, and a latch for order
+              completion (backend-prio.c)
+
+   usage example on a 4-core machine:
+   ./bound-buf -b mutex -c 3 -t 1 -q 1 -s 100 -o 100000
+   ./bound-buf -b condvar1 -c 3 -t 1 -q 1 -s 100 -o 100000
+   ./bound-buf -b condvar2 -c 3 -t 1 -q 1 -s 100 -o 100000
+   ./bound-buf -b sema -c 3 -t 1 -q 1 -s 100 -o 100000
+   ./bound-buf -b latch -c 3 -t 1 -q 1 -s 100 -o 100000
+   ./bound-buf -b latch-inline -c 3 -t 1 -q 1 -s 100 -o 100000
+   ./bound-buf -b drr -c 3 -t 1 -q 1 -s 100 -o 100000
+   ./bound-buf -b prio -c 3 -t 1 -q 1 -s 100 -o 100000 -U 0.1
+   ./bound-buf -b condvar2 -c 2 -t 2 -q 3 -s 10 -o 3 -V
+
+   The workload is configured with
+   -d uniform|zipf:<s>|hot:<hot_prob>:<hot_frac> for the stock distribution,
+   -p <prob> for the probability of BUY orders,
+   -Q uniform|pareto:<alpha> for the quantity distribution, and
+   -S <ns> for the service time that a trader spends on a stock per order,
+   and the market is locked with -L <stripes> mutexes, stock i with
+   mutex i % stripes, for benchmarking hot-stock contention (workload.h):
+   ./bound-buf -b condvar2 -c 3 -t 3 -q 4 -s 1000 -o 100000 -d zipf:1.2 -L 64
+   ./bound-buf -b condvar2 -c 3 -t 3 -q 4 -s 1000 -o 100000 -d hot:0.9:0.01
+   ./bound-buf -b sema -c 3 -t 3 -q 4 -s 100 -o 10000 -Q pareto:1.1 -S 2000
+
+   Clients are closed-loop by default, i.e. a client queues an order after
+   its previous order is fulfilled. With -r <orders / sec>, each client is
+   open-loop and queues orders at the intended send times of a constant
+   (-a const) or Poisson (-a poisson) arrival process at the given rate,
+   without waiting for the fulfillment of previous orders. The latency of
+   an order is measured from its intended send time to its fulfillment,
+   so that the time a client is blocked on a full queue is included in the
+   latency instead of reducing the offered load (coordinated omission).
+   ./bound-buf -b condvar2 -c 2 -t 2 -q 16 -s 100 -o 100000 -r 50000
+   ./bound-buf -b sema -c 2 -t 2 -q 16 -s 100 -o 100000 -r 50000 -a poisson
+
+   -r and -w take a comma-separated list of per-client values, where the
+   last value applies to the remaining clients, and a rate of 0 selects a
+   closed-loop client. With -w, the drr backend serves backlogged clients
+   in proportion to their weights (1 by default). The latency of each
+   client is printed if verbose. A noisy client 0 at a rate above the
+   capacity of the traders, with quiet clients at a low rate:
+   ./bound-buf -b latch -c 8 -t 1 -q 64 -o 20000 -r 500000,2000 -V
+   ./bound-buf -b drr -c 8 -t 1 -q 64 -o 20000 -r 500000,2000 -V
+   ./bound-buf -b drr -c 8 -t 1 -q 64 -o 20000 -r 500000,2000 -w 1,4 -V
+
+   With -U <prob>, an order is urgent with the given probability, e.g. a
+   cancel, and normal otherwise. The prio backend dequeues urgent orders
+   first, and, with -P <burst>[:<age-ns>], dequeues a waiting normal
+   order after at most burst urgent orders in a row (8 by default), or if
+   it was sent at least age-ns before the next urgent order. Other
+   backends ignore the lane of an order. The latency of each lane is
+   printed after the latency. Because a client that is blocked on a full
+   lane also delays its next urgent order, the lanes are deep in the
+   saturating examples:
+   ./bound-buf -b latch -c 2 -t 1 -q 20000 -o 20000 -r 180000 -S 2500 -U 0.05
+   ./bound-buf -b prio -c 2 -t 1 -q 20000 -o 20000 -r 180000 -S 2500 -U 0.05
+   ./bound-buf -b prio -c 2 -t 1 -q 20000 -o 20000 -r 180000 -S 2500 \
+               -U 0.5 -P 4:5000000
+
+   With -B <k>, a closed-loop client produces a batch of k orders, queues
+   the batch with one lock acquisition (or one multi-slot reservation in
+   the sema backend) for as many orders as fit in the queue, and waits
+   once for the fulfillment of all orders of the batch, which is tracked
+   with a shared counter of pending orders:
+   ./bound-buf -b latch -c 3 -t 3 -q 64 -s 100 -o 100000 -B 16
+   ./bound-buf -b sema -c 3 -t 3 -q 64 -s 100 -o 100000 -B 16
+
+   Traders of the condition variable queue backends (condvar1, condvar2,
+   latch, latch-inline) block on an empty queue by default (-W block).
+   With -W spin:<n>[:<yields>], a trader polls an empty queue with a pause
+   for up to n iterations, then with a yield of the processor for up to
+   yields times, before blocking. The time that traders spent in each
+   phase is printed after the latency:
+   ./bound-buf -b latch -c 2 -t 2 -q 16 -s 100 -o 100000 -W spin:2000:10
+   ./bound-buf -b latch -c 2 -t 2 -q 16 -o 100000 -r 50000 -W spin:0:50
+
+   An order that arrives at a full condition variable queue blocks the
+   client by default (-A block). Under overload, orders can instead be
+   shed by rejecting them at enqueue, with -A fail for rejecting if the
+   queue is full, -A timed:<ns> for rejecting if the queue is still full
+   after ns, or -A codel:<target-ns>:<interval-ns> for blocking while
+   full and rejecting after the queuing delay of orders has stayed above
+   target-ns for interval-ns, until it is below target-ns (bound-buf.h). A
+   rejected order is counted and not fulfilled, and the throughput and
+   latency are of the fulfilled orders. The backends without a condition
+   variable queue support only -A block:
+   ./bound-buf -b latch -c 4 -t 1 -q 64 -o 20000 -r 100000 -S 5000 -A fail
+   ./bound-buf -b latch -c 4 -t 1 -q 64 -o 20000 -r 100000 -S 5000 \
+               -A codel:500000:5000000
+
+   With -X <ns>[:<tick-ns>], each order of a client thread has a time in
+   force of ns from its (intended) send time. The deadlines are timed by
+   a hierarchical timing wheel with a timer thread (utilities-pthread.h),
+   with a tick of tick-ns (100 us by default). An order that is still
+   queued at its deadline expires: its client is informed at once and
+   continues with its next order, and the trader that dequeues the
+   expired order drops it without trading. A trader also drops an order
+   that it dequeues after its deadline before the timer expired it, and
+   an order waits for a full condition variable queue at most until its
+   deadline. Expired orders are counted and not fulfilled, and the
+   throughput and latency are of the fulfilled orders:
+   ./bound-buf -b latch -c 4 -t 1 -q 64 -o 20000 -r 100000 -S 5000 \
+               -X 2000000
+
+   With -E <min>[:<period-ns>], the number of trader threads is elastic
+   between min and -t traders. A supervisor thread samples the queue
+   occupancy and the busy time of the active traders every period-ns
+   (1 ms by default), activates a trader when the queue is half full,
+   and retires a trader after ten samples in a row with an almost empty
+   queue and mostly idle traders. Traders are spawned on the first
+   activation, and retired traders are parked instead of exiting
+   (pool.h). The mean number of active traders is printed:
+   ./bound-buf -b latch -c 4 -t 4 -q 64 -o 50000 -r 20000 -E 1
+   ./bound-buf -b latch -c 4 -t 4 -q 64 -o 50000 -r 20000 -E 1:200000
+
+   With -G <validate>:<risk>:<execute>:<settle>, orders are processed by
+   a pipeline of stages with the given numbers of threads instead of by
+   -t traders, where each stage dequeues from its own queue of -q orders
+   of the backend and queues at the next stage. An order is validated
+   against the market, checked against a net position limit of its
+   client, executed on the market with the service time, and settled on
+   the account of its client, and completed after settlement or a
+   rejection (pipeline.h). A rejected order is counted and not
+   fulfilled, as with -A. The throughput, rejected orders, input queue
+   depth after a dequeue, and latency from queuing to the end of each
+   stage are printed, so that the bottleneck stage can be found and
+   scaled:
+   ./bound-buf -b latch -c 3 -q 16 -s 100 -o 100000 -S 2000 -G 1:1:1:1
+   ./bound-buf -b latch -c 3 -q 16 -s 100 -o 100000 -S 2000 -G 1:1:3:1
+
+   With -M <ring-count>[:<audit-ns>], a trader publishes a fill for each
+   executed order on a multicast ring of ring-count fills after informing
+   the client, and audit, risk, and market-data consumer threads each read
+   every fill at their own pace (fill-bus.h). The audit consumer checks
+   that the fills are gapless and spends audit-ns per fill, the risk
+   consumer tracks the net position of each client, and the market-data
+   consumer tracks the traded volume of each stock. A trader blocks while
+   the ring is full until the slowest consumer catches up. The fills per
+   batch read by a consumer, the lag from fulfillment to consumption, and
+   the blocked publishes are printed:
+   ./bound-buf -b latch -c 3 -t 3 -q 16 -s 100 -o 100000 -M 1024
+   ./bound-buf -b latch -c 3 -t 3 -q 16 -s 100 -o 100000 -M 64:2000
+
+   With -J <path>[:write|async|sync[:<max-batch>]], each applied order is
+   appended to a write-ahead journal file under the lock of its stock,
+   and a flusher thread commits the appended records in batches of up to
+   max-batch records (1024 by default) with one write and one fdatasync
+   per batch (group commit, journal.h). At the sync level (by default), an
+   order is fulfilled by the flusher after its commit, so that a trader
+   dequeues the next order during a commit and the records of all
+   clients share an fdatasync; at the async level, orders are fulfilled
+   before their commit, and at the write level, records are written
+   without fdatasync. The commits and fdatasyncs per second, the records
+   per commit, and the commit time are printed, so that the effect of
+   max-batch on the throughput can be measured:
+   ./bound-buf -b latch -c 8 -t 2 -q 16 -s 100 -o 10000 -J /tmp/bb.jrnl
+   ./bound-buf -b latch -c 8 -t 2 -q 16 -s 100 -o 10000 -J /tmp/bb.jrnl:sync:1
+   ./bound-buf -b latch -c 8 -t 2 -q 16 -s 100 -o 10000 -J /tmp/bb.jrnl:async
+
+   With -Y <period-ns>[:cow|stw], a snapshot thread takes a
+   point-in-time consistent copy of the quantities of all stocks every
+   period-ns while traders keep running, and computes the total quantity
+   and the empty stocks of each snapshot, as a risk report would. In the
+   cow mode (by default), a snapshot increments an epoch, and each stripe
+   of the market locks is copied either by the snapshot thread, holding
+   one stripe lock at a time, or by the first trader that updates the
+   stripe afterwards, before its update (copy-on-write). In the stw mode,
+   the snapshot thread holds all stripe locks while copying, which pauses
+   all traders (snapshot.h). The snapshot duration, the longest hold of
+   stripe locks by the snapshot thread, and the stripe copies by traders
+   are printed:
+   ./bound-buf -b latch -c 3 -t 3 -q 16 -s 100000 -o 100000 -L 64 \
+               -Y 200000000
+   ./bound-buf -b latch -c 3 -t 3 -q 16 -s 100000 -o 100000 -L 64 \
+               -Y 200000000:stw
+
+   With -m <market-file>, the quantities of the stocks are mapped from a
+   market file (market-map.h), so that the market state of a run is the
+   initial state of the next run, and a restart maps the file instead of
+   initializing the quantities. The file is created with -s stocks if it
+   does not exist, and must have -s stocks otherwise. The time to
+   initialize the market is printed. Market files are created and
+   inspected with market-file (market-file.c):
+   ./bound-buf -b latch -c 3 -t 3 -q 16 -s 50000 -o 100000 -m /tmp/market.bb
+   ./market-file inspect /tmp/market.bb
+
+   With -T <order-trace>, clients replay the orders of a trace that was
+   generated with trace-gen (trace.h, trace-gen.c) instead of drawing
+   orders from the workload, so that runs queue identical order streams,
+   e.g. for comparing backends, without the cost of order generation. The
+   trace is mapped read-only, and each client reads its orders from its
+   own slice of the mapping. The clients, orders per client, and stocks
+   are those of the trace by default. -c and -o must not exceed those of
+   the trace, and -s must be at least the stocks of the trace, so that the
+   market covers every traced stock id. The stock, buy, quantity, and
+   urgent options are ignored:
+   ./trace-gen -c 3 -o 100000 -s 100 -d zipf:1.2 -x 42 /tmp/orders.trace
+   ./bound-buf -b latch -t 3 -q 16 -T /tmp/orders.trace
+   ./bound-buf -b sema -t 3 -q 16 -T /tmp/orders.trace
+
+   With -I <socket-path>[:<connections>[:<window>]], orders are also
+   accepted from other local processes over a Unix domain socket by an
+   epoll-driven ingress thread (ingress.h), e.g. from the load generator
+   ingress-gen (ingress-gen.c). The orders of the ingress are queued with
+   the client id after the client threads, and traders wake the ingress
+   thread through an eventfd to respond to fulfilled orders. The run ends
+   after the client threads are done and the given number of connections
+   (1 by default) were accepted and closed. A connection may have at most
+   window orders (64 by default) without a response. The transactions
+   per second include the time before the connections are accepted:
+   ./bound-buf -b latch -c 1 -o 0 -t 2 -q 64 -s 100 -I /tmp/bb.sock:2 &
+   ./ingress-gen -c 2 -o 100000 -w 32 -s 100 /tmp/bb.sock
+
+   With -F csv, a single row without a header is printed in the format
+   backend,clients,traders,queue_count,stocks,orders_per_client,seconds,
+   transactions_per_sec,offered_per_sec,p50_ns,p99_ns,p999_ns,max_ns,
+   rejected
+   for collecting results across runs with bound-buf-sweep.sh, where
+   offered_per_sec is 0 for closed-loop clients.
+
+   In contrast to bound-buf-sema.c, the market is locked with a mutex in
+   all backends, so that the market updates are identical across backends.
+*/
+
+#define _XOPEN_SOURCE 600
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include <limits.h>
+#include <math.h>
+#include <pthread.h>
+#include "bound-buf.h"
+#include "workload.h"
+#include "fill-bus.h"
+#include "journal.h"
+#include "market.h"
+#include "trace.h"
+#include "ingress.h"
+#include "pool.h"
+#include "trader.h"
+#include "pipeline.h"
+#include "snapshot.h"
+#include "utilities-mem.h"
+#include "utilities-pthread.h"
+#include "utilities-rand.h"
+#include "utilities-time.h"
+#include "utilities-log.h"
+#include "utilities-hist.h"
+
+#define ARGS "b:c:t:o:q:s:d:p:Q:S:L:r:w:a:U:P:B:W:A:X:E:G:M:J:Y:m:T:I:F:V"
+
+const int C_DEF_NUM_CLIENT_THREADS = 1;
+const int C_DEF_NUM_TRADER_THREADS = 1;
+const int C_DEF_ORDERS_PER_CLIENT = 1;
+const int C_DEF_QUEUE_COUNT = 1;
+const int C_DEF_NUM_STOCKS = 1;
+const int C_DEF_QUANTITY = 5000;
+const int C_DEF_NUM_MARKET_LOCKS = 1;
+const int C_DEF_LANE_BURST = 8;
+const uint64_t C_DEF_WHEEL_TICK_NS = 100000;
+const double C_NS_PER_SEC = 1000000000.0;
+const uint64_t C_SPIN_NS = 100000; /* spin before an intended send time */
+const int C_LOG_RING_COUNT = 1024;
+const int C_PATH_SIZE = 4096;
+const char *C_LOG_QUEUED_BUY = "client %ld: queued stock %ld, for %ld, BUY\n";
+const char *C_LOG_QUEUED_SELL = "client %ld: queued stock %ld, for %ld, SELL\n";
+
+const backend_t *C_BACKENDS[] = {&C_BACKEND_MUTEX,
+				 &C_BACKEND_CONDVAR1,
+				 &C_BACKEND_CONDVAR2,
+				 &C_BACKEND_SEMA,
+				 &C_BACKEND_LATCH,
+				 &C_BACKEND_LATCH_INLINE,
+				 &C_BACKEND_DRR,
+				 &C_BACKEND_PRIO,
+				 NULL};
+const backend_t *C_DEF_BACKEND = &C_BACKEND_CONDVAR2;
+
+const char *C_USAGE =
+  "bound-buf "
+  "-b mutex|condvar1|condvar2|sema|latch|latch-inline|drr|prio "
+  "-c clients "
+  "-t traders "
+  "-o orders "
+  "-q queue-count "
+  "-s number-stocks "
+  "-d uniform|zipf:s|hot:prob:frac "
+  "-p buy-probability "
+  "-Q uniform|pareto:alpha "
+  "-S service-ns "
+  "-L market-lock-stripes ";
+const char *C_USAGE_SCHED = /* ISO C90 bounds the length of a string */
+  "-r orders-per-sec-per-client[,...] "
+  "-w client-weight[,...] "
+  "-a const|poisson "
+  "-U urgent-probability "
+  "-P lane-burst[:lane-age-ns] "
+  "-B batch-count "
+  "-W block|spin:spins[:yields] "
+  "-A block|fail|timed:ns|codel:target-ns:interval-ns "
+  "-X time-in-force-ns[:tick-ns] "
+  "-E min-traders[:period-ns] "
+  "-G validate:risk:execute:settle "
+  "-M fill-ring-count[:audit-ns] "
+  "-J path[:write|async|sync[:max-batch]] "
+  "-Y snapshot-period-ns[:cow|stw] "
+  "-m market-file "
+  "-T order-trace "
+  "-I socket-path[:connections[:window]] "
+  "-F text|csv "
+  "-V <verbose on>\n";
+
+/**
+   Allocates an order of order_size bytes of a backend. Shared by all
+   backends.
+*/
+order_t *order_alloc(const backend_t *b){
+  return malloc_perror(1, b->order_size);
+}
+
+/**
+   Copies an order into a record, with the order as the completion handle.
+   Shared by all backends.
+*/
+void order_rec_set(order_rec_t *rec, order_t *order){
+  rec->stock_id = order->stock_id;
+  rec->quantity = order->quantity;
+  rec->action = order->action;
+  rec->lane = order->lane;
+  rec->client_id = order->client_id;
+  rec->start_ns = order->start_ns;
+  rec->stage_ns = order->stage_ns;
+  rec->deadline_ns = order->deadline_ns;
+  rec->order = order;
+  rec->batch = order->batch;
+}
+
+/**
+   Client (producer) thread arguments and entry functions. The traders
+   (consumers) are in trader.h.
+*/
+
+typedef enum{ARRIVAL_CONST, ARRIVAL_POISSON} arrival_t;
+
+typedef struct{
+  int id;
+  int order_count;
+  int pool_count; /* orders in flight in open loop */
+  int batch_count; /* orders per batch; 1 if no batching */
+  double rate; /* orders / sec in open loop, 0.0 in closed loop */
+  arrival_t arrival;
+  unsigned long num_rejected; /* by the admission policy or a stage */
+  uint64_t tif_ns; /* time in force of an order */
+  wheel_t *wheel; /* NULL if orders have no deadline */
+  unsigned long num_expired;
+  boolean_t verbose;
+  const workload_t *w; /* read-only; shared by clients and traders */
+  const trace_rec_t *trace; /* orders of the client; NULL if generated */
+  rng_t rng; /* non-overlapping stream of each client */
+  log_t *log; /* ring id is id; only if verbose */
+  const backend_t *b;
+  void *q; /* clients (producers) and traders (consumers) */
+} client_arg_t;
+
+/**
+   Consumers of the fill bus, each with a consumer id of the bus and a
+   thread.
+*/
+typedef enum{CONSUMER_AUDIT,
+	     CONSUMER_RISK,
+	     CONSUMER_MARKET,
+	     NUM_CONSUMERS} consumer_t;
+
+const char *C_CONSUMER_NAMES[] = {"audit", "risk", "market-data"};
+
+typedef struct{
+  consumer_t id;
+  fill_bus_t *bus;
+  uint64_t audit_ns; /* spent per fill by the audit consumer */
+  uint64_t next_seq; /* audit: expected sequence of the next fill */
+  unsigned long num_gaps; /* audit: fills out of sequence */
+  long *positions; /* risk: net quantity bought, per client */
+  long *volumes; /* market data: traded quantity, per stock */
+  unsigned long num_fills;
+  unsigned long num_batches;
+  int max_batch;
+  hist_t lag_hist; /* from fulfillment to consumption, ns */
+} consumer_arg_t;
+
+/**
+   Produces the i-th order of a client, from the slice of the client in a
+   trace, or from the workload.
+*/
+void client_next(client_arg_t *ca, rng_t *rng, int i, order_t *order){
+  if (ca->trace != NULL){
+    trace_order(&ca->trace[i], order);
+  }else{
+    workload_next(ca->w, rng, order);
+  }
+}
+
+/**
+   Allocates and initializes an order of a client.
+*/
+order_t *client_order_new(client_arg_t *ca){
+  order_t *order = NULL;
+  order = order_alloc(ca->b);
+  ca->b->order_init(order);
+  order->client_id = ca->id;
+  order->batch = NULL;
+  wheel_timer_init(&order->expiry);
+  return order;
+}
+
+/**
+   Queues an order with the deadline of the time in force, if any, and
+   arms the timer of the deadline after the order is queued. Returns FALSE
+   and counts the order if it was rejected by the admission policy of the
+   queue or expired at a full queue, and TRUE otherwise.
+*/
+boolean_t client_enqueue(client_arg_t *ca, order_t *order){
+  uint64_t deadline_ns = 0;
+  order->rejected = FALSE;
+  if (ca->wheel != NULL){
+    deadline_ns = order->start_ns + ca->tif_ns;
+    order->state = ORDER_QUEUED; /* published to traders by the queue */
+  }
+  order->deadline_ns = deadline_ns;
+  if (!ca->b->queue_enqueue(ca->q, order)){
+    if (ca->wheel != NULL && time_mono_ns_perror() >= deadline_ns){
+      ca->num_expired++;
+    }else{
+      ca->num_rejected++;
+    }
+    return FALSE;
+  }
+  if (ca->wheel != NULL){
+    /* a trader may have claimed the order; then the timer does nothing */
+    wheel_add_perror(ca->wheel, &order->expiry, deadline_ns);
+  }
+  return TRUE;
+}
+
+/**
+   Counts an order that was rejected by a pipeline stage, and disarms the
+   timer of an order with a deadline, after waiting for the order. Returns
+   the order to use for the next order of the client: the order, or a new
+   order if the order expired and is still referred to by a queue. The
+   trader that dequeues such an order frees it.
+*/
+order_t *client_reclaim(client_arg_t *ca, order_t *order){
+  int expected = ORDER_EXPIRED;
+  if (order->rejected) ca->num_rejected++;
+  if (ca->wheel == NULL) return order;
+  wheel_cancel_perror(ca->wheel, &order->expiry);
+  if (__atomic_load_n(&order->state, __ATOMIC_ACQUIRE) == ORDER_CLAIMED){
+    return order;
+  }
+  ca->num_expired++;
+  if (!__atomic_compare_exchange_n(&order->state, &expected, ORDER_RELEASED,
+				   0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)){
+    return order; /* released by a trader */
+  }
+  return client_order_new(ca);
+}
+
+/**
+   Produces and queues order_count orders. After queuing an order, waits
+   until the order is fulfilled before queuing the next order. A rejected
+   or expired order is followed by the next order.
+*/
+void client_closed_loop(client_arg_t *ca, rng_t *rng){
+  int i;
+  order_t *order = NULL;
+  order = client_order_new(ca);
+  for (i = 0; i < ca->order_count; i++){
+    /* produce an order */
+    client_next(ca, rng, i, order);
+    /* queue the order and wait until fulfilled or expired */
+    order->start_ns = time_mono_ns_perror();
+    if (!client_enqueue(ca, order)) continue;
+    if (ca->verbose){
+      log_write(ca->log, ca->id,
+		(order->action ? C_LOG_QUEUED_SELL : C_LOG_QUEUED_BUY),
+		ca->id, order->stock_id, order->quantity, 0);
+    }
+    ca->b->order_wait(order);
+    order = client_reclaim(ca, order);
+  }
+  ca->b->order_free(order);
+  free(order);
+  order = NULL;
+}
+
+/**
+   Produces and queues order_count orders at the intended send times of
+   an arrival process, without waiting for the fulfillment of previous
+   orders. Orders are taken from a pool of pool_count orders in fifo
+   order; an order is reused after waiting for its previous fulfillment,
+   unless it was rejected, and an expired order that is still queued is
+   replaced. If a client falls behind, the next orders are queued
+   immediately, and their latencies include the delay.
+*/
+void client_open_loop(client_arg_t *ca, rng_t *rng){
+  int i, k;
+  double mean_ns = C_NS_PER_SEC / ca->rate;
+  uint64_t next_ns;
+  order_t *order = NULL;
+  order_t **pool = NULL;
+  boolean_t *pending = NULL; /* queued and not yet waited for */
+  pool = malloc_perror(ca->pool_count, sizeof(order_t *));
+  pending = malloc_perror(ca->pool_count, sizeof(boolean_t));
+  for (i = 0; i < ca->pool_count; i++){
+    pool[i] = client_order_new(ca);
+    pending[i] = FALSE;
+  }
+  next_ns = time_mono_ns_perror();
+  for (i = 0; i < ca->order_count; i++){
+    k = i % ca->pool_count;
+    if (pending[k]){
+      ca->b->order_wait(pool[k]);
+      pool[k] = client_reclaim(ca, pool[k]);
+    }
+    order = pool[k];
+    client_next(ca, rng, i, order);
+    if (ca->arrival == ARRIVAL_POISSON){
+      next_ns += -log(1.0 - rng_unif(rng)) * mean_ns;
+    }else{
+      next_ns += mean_ns;
+    }
+    time_wait_until_ns_perror(next_ns, C_SPIN_NS);
+    order->start_ns = next_ns;
+    pending[k] = client_enqueue(ca, order);
+    if (!pending[k]) continue;
+    if (ca->verbose){
+      log_write(ca->log, ca->id,
+		(order->action ? C_LOG_QUEUED_SELL : C_LOG_QUEUED_BUY),
+		ca->id, order->stock_id, order->quantity, 0);
+    }
+  }
+  /* wait for the orders in flight */
+  for (i = 0; i < ca->pool_count; i++){
+    if (pending[i]){
+      ca->b->order_wait(pool[i]);
+      pool[i] = client_reclaim(ca, pool[i]);
+    }
+  }
+  for (i = 0; i < ca->pool_count; i++){
+    ca->b->order_free(pool[i]);
+    free(pool[i]);
+  }
+  free(pool);
+  free(pending);
+  pool = NULL;
+  pending = NULL;
+}
+
+/**
+   Produces and queues order_count orders in batches of batch_count orders.
+   After queuing a batch, waits until all orders of the batch are
+   fulfilled before queuing the next batch.
+*/
+void client_batch(client_arg_t *ca, rng_t *rng){
+  int i, j, n;
+  uint64_t start_ns;
+  order_t *orders = NULL;
+  order_batch_t *batch = NULL;
+  orders = malloc_perror(ca->batch_count, sizeof(order_t));
+  batch = malloc_perror(1, sizeof(order_batch_t));
+  batch->done = order_alloc(ca->b);
+  ca->b->order_init(batch->done);
+  for (i = 0; i < ca->order_count; i += n){
+    n = ca->order_count - i;
+    if (n > ca->batch_count) n = ca->batch_count;
+    /* produce a batch; published to traders by the queue */
+    for (j = 0; j < n; j++){
+      client_next(ca, rng, i + j, &orders[j]);
+      orders[j].client_id = ca->id;
+      orders[j].deadline_ns = 0; /* no time in force */
+      orders[j].batch = batch;
+      orders[j].rejected = FALSE;
+    }
+    batch->num_pending = n;
+    /* queue the batch and wait until all orders are fulfilled */
+    start_ns = time_mono_ns_perror();
+    for (j = 0; j < n; j++){
+      orders[j].start_ns = start_ns;
+    }
+    ca->b->queue_enqueue_batch(ca->q, orders, n);
+    if (ca->verbose){
+      for (j = 0; j < n; j++){
+	log_write(ca->log, ca->id,
+		  (orders[j].action ? C_LOG_QUEUED_SELL : C_LOG_QUEUED_BUY),
+		  ca->id, orders[j].stock_id, orders[j].quantity, 0);
+      }
+    }
+    ca->b->order_wait(batch->done);
+    for (j = 0; j < n; j++){
+      if (orders[j].rejected) ca->num_rejected++;
+    }
+  }
+  ca->b->order_free(batch->done);
+  free(batch->done);
+  free(orders);
+  free(batch);
+  orders = NULL;
+  batch = NULL;
+}
+
+void *client_thread(void *arg){
+  client_arg_t *ca = arg;
+  rng_t rng = ca->rng; /* thread-local state; no sharing of cache lines */
+  if (ca->rate > 0.0){
+    client_open_loop(ca, &rng);
+  }else if (ca->batch_count > 1){
+    client_batch(ca, &rng);
+  }else{
+    client_closed_loop(ca, &rng);
+  }
+  return NULL;
+}
+
+/**
+   Reads the fills of the bus in batches until the bus is done, and
+   processes each fill according to the consumer id. The lag of a fill is
+   measured once per batch.
+*/
+void *consumer_thread(void *arg){
+  int i, n;
+  uint64_t now_ns;
+  const fill_t *fill = NULL;
+  consumer_arg_t *ca = arg;
+  while ((n = fill_bus_wait(ca->bus, ca->id)) > 0){
+    now_ns = time_mono_ns_perror();
+    for (i = 0; i < n; i++){
+      fill = fill_bus_get(ca->bus, ca->id, i);
+      hist_add(&ca->lag_hist, now_ns - fill->fill_ns);
+      switch (ca->id){
+      case CONSUMER_AUDIT:
+	if (fill->seq != ca->next_seq) ca->num_gaps++;
+	ca->next_seq = fill->seq + 1;
+	if (ca->audit_ns > 0){
+	  time_wait_until_ns_perror(time_mono_ns_perror() + ca->audit_ns,
+				    ca->audit_ns);
+	}
+	break;
+      case CONSUMER_RISK:
+	ca->positions[fill->client_id] +=
+	  (fill->action == BUY) ? fill->quantity : -fill->quantity;
+	break;
+      default:
+	ca->volumes[fill->stock_id] += fill->quantity;
+      }
+    }
+    fill_bus_release(ca->bus, ca->id, n);
+    ca->num_fills += n;
+    ca->num_batches++;
+    if (n > ca->max_batch) ca->max_batch = n;
+  }
+  return NULL;
+}
+
+/**
+   Returns the backend with name, or NULL if there is no such backend.
+*/
+const backend_t *backend_find(const char *name){
+  int i;
+  for (i = 0; C_BACKENDS[i] != NULL; i++){
+    if (strcmp(C_BACKENDS[i]->name, name) == 0) return C_BACKENDS[i];
+  }
+  return NULL;
+}
+
+/**
+   Parses a comma-separated list of at most n doubles into vals, where the
+   last value is repeated for the remaining entries. Returns 0 on success
+   and -1 on invalid input.
+*/
+int list_parse(double *vals, int n, const char *s){
+  int i = 0;
+  char *end = NULL;
+  while (TRUE){
+    if (i == n) return -1;
+    vals[i] = strtod(s, &end);
+    if (end == s) return -1;
+    i++;
+    if (*end == '\0') break;
+    if (*end != ',') return -1;
+    s = end + 1;
+  }
+  for (; i < n; i++){
+    vals[i] = vals[i - 1];
+  }
+  return 0;
+}
+
+/**
+   Parses a trader wait strategy "block" or "spin:<spins>[:<yields>]".
+   Returns 0 on success and -1 on invalid input.
+*/
+int wait_parse(wait_strategy_t *ws, const char *s){
+  int n = 0;
+  ws->num_spins = 0;
+  ws->num_yields = 0;
+  if (strcmp(s, "block") == 0) return 0;
+  if (sscanf(s, "spin:%d%n", &ws->num_spins, &n) != 1) return -1;
+  if (s[n] == ':'){
+    s += n;
+    if (sscanf(s, ":%d%n", &ws->num_yields, &n) != 1) return -1;
+  }
+  if (s[n] != '\0' || ws->num_spins < 0 || ws->num_yields < 0) return -1;
+  return 0;
+}
+
+/**
+   Parses an admission policy "block", "fail", "timed:<ns>", or
+   "codel:<target-ns>:<interval-ns>". Returns 0 on success and -1 on
+   invalid input.
+*/
+int admit_parse(admit_t *admit, const char *s){
+  int n = 0;
+  long a = 0;
+  long b = 0;
+  memset(admit, 0, sizeof(admit_t));
+  if (strcmp(s, "block") == 0){
+    admit->policy = ADMIT_BLOCK;
+  }else if (strcmp(s, "fail") == 0){
+    admit->policy = ADMIT_FAIL;
+  }else if (sscanf(s, "timed:%ld%n", &a, &n) == 1 && s[n] == '\0'){
+    if (a < 0) return -1;
+    admit->policy = ADMIT_TIMED;
+    admit->timeout_ns = a;
+  }else if (sscanf(s, "codel:%ld:%ld%n", &a, &b, &n) == 2 && s[n] == '\0'){
+    if (a < 0 || b < 1) return -1;
+    admit->policy = ADMIT_CODEL;
+    admit->target_ns = a;
+    admit->interval_ns = b;
+  }else{
+    return -1;
+  }
+  return 0;
+}
+
+/**
+   Parses a time in force "<ns>[:<tick-ns>]" of orders and the tick of the
+   timing wheel. Returns 0 on success and -1 on invalid input.
+*/
+int tif_parse(uint64_t *tif_ns, uint64_t *tick_ns, const char *s){
+  int n = 0;
+  long tif = 0;
+  long tick = (long)C_DEF_WHEEL_TICK_NS;
+  if (sscanf(s, "%ld%n", &tif, &n) != 1) return -1;
+  if (s[n] == ':'){
+    s += n;
+    if (sscanf(s, ":%ld%n", &tick, &n) != 1) return -1;
+  }
+  if (s[n] != '\0' || tif < 1 || tick < 1) return -1;
+  *tif_ns = tif;
+  *tick_ns = tick;
+  return 0;
+}
+
+/**
+   Parses a fill bus "<ring-count>[:<audit-ns>]". Returns 0 on success
+   and -1 on invalid input.
+*/
+int bus_parse(int *count, uint64_t *audit_ns, const char *s){
+  int n = 0;
+  long audit = 0;
+  if (sscanf(s, "%d%n", count, &n) != 1) return -1;
+  if (s[n] == ':'){
+    s += n;
+    if (sscanf(s, ":%ld%n", &audit, &n) != 1) return -1;
+  }
+  if (s[n] != '\0' || *count < 1 || audit < 0) return -1;
+  *audit_ns = audit;
+  return 0;
+}
+
+/**
+   Parses a lane scheduling "<burst>[:<age-ns>]" into the queue
+   configuration. Returns 0 on success and -1 on invalid input.
+*/
+int lane_parse(queue_conf_t *conf, const char *s){
+  int n = 0;
+  long age_ns = 0;
+  if (sscanf(s, "%d%n", &conf->lane_burst, &n) != 1) return -1;
+  if (s[n] == ':'){
+    s += n;
+    if (sscanf(s, ":%ld%n", &age_ns, &n) != 1) return -1;
+  }
+  if (s[n] != '\0' || conf->lane_burst < 1 || age_ns < 0) return -1;
+  conf->lane_age_ns = age_ns;
+  return 0;
+}
+
+/**
+   Prints the latency percentiles of a histogram in ns, after a label.
+*/
+void latency_print(const char *label, const hist_t *h){
+  printf("%s (ns): mean %.0f, p50 %lu, p90 %lu, p99 %lu, "
+	 "p99.9 %lu, max %lu\n",
+	 label,
+	 hist_mean(h),
+	 (unsigned long)hist_quantile(h, 0.5),
+	 (unsigned long)hist_quantile(h, 0.9),
+	 (unsigned long)hist_quantile(h, 0.99),
+	 (unsigned long)hist_quantile(h, 0.999),
+	 (unsigned long)h->max);
+}
+
+int main(int argc, char **argv){
+  int i, j, k;
+  int num_client_threads = C_DEF_NUM_CLIENT_THREADS;
+  int num_clients; /* client ids, of the client threads and the ingress */
+  int num_trader_threads = C_DEF_NUM_TRADER_THREADS;
+  int num_tas; /* trader arguments, including one of the journal */
+  int orders_per_client = C_DEF_ORDERS_PER_CLIENT;
+  int queue_count = C_DEF_QUEUE_COUNT;
+  int num_stocks = C_DEF_NUM_STOCKS;
+  int quantity = C_DEF_QUANTITY;
+  int num_market_locks = C_DEF_NUM_MARKET_LOCKS;
+  int batch_count = 1;
+  int num_pool_min = 0; /* 0 if the number of traders is fixed */
+  int num_spawned;
+  int num_queues = 1;
+  uint64_t pool_period_ns = 0;
+  uint64_t tif_ns = 0; /* 0 if orders have no deadline */
+  uint64_t wheel_tick_ns = C_DEF_WHEEL_TICK_NS;
+  wheel_t wheel;
+  unsigned long num_expired = 0;
+  unsigned long num_dropped_expired = 0; /* by traders */
+  int bus_count = 0; /* 0 if fills are not published */
+  uint64_t audit_ns = 0;
+  unsigned long num_bus_stalls = 0;
+  char *journal_path = NULL; /* NULL if no journal */
+  const char *market_path = NULL; /* NULL if the market is not mapped */
+  const char *trace_path = NULL; /* NULL if orders are generated */
+  char *ingress_path = NULL; /* NULL if no ingress */
+  int ingress_conns = 0;
+  int ingress_window = 0;
+  ingress_t ingress;
+  pthread_t ingress_tid;
+  trace_t trace;
+  boolean_t clients_set = FALSE;
+  boolean_t orders_set = FALSE;
+  boolean_t stocks_set = FALSE;
+  boolean_t market_warm;
+  double market_sec;
+  int journal_batch = 0;
+  durability_t journal_level = JOURNAL_SYNC;
+  journal_t journal;
+  snapshot_t snap;
+  unsigned long num_cows = 0;
+  uint64_t cow_ns = 0;
+  uint64_t max_cow_ns = 0;
+  int c;
+  unsigned long num_dropped;
+  unsigned long num_rejected = 0;
+  unsigned long num_fulfilled;
+  double start, end;
+  double total_rate = 0.0;
+  double *rates = NULL;
+  double *weights = NULL;
+  const char *rates_arg = "0";
+  const char *weights_arg = "1";
+  arrival_t arrival = ARRIVAL_CONST;
+  queue_conf_t conf;
+  pipeline_t pipeline;
+  pool_t pool;
+  fill_bus_t bus;
+  pthread_t bus_cids[NUM_CONSUMERS];
+  consumer_arg_t bus_cas[NUM_CONSUMERS];
+  hist_t hist;
+  hist_t lane_hists[NUM_LANES];
+  hist_t *client_hists = NULL;
+  boolean_t verbose = FALSE;
+  boolean_t csv = FALSE;
+  const backend_t *b = C_DEF_BACKEND;
+  void *q = NULL;
+  market_t *m = NULL;
+  workload_t *w = NULL;
+  log_t *log = NULL;
+  pthread_t *cids = NULL;
+  pthread_t *tids = NULL;
+  client_arg_t *cas = NULL;
+  trader_arg_t *tas = NULL;
+  rng_t rng;
+  rng_seed(&rng, time(NULL));
+  conf.ws.num_spins = 0; /* block */
+  conf.ws.num_yields = 0;
+  conf.lane_burst = C_DEF_LANE_BURST;
+  conf.lane_age_ns = 0;
+  conf.admit.policy = ADMIT_BLOCK;
+  memset(&snap, 0, sizeof(snapshot_t)); /* period_ns 0 if no snapshots */
+  memset(&pipeline, 0, sizeof(pipeline_t)); /* no threads if no pipeline */
+  w = malloc_perror(1, sizeof(workload_t));
+  workload_defaults(w);
+  while ((c = getopt(argc, argv, ARGS)) != -1){
+    switch (c){
+    case 'b':
+      b = backend_find(optarg);
+      if (b == NULL){
+	fprintf(stderr,"unknown backend %s\n", optarg);
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'c':
+      num_client_threads = atoi(optarg);
+      if (num_client_threads < 1){
+	fprintf(stderr,"number of client threads must be > 0\n");
+	exit(EXIT_FAILURE);
+      }
+      clients_set = TRUE;
+      break;
+    case 't':
+      num_trader_threads = atoi(optarg);
+      if (num_trader_threads < 1){
+	fprintf(stderr,"number of trader threads must be > 0\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'o':
+      orders_per_client = atoi(optarg);
+      if (orders_per_client < 0){
+	fprintf(stderr,"orders per client must be non-negative\n");
+	exit(EXIT_FAILURE);
+      }
+      orders_set = TRUE;
+      break;
+    case 'q':
+      queue_count = atoi(optarg);
+      if (queue_count < 1 || queue_count > INT_MAX - 1){
+	fprintf(stderr,"invalid queue count\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 's':
+      num_stocks = atoi(optarg);
+      if (num_stocks < 1){
+	fprintf(stderr,"number of stocks must be > 0\n");
+	exit(EXIT_FAILURE);
+      }
+      stocks_set = TRUE;
+      break;
+    case 'd':
+      if (workload_parse_stock(w, optarg) != 0){
+	fprintf(stderr,"stock distribution must be uniform, zipf:s with "
+		"s > 0, or hot:prob:frac with prob in [0, 1] and "
+		"frac in (0, 1]\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'p':
+      w->prob_buy = atof(optarg);
+      if (w->prob_buy < 0.0 || w->prob_buy > 1.0){
+	fprintf(stderr,"buy probability must be in [0, 1]\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'Q':
+      if (workload_parse_quantity(w, optarg) != 0){
+	fprintf(stderr,"quantity distribution must be uniform or "
+		"pareto:alpha with alpha > 0\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'S':
+      if (atol(optarg) < 0){
+	fprintf(stderr,"service time must be non-negative\n");
+	exit(EXIT_FAILURE);
+      }
+      w->service_ns = atol(optarg);
+      break;
+    case 'L':
+      num_market_locks = atoi(optarg);
+      if (num_market_locks < 1){
+	fprintf(stderr,"number of market lock stripes must be > 0\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'r':
+      rates_arg = optarg;
+      break;
+    case 'w':
+      weights_arg = optarg;
+      break;
+    case 'a':
+      if (strcmp(optarg, "const") == 0){
+	arrival = ARRIVAL_CONST;
+      }else if (strcmp(optarg, "poisson") == 0){
+	arrival = ARRIVAL_POISSON;
+      }else{
+	fprintf(stderr,"arrival process must be const or poisson\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'U':
+      w->prob_urgent = atof(optarg);
+      if (w->prob_urgent < 0.0 || w->prob_urgent > 1.0){
+	fprintf(stderr,"urgent probability must be in [0, 1]\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'P':
+      if (lane_parse(&conf, optarg) != 0){
+	fprintf(stderr,"lane scheduling must be burst[:age-ns] with "
+		"burst > 0 and age-ns >= 0\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'B':
+      batch_count = atoi(optarg);
+      if (batch_count < 1){
+	fprintf(stderr,"batch count must be > 0\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'W':
+      if (wait_parse(&conf.ws, optarg) != 0){
+	fprintf(stderr,
+		"wait strategy must be block or spin:spins[:yields]\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'A':
+      if (admit_parse(&conf.admit, optarg) != 0){
+	fprintf(stderr,"admission policy must be block, fail, timed:ns, or "
+		"codel:target-ns:interval-ns with interval-ns > 0\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'X':
+      if (tif_parse(&tif_ns, &wheel_tick_ns, optarg) != 0){
+	fprintf(stderr,"time in force must be ns[:tick-ns] with ns > 0 and "
+		"tick-ns > 0\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'E':
+      if (pool_parse(&num_pool_min, &pool_period_ns, optarg) != 0){
+	fprintf(stderr,"elastic trader pool must be min-traders[:period-ns] "
+		"with min-traders > 0 and period-ns > 0\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'G':
+      if (pipeline_parse(&pipeline, optarg) != 0){
+	fprintf(stderr,"pipeline must be validate:risk:execute:settle "
+		"thread counts > 0\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'M':
+      if (bus_parse(&bus_count, &audit_ns, optarg) != 0){
+	fprintf(stderr,"fill bus must be ring-count[:audit-ns] with "
+		"ring-count > 0 and audit-ns >= 0\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'J':
+      journal_path = malloc_perror(C_PATH_SIZE, sizeof(char));
+      if (journal_parse(journal_path, C_PATH_SIZE, &journal_level,
+			&journal_batch, optarg) != 0){
+	fprintf(stderr,"journal must be path[:write|async|sync[:max-batch]] "
+		"with max-batch > 0\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'Y':
+      if (snapshot_parse(&snap, optarg) != 0){
+	fprintf(stderr,"snapshots must be period-ns[:cow|stw] with "
+		"period-ns > 0\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'm':
+      market_path = optarg;
+      break;
+    case 'T':
+      trace_path = optarg;
+      break;
+    case 'I':
+      ingress_path = malloc_perror(C_PATH_SIZE, sizeof(char));
+      if (ingress_parse(ingress_path, C_PATH_SIZE, &ingress_conns,
+			&ingress_window, optarg) != 0){
+	fprintf(stderr,"ingress must be socket-path[:connections[:window]] "
+		"with connections > 0 and window > 0\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'F':
+      if (strcmp(optarg, "csv") == 0){
+	csv = TRUE;
+      }else if (strcmp(optarg, "text") == 0){
+	csv = FALSE;
+      }else{
+	fprintf(stderr,"output format must be text or csv\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'V':
+      verbose = TRUE;
+      break;
+    default:
+      fprintf(stderr, "unrecognized command %c\n", (char)c);
+      fprintf(stderr,"usage: %s%s\n", C_USAGE, C_USAGE_SCHED);
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (trace_path != NULL){
+    trace_map_perror(&trace, trace_path);
+    if (!clients_set) num_client_threads = trace.hdr->num_clients;
+    if (!orders_set) orders_per_client = trace.hdr->orders_per_client;
+    if (!stocks_set) num_stocks = trace.hdr->num_stocks;
+    if ((uint32_t)num_client_threads > trace.hdr->num_clients ||
+	(uint32_t)orders_per_client > trace.hdr->orders_per_client ||
+	(uint32_t)num_stocks < trace.hdr->num_stocks ||
+	(uint32_t)quantity < trace.hdr->quantity){
+      fprintf(stderr,"trace %s has %u clients with %u orders each on %u "
+	      "stocks\n",
+	      trace_path,
+	      (unsigned)trace.hdr->num_clients,
+	      (unsigned)trace.hdr->orders_per_client,
+	      (unsigned)trace.hdr->num_stocks);
+      exit(EXIT_FAILURE);
+    }
+  }
+  /* the ingress has the client id after the client threads */
+  num_clients = num_client_threads + ((ingress_path != NULL) ? 1 : 0);
+  rates = malloc_perror(num_client_threads, sizeof(double));
+  weights = malloc_perror(num_clients, sizeof(double));
+  if (list_parse(rates, num_client_threads, rates_arg) != 0){
+    fprintf(stderr,"invalid list of orders per sec per client\n");
+    exit(EXIT_FAILURE);
+  }
+  if (list_parse(weights, num_clients, weights_arg) != 0){
+    fprintf(stderr,"invalid list of client weights\n");
+    exit(EXIT_FAILURE);
+  }
+  for (i = 0; i < num_client_threads; i++){
+    if (rates[i] < 0.0){
+      fprintf(stderr,"orders per sec per client must be >= 0\n");
+      exit(EXIT_FAILURE);
+    }
+    total_rate += rates[i];
+  }
+  for (i = 0; i < num_clients; i++){
+    if (weights[i] <= 0.0){
+      fprintf(stderr,"client weights must be > 0\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (batch_count > 1 && total_rate > 0.0){
+    fprintf(stderr,"batch submission requires closed-loop clients\n");
+    exit(EXIT_FAILURE);
+  }
+  if (pipeline.num_threads > 0){
+    if (num_pool_min > 0){
+      fprintf(stderr,"the pipeline requires a fixed number of threads\n");
+      exit(EXIT_FAILURE);
+    }
+    /* stage threads replace the traders */
+    num_queues = NUM_STAGES;
+    num_trader_threads = pipeline.num_threads;
+  }
+  if (num_queues > 1 && journal_path != NULL &&
+      journal_level == JOURNAL_SYNC){
+    fprintf(stderr,"the pipeline requires the write or async journal\n");
+    exit(EXIT_FAILURE);
+  }
+  if (num_pool_min > num_trader_threads){
+    fprintf(stderr,"min traders must be <= traders\n");
+    exit(EXIT_FAILURE);
+  }
+  if (batch_count > 1 && conf.admit.policy != ADMIT_BLOCK){
+    fprintf(stderr,"batch submission requires the block admission\n");
+    exit(EXIT_FAILURE);
+  }
+  if (!b->admit && conf.admit.policy != ADMIT_BLOCK){
+    fprintf(stderr,"the %s backend requires the block admission\n",
+	    b->name);
+    exit(EXIT_FAILURE);
+  }
+  if (batch_count > 1 && tif_ns > 0){
+    fprintf(stderr,"batch submission has no time in force\n");
+    exit(EXIT_FAILURE);
+  }
+  conf.count = queue_count;
+  conf.num_clients = num_clients;
+  conf.weights = weights;
+  m = malloc_perror(1, sizeof(market_t));
+  cids = malloc_perror(num_client_threads, sizeof(pthread_t));
+  tids = malloc_perror(num_trader_threads, sizeof(pthread_t));
+  cas = malloc_perror(num_client_threads, sizeof(client_arg_t));
+  num_tas = num_trader_threads + 1;
+  tas = malloc_perror(num_tas, sizeof(trader_arg_t));
+  q = b->queue_new(&conf);
+  market_sec = time_mono_sec_perror();
+  market_warm = market_init(m, num_stocks, quantity, num_market_locks,
+			    market_path);
+  market_sec = time_mono_sec_perror() - market_sec;
+  workload_init(w, num_stocks, quantity);
+  if (verbose){
+    /* records are formatted and written by the flusher thread of the log */
+    log = malloc_perror(1, sizeof(log_t));
+    log_init_perror(log,
+		    num_client_threads + num_trader_threads,
+		    C_LOG_RING_COUNT,
+		    stdout);
+  }
+  if (ingress_path != NULL){
+    /* listen before the start, so that processes may connect early */
+    ingress_init_perror(&ingress, ingress_path, ingress_conns,
+			ingress_window, num_client_threads, num_stocks,
+			quantity, b, q);
+  }
+  if (tif_ns > 0){
+    wheel_init_perror(&wheel, wheel_tick_ns, order_expire, (void *)b);
+  }
+  start = time_mono_sec_perror();
+  /* spawn threads */
+  if (bus_count > 0){
+    /* consumers before traders, so that no publish waits for a spawn */
+    fill_bus_init(&bus, bus_count, NUM_CONSUMERS);
+    for (k = 0; k < NUM_CONSUMERS; k++){
+      memset(&bus_cas[k], 0, sizeof(consumer_arg_t));
+      bus_cas[k].id = k;
+      bus_cas[k].bus = &bus;
+      bus_cas[k].audit_ns = (k == CONSUMER_AUDIT) ? audit_ns : 0;
+      bus_cas[k].positions = (k == CONSUMER_RISK) ?
+	calloc_perror(num_clients, sizeof(long)) : NULL;
+      bus_cas[k].volumes = (k == CONSUMER_MARKET) ?
+	calloc_perror(num_stocks, sizeof(long)) : NULL;
+      hist_init(&bus_cas[k].lag_hist);
+      thread_create_perror(&bus_cids[k], consumer_thread, &bus_cas[k]);
+    }
+  }
+  for (i = 0; i < num_client_threads; i++){
+    cas[i].id = i;
+    cas[i].order_count = orders_per_client;
+    /* bounds the orders of a client in the queues and at the traders */
+    cas[i].pool_count = num_queues * queue_count + num_trader_threads + 1;
+    cas[i].rate = rates[i];
+    cas[i].arrival = arrival;
+    cas[i].batch_count = batch_count;
+    cas[i].num_rejected = 0;
+    cas[i].tif_ns = tif_ns;
+    cas[i].wheel = (tif_ns > 0) ? &wheel : NULL;
+    cas[i].num_expired = 0;
+    cas[i].w = w;
+    cas[i].trace = (trace_path != NULL) ? trace_slice(&trace, i) : NULL;
+    cas[i].b = b;
+    cas[i].q = q;
+    cas[i].verbose = verbose;
+    cas[i].log = log;
+    cas[i].rng = rng;
+    rng_jump(&rng);
+    thread_create_perror(&cids[i], client_thread, &cas[i]);
+  }
+  num_spawned = num_trader_threads;
+  if (num_pool_min > 0){
+    num_spawned = num_pool_min;
+    pool_init(&pool, num_pool_min, num_trader_threads, pool_period_ns);
+  }
+  if (journal_path != NULL){
+    /* tas[num_trader_threads] is of the flusher at the sync level */
+    journal_open_perror(&journal, journal_path, journal_level,
+			journal_batch, num_stocks,
+			(journal_level == JOURNAL_SYNC) ? journal_durable : NULL,
+			&tas[num_trader_threads]);
+  }
+  for (i = 0; i < num_tas; i++){
+    tas[i].id = i;
+    tas[i].log_id = num_client_threads + i;
+    tas[i].b = b;
+    tas[i].q = q;
+    tas[i].m = m;
+    tas[i].w = w;
+    tas[i].verbose = verbose;
+    tas[i].log = log;
+    tas[i].hists = malloc_perror(num_clients, sizeof(hist_t));
+    for (j = 0; j < num_clients; j++){
+      hist_init(&tas[i].hists[j]);
+    }
+    for (j = 0; j < NUM_LANES; j++){
+      hist_init(&tas[i].lane_hists[j]);
+    }
+    tas[i].pool = (num_pool_min > 0) ? &pool : NULL;
+    tas[i].journal = (journal_path != NULL) ? &journal : NULL;
+    tas[i].bus = (bus_count > 0) ? &bus : NULL;
+    tas[i].num_bus_stalls = 0;
+    tas[i].ingress = (ingress_path != NULL) ? &ingress : NULL;
+    tas[i].num_expired = 0;
+    tas[i].num_cows = 0;
+    tas[i].cow_ns = 0;
+    tas[i].max_cow_ns = 0;
+  }
+  if (num_queues > 1){
+    pipeline_init(&pipeline, b, &conf, q, num_clients, quantity, tas);
+  }
+  for (i = 0; i < num_spawned; i++){
+    if (num_queues > 1){
+      thread_create_perror(&tids[i], stage_thread, &pipeline.sas[i]);
+    }else{
+      thread_create_perror(&tids[i], trader_thread, &tas[i]);
+    }
+  }
+  if (snap.period_ns > 0){
+    snapshot_start(&snap, m);
+  }
+  if (num_pool_min > 0){
+    /* spawns traders beyond num_pool_min on demand */
+    pool_start(&pool, b, q, queue_count, trader_thread,
+	       tas, sizeof(trader_arg_t), tids);
+  }
+  if (ingress_path != NULL){
+    thread_create_perror(&ingress_tid, ingress_thread, &ingress);
+  }
+  /* join client threads after each client's orders are fulfilled */
+  for (i = 0; i < num_client_threads; i++){
+    thread_join_perror(cids[i], NULL);
+  }
+  if (ingress_path != NULL){
+    /* returns after the orders of all connections were fulfilled */
+    thread_join_perror(ingress_tid, NULL);
+  }
+  /* all orders were fulfilled; unblock the traders */
+  if (num_pool_min > 0){
+    pool_done(&pool); /* no spawns afterwards */
+    num_spawned = pool.num_spawned;
+  }
+  if (num_queues > 1){
+    pipeline_done(&pipeline);
+  }else{
+    b->queue_done(q);
+  }
+  for (i = 0; i < num_spawned; i++){
+    thread_join_perror(tids[i], NULL);
+  }
+  if (journal_path != NULL){
+    journal_close_perror(&journal); /* commit the remaining records */
+  }
+  end = time_mono_sec_perror();
+  if (tif_ns > 0){
+    /* the timers of all orders expired or were cancelled */
+    wheel_free_perror(&wheel);
+  }
+  if (snap.period_ns > 0){
+    snapshot_stop(&snap);
+  }
+  if (bus_count > 0){
+    /* all fills were published; the consumers read the remaining fills */
+    fill_bus_done(&bus);
+    for (k = 0; k < NUM_CONSUMERS; k++){
+      thread_join_perror(bus_cids[k], NULL);
+    }
+  }
+  for (i = 0; i < num_client_threads; i++){
+    num_rejected += cas[i].num_rejected;
+    num_expired += cas[i].num_expired;
+  }
+  num_fulfilled = (unsigned long)orders_per_client * num_client_threads -
+    num_rejected - num_expired;
+  if (ingress_path != NULL){
+    num_fulfilled += ingress.num_completions - ingress.num_stage_rejected;
+    num_rejected += ingress.num_rejected + ingress.num_stage_rejected;
+  }
+  hist_init(&hist);
+  client_hists = malloc_perror(num_clients, sizeof(hist_t));
+  for (j = 0; j < num_clients; j++){
+    hist_init(&client_hists[j]);
+    for (i = 0; i < num_tas; i++){
+      hist_merge(&client_hists[j], &tas[i].hists[j]);
+    }
+    hist_merge(&hist, &client_hists[j]);
+  }
+  for (j = 0; j < NUM_LANES; j++){
+    hist_init(&lane_hists[j]);
+    for (i = 0; i < num_tas; i++){
+      hist_merge(&lane_hists[j], &tas[i].lane_hists[j]);
+    }
+  }
+  for (i = 0; i < num_tas; i++){
+    num_bus_stalls += tas[i].num_bus_stalls;
+    num_dropped_expired += tas[i].num_expired;
+    num_cows += tas[i].num_cows;
+    cow_ns += tas[i].cow_ns;
+    if (tas[i].max_cow_ns > max_cow_ns) max_cow_ns = tas[i].max_cow_ns;
+    for (j = 0; j < num_clients; j++){
+      hist_free(&tas[i].hists[j]);
+    }
+    for (j = 0; j < NUM_LANES; j++){
+      hist_free(&tas[i].lane_hists[j]);
+    }
+    free(tas[i].hists);
+    tas[i].hists = NULL;
+  }
+  if (verbose){
+    num_dropped = log_num_dropped(log); /* exact after joining */
+    log_free_perror(log); /* write remaining records */
+    if (num_dropped > 0) printf("%lu log records dropped\n", num_dropped);
+    workload_print(w);
+    market_print(m);
+    for (j = 0; j < num_client_threads; j++){
+      printf("client %d: rate %g, weight %g, rejected %lu, latency (ns): "
+	     "p50 %lu, p99 %lu, max %lu\n",
+	     j, rates[j], weights[j], cas[j].num_rejected,
+	     (unsigned long)hist_quantile(&client_hists[j], 0.5),
+	     (unsigned long)hist_quantile(&client_hists[j], 0.99),
+	     (unsigned long)client_hists[j].max);
+    }
+    if (ingress_path != NULL){
+      printf("client %d: ingress, weight %g, rejected %lu, latency (ns): "
+	     "p50 %lu, p99 %lu, max %lu\n",
+	     num_client_threads, weights[num_client_threads],
+	     ingress.num_rejected + ingress.num_stage_rejected,
+	     (unsigned long)hist_quantile(&client_hists[num_client_threads],
+					  0.5),
+	     (unsigned long)hist_quantile(&client_hists[num_client_threads],
+					  0.99),
+	     (unsigned long)client_hists[num_client_threads].max);
+    }
+  }
+  if (csv){
+    printf("%s,%d,%d,%d,%d,%d,%f,%f,%f,%lu,%lu,%lu,%lu,%lu\n",
+	   b->name,
+	   num_client_threads,
+	   num_trader_threads,
+	   queue_count,
+	   num_stocks,
+	   orders_per_client,
+	   end - start,
+	   num_fulfilled / (end - start),
+	   total_rate,
+	   (unsigned long)hist_quantile(&hist, 0.5),
+	   (unsigned long)hist_quantile(&hist, 0.99),
+	   (unsigned long)hist_quantile(&hist, 0.999),
+	   (unsigned long)hist.max,
+	   num_rejected);
+  }else{
+    printf("%s: %f transactions / sec\n",
+	   b->name,
+	   num_fulfilled / (end - start));
+    if (total_rate > 0.0){
+      printf("offered: %f orders / sec (%s)\n",
+	     total_rate,
+	     (arrival == ARRIVAL_POISSON) ? "poisson" : "const");
+    }
+    if (conf.admit.policy != ADMIT_BLOCK || num_queues > 1){
+      printf("rejected: %lu orders (%.2f%%)\n",
+	     num_rejected,
+	     (num_rejected + num_fulfilled > 0) ?
+	     100.0 * num_rejected / (num_rejected + num_fulfilled) : 0.0);
+    }
+    if (tif_ns > 0){
+      printf("expired: %lu orders (%.2f%%), %lu dropped before trading\n",
+	     num_expired,
+	     (num_expired + num_fulfilled > 0) ?
+	     100.0 * num_expired / (num_expired + num_fulfilled) : 0.0,
+	     num_dropped_expired);
+      printf("wheel: tick %lu ns, %lu timers, %lu cancelled, %lu expired, "
+	     "%lu cascaded, %lu ticks\n",
+	     (unsigned long)wheel.tick_ns,
+	     wheel.num_adds,
+	     wheel.num_cancels,
+	     wheel.num_expiries,
+	     wheel.num_cascades,
+	     wheel.num_ticks);
+    }
+    latency_print("latency", &hist);
+    if (w->prob_urgent > 0.0){
+      latency_print("latency urgent", &lane_hists[LANE_URGENT]);
+      latency_print("latency normal", &lane_hists[LANE_NORMAL]);
+    }
+    if (num_queues > 1){
+      pipeline_print(&pipeline, end - start);
+    }
+    if (num_pool_min > 0){
+      pool_print(&pool);
+    }
+    if (journal_path != NULL){
+      printf("journal: %s, %lu records, %lu commits, %f commits / sec, "
+	     "%f fsyncs / sec\n",
+	     journal_level_name(journal_level),
+	     journal.num_recs,
+	     journal.num_commits,
+	     journal.num_commits / (end - start),
+	     journal.num_fsyncs / (end - start));
+      printf("journal: commit batch mean %.2f max %d (max-batch %d), "
+	     "%lu appends blocked on a full buffer, commit (ns): p50 %lu, "
+	     "p99 %lu, max %lu\n",
+	     (journal.num_commits > 0) ?
+	     (double)journal.num_recs / journal.num_commits : 0.0,
+	     journal.max_commit,
+	     journal.max_batch,
+	     journal.num_blocked,
+	     (unsigned long)hist_quantile(&journal.commit_hist, 0.5),
+	     (unsigned long)hist_quantile(&journal.commit_hist, 0.99),
+	     (unsigned long)journal.commit_hist.max);
+    }
+    if (trace_path != NULL){
+      printf("trace: %s, seed %lu\n",
+	     trace_path, (unsigned long)trace.hdr->seed);
+    }
+    if (ingress_path != NULL){
+      printf("ingress: %s, %d connections, window %d, %lu orders, "
+	     "%lu rejected, %lu invalid, %d protocol errors, "
+	     "%lu stalls at a full queue\n",
+	     ingress_path,
+	     ingress.num_accepted,
+	     ingress.window,
+	     ingress.num_orders,
+	     ingress.num_rejected,
+	     ingress.num_invalid,
+	     ingress.num_protocol_errors,
+	     ingress.num_stalls);
+      printf("ingress: read batch mean %.2f max %d orders, %lu completions "
+	     "in %lu wakeups, %lu eventfd writes\n",
+	     (ingress.num_reads > 0) ?
+	     (double)ingress.num_orders / ingress.num_reads : 0.0,
+	     ingress.max_read_batch,
+	     ingress.num_completions,
+	     ingress.num_wakeups,
+	     ingress.num_signals);
+    }
+    if (market_path != NULL){
+      printf("market: %s %s, %d stocks, initialized in %f ms\n",
+	     market_warm ? "mapped" : "created",
+	     market_path,
+	     num_stocks,
+	     market_sec * 1000.0);
+    }
+    if (snap.period_ns > 0){
+      snapshot_print(&snap, num_cows, cow_ns, max_cow_ns);
+    }
+    if (bus_count > 0){
+      printf("fills: %lu published on a ring of %lu, %lu publishes "
+	     "blocked on the slowest consumer\n",
+	     (unsigned long)bus.claim,
+	     (unsigned long)bus.mask + 1,
+	     num_bus_stalls);
+      for (k = 0; k < NUM_CONSUMERS; k++){
+	printf("consumer %s: %lu fills, batch mean %.2f max %d, "
+	       "lag (ns): p50 %lu, p99 %lu, max %lu\n",
+	       C_CONSUMER_NAMES[k],
+	       bus_cas[k].num_fills,
+	       (bus_cas[k].num_batches > 0) ?
+	       (double)bus_cas[k].num_fills / bus_cas[k].num_batches : 0.0,
+	       bus_cas[k].max_batch,
+	       (unsigned long)hist_quantile(&bus_cas[k].lag_hist, 0.5),
+	       (unsigned long)hist_quantile(&bus_cas[k].lag_hist, 0.99),
+	       (unsigned long)bus_cas[k].lag_hist.max);
+      }
+      printf("consumer audit: %lu gaps\n", bus_cas[CONSUMER_AUDIT].num_gaps);
+      if (verbose){
+	for (j = 0; j < num_clients; j++){
+	  printf("consumer risk: client %d, net position %ld\n",
+		 j, bus_cas[CONSUMER_RISK].positions[j]);
+	}
+	for (j = 0; j < num_stocks; j++){
+	  printf("consumer market-data: stock %d, volume %ld\n",
+		 j, bus_cas[CONSUMER_MARKET].volumes[j]);
+	}
+      }
+    }
+    b->queue_print(q);
+  }
+  if (bus_count > 0){
+    for (k = 0; k < NUM_CONSUMERS; k++){
+      hist_free(&bus_cas[k].lag_hist);
+      free(bus_cas[k].positions);
+      free(bus_cas[k].volumes);
+      bus_cas[k].positions = NULL;
+      bus_cas[k].volumes = NULL;
+    }
+    fill_bus_free(&bus);
+  }
+  if (journal_path != NULL){
+    journal_free(&journal);
+  }
+  if (trace_path != NULL){
+    trace_unmap_perror(&trace);
+  }
+  if (ingress_path != NULL){
+    ingress_free_perror(&ingress);
+  }
+  for (j = 0; j < num_clients; j++){
+    hist_free(&client_hists[j]);
+  }
+  for (j = 0; j < NUM_LANES; j++){
+    hist_free(&lane_hists[j]);
+  }
+  hist_free(&hist);
+  b->queue_free(q);
+  if (num_queues > 1){
+    pipeline_free(&pipeline);
+  }
+  if (num_pool_min > 0){
+    pool_free(&pool);
+  }
+  market_free(m);
+  workload_free(w);
+  free(m);
+  free(w);
+  free(log);
+  free(cids);
+  free(tids);
+  free(cas);
+  free(tas);
+  free(rates);
+  free(weights);
+  free(client_hists);
+  free(journal_path);
+  free(ingress_path);
+  q = NULL;
+  m = NULL;
+  w = NULL;
+  log = NULL;
+  cids = NULL;
+  tids = NULL;
+  cas = NULL;
+  tas = NULL;
+  rates = NULL;
+  weights = NULL;
+  client_hists = NULL;
+  journal_path = NULL;
+  ingress_path = NULL;
+  return 0;
+}
@@ -0,0 +1,291 @@
+/**
+   bound-buf.h
+
+   Declarations of the order type and of the interface of synchronization
+   backends for the bound-buf benchmark.
+
+   A backend implements 1) a bounded fifo queue of order pointers between
+   client (producer) and trader (consumer) threads, and 2) a one-to-one
+   completion that a trader signals to the client of a fulfilled order. The
+   order production, market updates, timers, and reporting are implemented
+   once in bound-buf.c and are shared by all backends, so that backends
+   differ only in how they synchronize.
+*/
+
+#ifndef BOUND_BUF_H
+#define BOUND_BUF_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "utilities-pthread.h"
+
+typedef enum{FALSE, TRUE} boolean_t;
+typedef enum{BUY, SELL} action_t;
+typedef enum{LANE_URGENT, LANE_NORMAL, NUM_LANES} lane_t;
+
+/**
+   Completion state of an order. Initialized and accessed only by a
+   backend. The 4-byte states of the polling and latch backends are in
+   sync. The larger states of the condvar2 and sema backends follow the
+   order in an order of order_size bytes of the backend, as in
+   bound-buf-condvar2.c and bound-buf-sema.c, so that a wait or
+   fulfillment does not chase a pointer and the orders of the other
+   backends are not enlarged.
+*/
+typedef union{
+  boolean_t fulfilled; /* polling backends; accessed atomically */
+  latch_t latch; /* the result of referring to a copy is undefined */
+} order_sync_t;
+
+/**
+   State of an order with a deadline (time in force), accessed atomically.
+   A queued order is either claimed by a trader, or expired by the timer
+   of its deadline, which informs the client while the order is still
+   referred to by the queue. The client and the trader that dequeues an
+   expired order each exchange expired for released, and the second of
+   them owns the order. A trader that claims an order after its deadline,
+   before the timer expired it, releases it and informs the client.
+*/
+typedef enum{ORDER_QUEUED,
+	     ORDER_CLAIMED,
+	     ORDER_EXPIRED,
+	     ORDER_RELEASED} order_state_t;
+
+struct order_batch;
+
+typedef struct{
+  int stock_id;
+  int quantity;
+  action_t action;
+  lane_t lane; /* priority class, e.g. cancels are urgent */
+  int client_id;
+  uint64_t start_ns; /* send time, or intended send time in open loop */
+  uint64_t stage_ns; /* queuing time at the current pipeline stage */
+  uint64_t deadline_ns; /* time in force; 0 if none */
+  struct order_batch *batch; /* NULL if not submitted in a batch */
+  int state; /* order_state_t; only if deadline_ns > 0 */
+  boolean_t rejected; /* by a pipeline stage; read after the completion */
+  wheel_timer_t expiry; /* only if deadline_ns > 0 */
+  order_sync_t sync;
+} order_t;
+
+/**
+   A batch of orders that is submitted with queue_enqueue_batch. The orders
+   of a batch are fulfilled by decrementing num_pending, and the trader
+   that decrements num_pending to 0 fulfills done, so that a client waits
+   once per batch.
+*/
+typedef struct order_batch{
+  int num_pending; /* accessed atomically */
+  order_t *done; /* of order_size; only the completion state is used */
+} order_batch_t;
+
+/**
+   A compact fixed-size copy of an order that is dequeued by a trader.
+   order is the completion handle of the order of a client, and is
+   referred to by a trader only for fulfilling the order.
+*/
+typedef struct{
+  int stock_id;
+  int quantity;
+  action_t action;
+  lane_t lane;
+  int client_id;
+  uint64_t start_ns;
+  uint64_t stage_ns;
+  uint64_t deadline_ns;
+  order_t *order;
+  order_batch_t *batch;
+} order_rec_t;
+
+/**
+   Wait strategy of a trader on an empty queue: poll the queue with a pause
+   for up to num_spins iterations, then poll with a yield of the processor
+   for up to num_yields times, and then block. Applies to the condition
+   variable queue; other queues ignore it.
+*/
+typedef struct{
+  int num_spins;
+  int num_yields;
+} wait_strategy_t;
+
+/**
+   Admission policy of a queue for an order that arrives at a full or
+   overloaded queue: block until the order fits (ADMIT_BLOCK), reject the
+   order if the queue is full (ADMIT_FAIL), reject the order if the queue
+   is still full after timeout_ns (ADMIT_TIMED), or block while full and
+   reject orders after the queuing delay of dequeued orders has exceeded
+   target_ns for interval_ns, until it is below target_ns (ADMIT_CODEL).
+   An order with a deadline is also rejected if the queue is still full at
+   its deadline. Applies to the condition variable queue; other queues
+   block.
+*/
+typedef enum{ADMIT_BLOCK, ADMIT_FAIL, ADMIT_TIMED, ADMIT_CODEL} admit_policy_t;
+
+typedef struct{
+  admit_policy_t policy;
+  uint64_t timeout_ns;
+  uint64_t target_ns;
+  uint64_t interval_ns;
+} admit_t;
+
+/**
+   Result of a nonblocking enqueue: the order was queued, the queue is
+   full and the order may be retried, or the order was rejected by the
+   admission policy of the queue.
+*/
+typedef enum{ENQUEUE_QUEUED, ENQUEUE_FULL, ENQUEUE_REJECTED} enqueue_t;
+
+/**
+   Queue configuration. weights are the relative shares of the clients in
+   a queue that schedules across clients, and lane_burst and lane_age_ns
+   bound the delay of normal orders behind urgent orders in a queue that
+   schedules across lanes. Both are ignored by fifo queues.
+*/
+typedef struct{
+  int count; /* orders */
+  int num_clients; /* client ids are in [0, num_clients) */
+  const double *weights; /* num_clients weights > 0.0 */
+  int lane_burst; /* urgent orders in a row before a waiting normal order */
+  uint64_t lane_age_ns; /* bound on overtaking a normal order; 0 if none */
+  wait_strategy_t ws;
+  admit_t admit;
+} queue_conf_t;
+
+/**
+   Backend interface. A queue is created with queue_new and disposed with
+   queue_free after all threads are joined.
+   -  order_size is the size of an order with the completion state of the
+      backend, for allocating an order with order_alloc,
+   -  admit is TRUE if queue_new applies the admission policy of the
+      configuration, and FALSE if the queue always blocks while full,
+   -  queue_enqueue blocks while the queue is full, or returns FALSE if
+      the order was rejected by the admission policy of the queue, and
+      TRUE otherwise,
+   -  queue_try_enqueue does not block, and returns ENQUEUE_FULL instead
+      of waiting where queue_enqueue would wait; a timed admission is
+      timed out from the send time of the order,
+   -  queue_enqueue_batch queues n orders with one lock acquisition or
+      reservation for as many orders as fit, and blocks while the queue
+      is full,
+   -  queue_dequeue blocks while the queue is empty, copies the next order
+      into a record and returns TRUE, or returns FALSE if the queue is
+      empty and queue_done was called,
+   -  queue_done is called once after all orders were fulfilled, and
+      unblocks the traders,
+   -  queue_length returns the number of queued orders, read without
+      locking and therefore approximate under concurrent (de)queuing,
+   -  queue_print prints the statistics of the queue, if any, after all
+      threads are joined.
+   The completion state of an order is initialized with order_init once
+   and may be reused for a next order after order_wait returns.
+   -  order_wait blocks until order_fulfill is called on the order.
+*/
+typedef struct{
+  const char *name;
+  size_t order_size;
+  boolean_t admit;
+  void *(*queue_new)(const queue_conf_t *conf);
+  boolean_t (*queue_enqueue)(void *q, order_t *order);
+  enqueue_t (*queue_try_enqueue)(void *q, order_t *order);
+  void (*queue_enqueue_batch)(void *q, order_t *orders, int n);
+  boolean_t (*queue_dequeue)(void *q, order_rec_t *rec);
+  void (*queue_done)(void *q);
+  int (*queue_length)(void *q);
+  void (*queue_free)(void *q);
+  void (*queue_print)(void *q);
+  void (*order_init)(order_t *order);
+  void (*order_wait)(order_t *order);
+  void (*order_fulfill)(order_t *order);
+  void (*order_free)(order_t *order);
+} backend_t;
+
+/**
+   Backends adopted from bound-buf-mutex.c, bound-buf-condvar1.c,
+   bound-buf-condvar2.c, and bound-buf-sema.c, and backends with the
+   condition variable queue of order pointers or of inline order records,
+   and a latch completion.
+*/
+
+extern const backend_t C_BACKEND_MUTEX;
+
+extern const backend_t C_BACKEND_CONDVAR1;
+
+extern const backend_t C_BACKEND_CONDVAR2;
+
+extern const backend_t C_BACKEND_SEMA;
+
+extern const backend_t C_BACKEND_LATCH;
+
+extern const backend_t C_BACKEND_LATCH_INLINE;
+
+extern const backend_t C_BACKEND_DRR;
+
+extern const backend_t C_BACKEND_PRIO;
+
+/**
+   Allocates an order of order_size bytes of a backend. The completion
+   state is initialized with order_init by the caller.
+*/
+order_t *order_alloc(const backend_t *b);
+
+/**
+   Copies an order into a record, with the order as the completion handle.
+*/
+void order_rec_set(order_rec_t *rec, order_t *order);
+
+/**
+   Polling completion, shared by the mutex and condvar1 backends. Requires
+   no x86 memory ordering because the flag is accessed atomically.
+*/
+
+void order_poll_init(order_t *order);
+
+void order_poll_wait(order_t *order);
+
+void order_poll_fulfill(order_t *order);
+
+void order_poll_free(order_t *order);
+
+/**
+   Latch completion, shared by the latch, latch-inline, drr, and prio
+   backends.
+*/
+
+void order_latch_init(order_t *order);
+
+void order_latch_wait(order_t *order);
+
+void order_latch_fulfill(order_t *order);
+
+void order_latch_free(order_t *order);
+
+/**
+   Condition variable queue, shared by the condvar1, condvar2, and latch
+   backends. A queue created with queue_cond_new_inline copies order
+   records into cache-line-aligned slots, instead of storing order
+   pointers.
+*/
+
+void *queue_cond_new(const queue_conf_t *conf);
+
+void *queue_cond_new_inline(const queue_conf_t *conf);
+
+boolean_t queue_cond_enqueue(void *q, order_t *order);
+
+enqueue_t queue_cond_try_enqueue(void *q, order_t *order);
+
+void queue_cond_enqueue_batch(void *q, order_t *orders, int n);
+
+boolean_t queue_cond_dequeue(void *q, order_rec_t *rec);
+
+void queue_cond_done(void *q);
+
+int queue_cond_length(void *q);
+
+void queue_cond_free(void *q);
+
+void queue_cond_print(void *q);
+
+#endif
@@ -1,6 +0,0 @@
-#ifndef CTIMER_H
-#define CTIMER_H
-
-double ctimer();
-
-#endif
@@ -0,0 +1,137 @@
+/**
+   fill-bus.c
+
+   A multicast ring of fills for the bound-buf benchmark, in the style of
+   the LMAX Disruptor, with concurrent producers and independent
+   consumers.
+
+   A producer claims sequence s with an atomic increment of claim, and
+   may write slot s & mask after every consumer has released sequence
+   s - count, i.e. after the minimum of the consumer sequences exceeds
+   s - count. The minimum is cached in gate, so that a producer reads the
+   consumer sequences only when the ring appears full. A cached minimum
+   may be stale, but is never above the minimum, because the consumer
+   sequences only increase. The minimum is cached with a release store
+   after acquire loads of the consumer sequences, and read with an acquire
+   load, so that the release of a slot by a consumer happens before the
+   write of the slot by a producer that passes the cached gate, also on
+   weakly ordered processors. A fill is published with a release store of
+   s + 1 into the slot, so that producers that claimed adjacent sequences
+   publish in any order without waiting for each other.
+
+   A consumer with sequence s reads the fills of the contiguous slots
+   whose published sequence matches, and releases them with a release
+   store of its sequence, so that a producer that observes the release
+   does not overwrite a slot that is being read. A consumer and a blocked
+   producer poll with a pause, and then with a yield of the processor.
+   The consumer sequences are on separate cache lines.
+*/
+
+#define _XOPEN_SOURCE 600
+
+#include <stdlib.h>
+#include <string.h>
+#include <sched.h>
+#include "fill-bus.h"
+#include "bound-buf.h"
+#include "utilities-mem.h"
+#include "utilities-pthread.h"
+
+static const int C_NUM_SPINS = 100; /* polls with a pause before yields */
+
+/**
+   Pauses for the i-th poll of a wait.
+*/
+static void poll_pause(int i){
+  if (i < C_NUM_SPINS){
+    cpu_pause();
+  }else{
+    sched_yield();
+  }
+}
+
+/**
+   Returns the minimum of the consumer sequences, and caches it in gate.
+*/
+static uint64_t gate_update(fill_bus_t *bus){
+  int i;
+  uint64_t seq;
+  uint64_t min_seq = UINT64_MAX;
+  for (i = 0; i < bus->num_consumers; i++){
+    seq = __atomic_load_n(&bus->cursors[i].seq, __ATOMIC_ACQUIRE);
+    if (seq < min_seq) min_seq = seq;
+  }
+  __atomic_store_n(&bus->gate, min_seq, __ATOMIC_RELEASE);
+  return min_seq;
+}
+
+void fill_bus_init(fill_bus_t *bus, int count, int num_consumers){
+  uint64_t n = 1;
+  while (n < (uint64_t)count) n *= 2;
+  memset(bus, 0, sizeof(fill_bus_t));
+  bus->mask = n - 1;
+  bus->num_consumers = num_consumers;
+  bus->done = 0;
+  bus->slots = calloc_perror(n, sizeof(fill_slot_t)); /* none published */
+  bus->cursors = malloc_align_perror(FILL_BUS_CACHE_LINE,
+				     num_consumers,
+				     sizeof(fill_cursor_t));
+  memset(bus->cursors, 0, num_consumers * sizeof(fill_cursor_t));
+}
+
+boolean_t fill_bus_publish(fill_bus_t *bus, fill_t *fill){
+  int i = 0;
+  uint64_t seq;
+  fill_slot_t *slot = NULL;
+  seq = __atomic_fetch_add(&bus->claim, 1, __ATOMIC_RELAXED);
+  fill->seq = seq;
+  if (seq - __atomic_load_n(&bus->gate, __ATOMIC_ACQUIRE) > bus->mask){
+    /* the ring appears full; wait for the slowest consumer */
+    while (seq - gate_update(bus) > bus->mask){
+      poll_pause(i++);
+    }
+  }
+  slot = &bus->slots[seq & bus->mask];
+  slot->fill = *fill;
+  __atomic_store_n(&slot->published, seq + 1, __ATOMIC_RELEASE);
+  return i > 0;
+}
+
+int fill_bus_wait(fill_bus_t *bus, int id){
+  int i, n;
+  int done;
+  uint64_t seq = bus->cursors[id].seq;
+  for (i = 0; TRUE; i++){
+    /* read before the slots, so that no fill is published after done */
+    done = __atomic_load_n(&bus->done, __ATOMIC_ACQUIRE);
+    n = 0;
+    while ((uint64_t)n <= bus->mask &&
+	   __atomic_load_n(&bus->slots[(seq + n) & bus->mask].published,
+			   __ATOMIC_ACQUIRE) == seq + n + 1){
+      n++;
+    }
+    if (n > 0 || done) return n;
+    poll_pause(i);
+  }
+}
+
+const fill_t *fill_bus_get(const fill_bus_t *bus, int id, int i){
+  return &bus->slots[(bus->cursors[id].seq + i) & bus->mask].fill;
+}
+
+void fill_bus_release(fill_bus_t *bus, int id, int n){
+  __atomic_store_n(&bus->cursors[id].seq,
+		   bus->cursors[id].seq + n,
+		   __ATOMIC_RELEASE);
+}
+
+void fill_bus_done(fill_bus_t *bus){
+  __atomic_store_n(&bus->done, 1, __ATOMIC_RELEASE);
+}
+
+void fill_bus_free(fill_bus_t *bus){
+  free(bus->slots);
+  free(bus->cursors);
+  bus->slots = NULL;
+  bus->cursors = NULL;
+}
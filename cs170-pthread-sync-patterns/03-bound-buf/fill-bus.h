@@ -0,0 +1,100 @@
+/**
+   fill-bus.h
+
+   Declarations of a multicast ring of fills for the bound-buf benchmark,
+   in the style of the LMAX Disruptor. Traders publish a fill for each
+   executed order, and each consumer, e.g. audit, risk, or market data,
+   reads every fill in sequence at its own pace by tracking its own
+   sequence. A slot is reused only after the slowest consumer has read it,
+   so that a trader blocks on a full ring instead of dropping fills.
+
+   A fill is published by claiming the next sequence with an atomic
+   increment, so that traders publish concurrently without a lock, by
+   copying the fill into its slot, and by storing the sequence of the
+   slot last. A consumer waits for the published fills by polling, reads
+   all contiguous published fills as a batch, and releases the batch by
+   storing its sequence once.
+*/
+
+#ifndef FILL_BUS_H
+#define FILL_BUS_H
+
+#include <stdint.h>
+#include "bound-buf.h"
+
+#define FILL_BUS_CACHE_LINE (64) /* used as int */
+
+typedef struct{
+  uint64_t seq; /* sequence of the fill on the bus, from 0 */
+  int stock_id;
+  int quantity;
+  action_t action;
+  int client_id;
+  uint64_t fill_ns; /* time of the fulfillment */
+} fill_t;
+
+typedef struct{
+  uint64_t published; /* sequence + 1 of the last published fill */
+  fill_t fill;
+} fill_slot_t;
+
+typedef struct{
+  uint64_t seq; /* next sequence; written only by the consumer */
+  char pad[FILL_BUS_CACHE_LINE - sizeof(uint64_t)];
+} fill_cursor_t;
+
+typedef struct{
+  uint64_t claim; /* next sequence to claim by a producer */
+  char pad0[FILL_BUS_CACHE_LINE - sizeof(uint64_t)];
+  uint64_t gate; /* cached lower bound of the consumer sequences */
+  char pad1[FILL_BUS_CACHE_LINE - sizeof(uint64_t)];
+  uint64_t mask; /* ring count - 1, ring count is a power of two */
+  int num_consumers;
+  int done; /* accessed atomically */
+  fill_slot_t *slots;
+  fill_cursor_t *cursors; /* consumer id is in [0, num_consumers) */
+} fill_bus_t;
+
+/**
+   Initialize a bus with a ring of at least count fills and num_consumers
+   consumers.
+*/
+void fill_bus_init(fill_bus_t *bus, int count, int num_consumers);
+
+/**
+   Publish a fill and set its sequence. Blocks while the ring is full
+   until the slowest consumer releases a slot. Returns TRUE if the
+   producer blocked, and FALSE otherwise.
+*/
+boolean_t fill_bus_publish(fill_bus_t *bus, fill_t *fill);
+
+/**
+   Return the number of contiguous published fills that consumer id has
+   not read, waiting while there are none, or 0 if there are none and
+   fill_bus_done was called.
+*/
+int fill_bus_wait(fill_bus_t *bus, int id);
+
+/**
+   Return the i-th fill that is available to consumer id, with i in
+   [0, n) after fill_bus_wait returned n.
+*/
+const fill_t *fill_bus_get(const fill_bus_t *bus, int id, int i);
+
+/**
+   Release the next n fills of consumer id to the producers.
+*/
+void fill_bus_release(fill_bus_t *bus, int id, int n);
+
+/**
+   Set a bus done after all producers returned, so that consumers return
+   after reading the remaining fills.
+*/
+void fill_bus_done(fill_bus_t *bus);
+
+/**
+   Free the ring and the consumer sequences. The bus struct is not freed.
+*/
+void fill_bus_free(fill_bus_t *bus);
+
+#endif
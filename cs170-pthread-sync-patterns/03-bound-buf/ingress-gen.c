@@ -0,0 +1,385 @@
+/**
+   ingress-gen.c
+
+   A load generator for the ingress of bound-buf (ingress.h). Each
+   connection is served by a thread that draws orders from the workload
+   (workload.h) with the same options as in bound-buf, and keeps up to
+   -w window orders without a response in flight, so that the orders of a
+   connection are written in batches of the free window, and the ingress
+   reads them in batches.
+
+   The round-trip latency of an order is measured from the write of its
+   batch to the read of its response, and the latency within bound-buf is
+   taken from the response. The connection is retried for a few seconds,
+   so that the generator may be started before bound-buf listens.
+
+   usage examples:
+   ./bound-buf -b latch -c 1 -o 0 -t 2 -q 64 -s 100 -I /tmp/bb.sock:2 &
+   ./ingress-gen -c 2 -o 100000 -w 32 -s 100 /tmp/bb.sock
+   ./bound-buf -b prio -c 1 -o 0 -t 2 -q 64 -s 100 -I /tmp/bb.sock &
+   ./ingress-gen -o 100000 -w 64 -s 100 -U 0.1 /tmp/bb.sock
+*/
+
+#define _XOPEN_SOURCE 600
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "bound-buf.h"
+#include "workload.h"
+#include "ingress.h"
+#include "utilities-mem.h"
+#include "utilities-pthread.h"
+#include "utilities-rand.h"
+#include "utilities-time.h"
+#include "utilities-hist.h"
+
+#define ARGS "c:o:w:s:d:p:Q:U:x:"
+
+const int C_DEF_NUM_CONNS = 1;
+const int C_DEF_ORDERS_PER_CONN = 1;
+const int C_DEF_WINDOW = 64; /* as in the ingress */
+const int C_DEF_NUM_STOCKS = 1;
+const int C_DEF_QUANTITY = 5000; /* as in bound-buf */
+const int C_CONNECT_TRIES = 100;
+const uint64_t C_CONNECT_WAIT_NS = 50000000; /* between tries */
+const size_t C_REQ_FRAME = sizeof(uint32_t) + sizeof(ingress_req_t);
+const size_t C_RESP_FRAME = sizeof(uint32_t) + sizeof(ingress_resp_t);
+
+const char *C_USAGE =
+  "ingress-gen "
+  "-c connections "
+  "-o orders-per-connection "
+  "-w window "
+  "-s number-stocks "
+  "-d uniform|zipf:s|hot:prob:frac "
+  "-p buy-probability "
+  "-Q uniform|pareto:alpha "
+  "-U urgent-probability "
+  "-x seed "
+  "socket-path\n";
+
+typedef struct{
+  int id;
+  int order_count;
+  int window;
+  const char *path;
+  const workload_t *w; /* read-only; shared by connections */
+  rng_t rng; /* non-overlapping stream of each connection */
+  hist_t rtt_hist; /* from the write of an order to its response, ns */
+  hist_t server_hist; /* within bound-buf, ns */
+  unsigned long num_rejected;
+  unsigned long num_invalid;
+} conn_arg_t;
+
+/**
+   Connects to the socket at path, and retries while the socket does not
+   exist or does not accept connections yet.
+*/
+int connect_perror(const char *path){
+  int i;
+  int fd;
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(struct sockaddr_un));
+  if (strlen(path) >= sizeof(addr.sun_path)){
+    fprintf(stderr, "socket path %s is too long\n", path);
+    exit(EXIT_FAILURE);
+  }
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+  for (i = 0; TRUE; i++){
+    fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0){
+      perror("socket failed");
+      exit(EXIT_FAILURE);
+    }
+    if (connect(fd, (struct sockaddr *)&addr,
+		sizeof(struct sockaddr_un)) == 0){
+      return fd;
+    }
+    if ((errno != ENOENT && errno != ECONNREFUSED) ||
+	i + 1 == C_CONNECT_TRIES){
+      perror("connect failed");
+      exit(EXIT_FAILURE);
+    }
+    close(fd);
+    time_wait_until_ns_perror(time_mono_ns_perror() + C_CONNECT_WAIT_NS, 0);
+  }
+}
+
+/**
+   Writes n bytes with error checking, and retries partial writes.
+*/
+void write_all_perror(int fd, const void *buf, size_t n){
+  ssize_t k;
+  const char *p = buf;
+  while (n > 0){
+    k = write(fd, p, n);
+    if (k < 0 && errno == EINTR) continue;
+    if (k < 0){
+      perror("write failed");
+      exit(EXIT_FAILURE);
+    }
+    p += k;
+    n -= k;
+  }
+}
+
+/**
+   Writes the orders of a connection in batches of its free window, and
+   reads the responses. The tag of an order is its slot in the window,
+   because the responses of the orders of a batch may arrive in any order.
+*/
+void *conn_thread(void *arg){
+  int i, n;
+  int fd;
+  int num_sent = 0;
+  int num_done = 0;
+  int num_free;
+  ssize_t k;
+  size_t in_len = 0;
+  size_t off;
+  uint32_t req_len = sizeof(ingress_req_t);
+  uint32_t resp_len;
+  uint64_t now;
+  int *free_slots = NULL;
+  uint64_t *send_ns = NULL;
+  char *out = NULL;
+  char *in = NULL;
+  order_t order;
+  ingress_req_t req;
+  ingress_resp_t resp;
+  conn_arg_t *ca = arg;
+  rng_t rng = ca->rng;
+  free_slots = malloc_perror(ca->window, sizeof(int));
+  send_ns = malloc_perror(ca->window, sizeof(uint64_t));
+  out = malloc_perror(ca->window, C_REQ_FRAME);
+  in = malloc_perror(ca->window, C_RESP_FRAME);
+  for (i = 0; i < ca->window; i++){
+    free_slots[i] = i;
+  }
+  num_free = ca->window;
+  fd = connect_perror(ca->path);
+  memset(&req, 0, sizeof(ingress_req_t));
+  while (num_done < ca->order_count){
+    /* write a batch of the free window */
+    now = time_mono_ns_perror();
+    for (n = 0; num_free > 0 && num_sent < ca->order_count; n++){
+      workload_next(ca->w, &rng, &order);
+      req.tag = free_slots[--num_free];
+      req.stock_id = order.stock_id;
+      req.quantity = order.quantity;
+      req.action = order.action;
+      req.lane = order.lane;
+      send_ns[req.tag] = now;
+      memcpy(out + n * C_REQ_FRAME, &req_len, sizeof(uint32_t));
+      memcpy(out + n * C_REQ_FRAME + sizeof(uint32_t), &req,
+	     sizeof(ingress_req_t));
+      num_sent++;
+    }
+    if (n > 0) write_all_perror(fd, out, n * C_REQ_FRAME);
+    /* read the available responses */
+    k = read(fd, in + in_len, ca->window * C_RESP_FRAME - in_len);
+    if (k < 0 && errno == EINTR) continue;
+    if (k <= 0){
+      fprintf(stderr, "connection %d: ingress closed the connection\n",
+	      ca->id);
+      exit(EXIT_FAILURE);
+    }
+    now = time_mono_ns_perror();
+    in_len += k;
+    for (off = 0; in_len - off >= C_RESP_FRAME; off += C_RESP_FRAME){
+      memcpy(&resp_len, in + off, sizeof(uint32_t));
+      memcpy(&resp, in + off + sizeof(uint32_t), sizeof(ingress_resp_t));
+      if (resp_len != sizeof(ingress_resp_t) ||
+	  resp.tag >= (uint32_t)ca->window){
+	fprintf(stderr, "connection %d: invalid response\n", ca->id);
+	exit(EXIT_FAILURE);
+      }
+      if (resp.status == INGRESS_REJECTED ||
+	  resp.status == INGRESS_STAGE_REJECTED){
+	ca->num_rejected++;
+      }else if (resp.status == INGRESS_INVALID){
+	ca->num_invalid++;
+      }else{
+	hist_add(&ca->rtt_hist, now - send_ns[resp.tag]);
+	hist_add(&ca->server_hist, resp.latency_ns);
+      }
+      free_slots[num_free++] = resp.tag;
+      num_done++;
+    }
+    memmove(in, in + off, in_len - off);
+    in_len -= off;
+  }
+  if (close(fd) != 0){
+    perror("close failed");
+    exit(EXIT_FAILURE);
+  }
+  free(free_slots);
+  free(send_ns);
+  free(out);
+  free(in);
+  return NULL;
+}
+
+void latency_print(const char *label, const hist_t *h){
+  printf("%s (ns): mean %.0f, p50 %lu, p90 %lu, p99 %lu, "
+	 "p99.9 %lu, max %lu\n",
+	 label,
+	 hist_mean(h),
+	 (unsigned long)hist_quantile(h, 0.5),
+	 (unsigned long)hist_quantile(h, 0.9),
+	 (unsigned long)hist_quantile(h, 0.99),
+	 (unsigned long)hist_quantile(h, 0.999),
+	 (unsigned long)h->max);
+}
+
+int main(int argc, char **argv){
+  int i;
+  int c;
+  int num_conns = C_DEF_NUM_CONNS;
+  int orders_per_conn = C_DEF_ORDERS_PER_CONN;
+  int window = C_DEF_WINDOW;
+  int num_stocks = C_DEF_NUM_STOCKS;
+  unsigned long num_rejected = 0;
+  unsigned long num_invalid = 0;
+  double start, end;
+  uint64_t seed = time(NULL);
+  workload_t *w = NULL;
+  pthread_t *tids = NULL;
+  conn_arg_t *cas = NULL;
+  hist_t rtt_hist, server_hist;
+  rng_t rng;
+  w = malloc_perror(1, sizeof(workload_t));
+  workload_defaults(w);
+  while ((c = getopt(argc, argv, ARGS)) != -1){
+    switch (c){
+    case 'c':
+      num_conns = atoi(optarg);
+      if (num_conns < 1){
+	fprintf(stderr,"number of connections must be > 0\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'o':
+      orders_per_conn = atoi(optarg);
+      if (orders_per_conn < 0){
+	fprintf(stderr,"orders per connection must be non-negative\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'w':
+      window = atoi(optarg);
+      if (window < 1){
+	fprintf(stderr,"window must be > 0\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 's':
+      num_stocks = atoi(optarg);
+      if (num_stocks < 1){
+	fprintf(stderr,"number of stocks must be > 0\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'd':
+      if (workload_parse_stock(w, optarg) != 0){
+	fprintf(stderr,"stock distribution must be uniform, zipf:s with "
+		"s > 0, or hot:prob:frac with prob in [0, 1] and "
+		"frac in (0, 1]\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'p':
+      w->prob_buy = atof(optarg);
+      if (w->prob_buy < 0.0 || w->prob_buy > 1.0){
+	fprintf(stderr,"buy probability must be in [0, 1]\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'Q':
+      if (workload_parse_quantity(w, optarg) != 0){
+	fprintf(stderr,"quantity distribution must be uniform or "
+		"pareto:alpha with alpha > 0\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'U':
+      w->prob_urgent = atof(optarg);
+      if (w->prob_urgent < 0.0 || w->prob_urgent > 1.0){
+	fprintf(stderr,"urgent probability must be in [0, 1]\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'x':
+      seed = strtoull(optarg, NULL, 10);
+      break;
+    default:
+      fprintf(stderr, "unrecognized command %c\n", (char)c);
+      fprintf(stderr,"usage: %s", C_USAGE);
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (optind != argc - 1){
+    fprintf(stderr,"usage: %s", C_USAGE);
+    exit(EXIT_FAILURE);
+  }
+  workload_init(w, num_stocks, C_DEF_QUANTITY);
+  tids = malloc_perror(num_conns, sizeof(pthread_t));
+  cas = malloc_perror(num_conns, sizeof(conn_arg_t));
+  rng_seed(&rng, seed);
+  start = time_mono_sec_perror();
+  for (i = 0; i < num_conns; i++){
+    cas[i].id = i;
+    cas[i].order_count = orders_per_conn;
+    cas[i].window = window;
+    cas[i].path = argv[optind];
+    cas[i].w = w;
+    cas[i].rng = rng;
+    rng_jump(&rng);
+    hist_init(&cas[i].rtt_hist);
+    hist_init(&cas[i].server_hist);
+    cas[i].num_rejected = 0;
+    cas[i].num_invalid = 0;
+    thread_create_perror(&tids[i], conn_thread, &cas[i]);
+  }
+  for (i = 0; i < num_conns; i++){
+    thread_join_perror(tids[i], NULL);
+  }
+  end = time_mono_sec_perror();
+  hist_init(&rtt_hist);
+  hist_init(&server_hist);
+  for (i = 0; i < num_conns; i++){
+    hist_merge(&rtt_hist, &cas[i].rtt_hist);
+    hist_merge(&server_hist, &cas[i].server_hist);
+    num_rejected += cas[i].num_rejected;
+    num_invalid += cas[i].num_invalid;
+    hist_free(&cas[i].rtt_hist);
+    hist_free(&cas[i].server_hist);
+  }
+  printf("ingress-gen: %d connections, window %d, %f orders / sec, "
+	 "%lu rejected, %lu invalid\n",
+	 num_conns,
+	 window,
+	 (double)orders_per_conn * num_conns / (end - start),
+	 num_rejected,
+	 num_invalid);
+  latency_print("round trip", &rtt_hist);
+  latency_print("bound-buf", &server_hist);
+  hist_free(&rtt_hist);
+  hist_free(&server_hist);
+  workload_free(w);
+  free(w);
+  free(tids);
+  free(cas);
+  w = NULL;
+  tids = NULL;
+  cas = NULL;
+  return 0;
+}
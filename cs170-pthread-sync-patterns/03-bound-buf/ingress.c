@@ -0,0 +1,540 @@
+/**
+   ingress.c
+
+   An ingress front end of the bound-buf benchmark over Unix domain stream
+   sockets, with an epoll event loop and eventfd wakeups.
+
+   All sockets are nonblocking and registered level-triggered. A
+   connection is registered for EPOLLIN while it is read, and for EPOLLOUT
+   only while responses are left after a partial write, so that the event
+   loop does not wake up for writable sockets. A connection is closed
+   after the end of its stream, or a protocol error, once all its queued
+   orders were fulfilled, because the order of a trader refers to its
+   connection. A connection is also unregistered for EPOLLIN while it is
+   stalled at a full queue, and the event loop waits at most a poll
+   interval while a connection is stalled, because a queue that is full of
+   orders of the client threads does not wake up the ingress.
+
+   The completions are double buffered: traders append into the active
+   list under the lock of the ingress, and the ingress thread swaps the
+   active list with its spare list under the lock, and writes the
+   responses without the lock. Both lists hold the orders of all
+   connections, i.e. do not fill up.
+*/
+
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include "ingress.h"
+#include "bound-buf.h"
+#include "utilities-mem.h"
+#include "utilities-pthread.h"
+#include "utilities-time.h"
+
+#define MAX_EVENTS (64) /* used as int */
+#define STALL_POLL_MS (1) /* used as int */
+
+static const int C_DEF_NUM_CONNS = 1;
+static const int C_DEF_WINDOW = 64;
+static const size_t C_REQ_FRAME = sizeof(uint32_t) + sizeof(ingress_req_t);
+static const size_t C_RESP_FRAME =
+  sizeof(uint32_t) + sizeof(ingress_resp_t);
+
+int ingress_parse(char *path,
+		  size_t path_size,
+		  int *num_conns,
+		  int *window,
+		  const char *s){
+  int n = 0;
+  size_t len;
+  const char *colon = strchr(s, ':');
+  *num_conns = C_DEF_NUM_CONNS;
+  *window = C_DEF_WINDOW;
+  len = (colon == NULL) ? strlen(s) : (size_t)(colon - s);
+  if (len == 0 || len >= path_size) return -1;
+  memcpy(path, s, len);
+  path[len] = '\0';
+  if (colon == NULL) return 0;
+  s = colon;
+  if (sscanf(s, ":%d%n", num_conns, &n) != 1) return -1;
+  s += n;
+  if (*s == ':'){
+    if (sscanf(s, ":%d%n", window, &n) != 1) return -1;
+    s += n;
+  }
+  if (*s != '\0' || *num_conns < 1 || *window < 1) return -1;
+  return 0;
+}
+
+static void set_nonblock_perror(int fd){
+  int flags = fcntl(fd, F_GETFL);
+  if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0){
+    perror("ingress fcntl failed");
+    exit(EXIT_FAILURE);
+  }
+}
+
+static void epoll_ctl_perror(int epoll_fd,
+			     int op,
+			     int fd,
+			     uint32_t events,
+			     void *ptr){
+  struct epoll_event ev;
+  memset(&ev, 0, sizeof(struct epoll_event));
+  ev.events = events;
+  ev.data.ptr = ptr;
+  if (epoll_ctl(epoll_fd, op, fd, &ev) != 0){
+    perror("ingress epoll_ctl failed");
+    exit(EXIT_FAILURE);
+  }
+}
+
+void ingress_init_perror(ingress_t *ing,
+			 const char *path,
+			 int num_conns,
+			 int window,
+			 int client_id,
+			 int num_stocks,
+			 int quantity,
+			 const backend_t *b,
+			 void *q){
+  struct sockaddr_un addr;
+  struct stat st;
+  memset(ing, 0, sizeof(ingress_t));
+  memset(&addr, 0, sizeof(struct sockaddr_un));
+  if (strlen(path) >= sizeof(addr.sun_path)){
+    fprintf(stderr, "ingress socket path %s is too long\n", path);
+    exit(EXIT_FAILURE);
+  }
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+  ing->path = malloc_perror(strlen(path) + 1, sizeof(char));
+  strcpy(ing->path, path);
+  ing->num_conns = num_conns;
+  ing->window = window;
+  ing->client_id = client_id;
+  ing->num_stocks = num_stocks;
+  ing->quantity = quantity;
+  ing->b = b;
+  ing->q = q;
+  mutex_init_perror(&ing->lock);
+  ing->conns = calloc_perror(num_conns, sizeof(ingress_conn_t *));
+  ing->done_orders = malloc_perror(mul_sz_perror(num_conns, window),
+				   sizeof(ingress_order_t *));
+  ing->spare_orders = malloc_perror(mul_sz_perror(num_conns, window),
+				    sizeof(ingress_order_t *));
+  /* replace a stale socket of a previous run, but no other file */
+  if (lstat(path, &st) == 0 && S_ISSOCK(st.st_mode) && unlink(path) != 0){
+    perror("ingress unlink failed");
+    exit(EXIT_FAILURE);
+  }
+  ing->listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (ing->listen_fd < 0){
+    perror("ingress socket failed");
+    exit(EXIT_FAILURE);
+  }
+  if (bind(ing->listen_fd, (struct sockaddr *)&addr,
+	   sizeof(struct sockaddr_un)) != 0){
+    perror("ingress bind failed");
+    exit(EXIT_FAILURE);
+  }
+  if (listen(ing->listen_fd, num_conns) != 0){
+    perror("ingress listen failed");
+    exit(EXIT_FAILURE);
+  }
+  set_nonblock_perror(ing->listen_fd);
+  ing->event_fd = eventfd(0, 0);
+  if (ing->event_fd < 0){
+    perror("ingress eventfd failed");
+    exit(EXIT_FAILURE);
+  }
+  set_nonblock_perror(ing->event_fd);
+  ing->epoll_fd = epoll_create(MAX_EVENTS);
+  if (ing->epoll_fd < 0){
+    perror("ingress epoll_create failed");
+    exit(EXIT_FAILURE);
+  }
+  /* the addresses of the fds identify the listening socket and eventfd */
+  epoll_ctl_perror(ing->epoll_fd, EPOLL_CTL_ADD, ing->listen_fd, EPOLLIN,
+		   &ing->listen_fd);
+  epoll_ctl_perror(ing->epoll_fd, EPOLL_CTL_ADD, ing->event_fd, EPOLLIN,
+		   &ing->event_fd);
+}
+
+/**
+   Accepts pending connections until num_conns connections are accepted,
+   and then stops listening.
+*/
+static void conn_accept(ingress_t *ing){
+  int i;
+  int fd;
+  ingress_conn_t *c = NULL;
+  while (ing->num_accepted < ing->num_conns){
+    fd = accept(ing->listen_fd, NULL, NULL);
+    if (fd < 0 && errno == EINTR) continue;
+    if (fd < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+    if (fd < 0){
+      perror("ingress accept failed");
+      exit(EXIT_FAILURE);
+    }
+    set_nonblock_perror(fd);
+    c = calloc_perror(1, sizeof(ingress_conn_t));
+    c->fd = fd;
+    c->events = EPOLLIN;
+    c->orders = malloc_perror(ing->window, sizeof(ingress_order_t));
+    for (i = 0; i < ing->window; i++){
+      c->orders[i].conn = c;
+      c->orders[i].next = (i + 1 < ing->window) ? &c->orders[i + 1] : NULL;
+    }
+    c->free_orders = &c->orders[0];
+    c->in = malloc_perror(ing->window, C_REQ_FRAME);
+    c->out = malloc_perror(ing->window, C_RESP_FRAME);
+    ing->conns[ing->num_accepted++] = c;
+    epoll_ctl_perror(ing->epoll_fd, EPOLL_CTL_ADD, fd, c->events, c);
+  }
+  epoll_ctl_perror(ing->epoll_fd, EPOLL_CTL_DEL, ing->listen_fd, 0, NULL);
+  if (close(ing->listen_fd) != 0){
+    perror("ingress close failed");
+    exit(EXIT_FAILURE);
+  }
+  ing->listen_fd = -1;
+}
+
+/**
+   Appends the response to an order to the output of its connection,
+   unless responses are dropped, and returns the order to the free list.
+*/
+static void conn_respond(ingress_conn_t *c,
+			 ingress_order_t *io,
+			 ingress_status_t status,
+			 uint64_t latency_ns){
+  uint32_t len = sizeof(ingress_resp_t);
+  ingress_resp_t resp;
+  if (!c->broken){
+    resp.tag = io->tag;
+    resp.status = status;
+    resp.latency_ns = latency_ns;
+    memcpy(c->out + c->out_len, &len, sizeof(uint32_t));
+    memcpy(c->out + c->out_len + sizeof(uint32_t), &resp,
+	   sizeof(ingress_resp_t));
+    c->out_len += C_RESP_FRAME;
+  }
+  io->next = c->free_orders;
+  c->free_orders = io;
+}
+
+/**
+   Stops reading a connection after a protocol error, and drops its
+   responses.
+*/
+static void conn_fail(ingress_t *ing, ingress_conn_t *c){
+  ing->num_protocol_errors++;
+  c->closing = TRUE;
+  c->broken = TRUE;
+  c->out_len = 0;
+}
+
+/**
+   Queues the orders of the complete frames in the input of a connection,
+   with a start time of now_ns, and returns the number of orders.
+   Responds without queuing to an invalid order and to an order that is
+   rejected by the admission policy of the queue. Stalls the connection
+   at a full queue, with the remaining frames left in the input.
+*/
+static int conn_parse(ingress_t *ing, ingress_conn_t *c, uint64_t now_ns){
+  int n = 0;
+  size_t off = 0;
+  uint32_t len;
+  boolean_t valid;
+  enqueue_t ret = ENQUEUE_QUEUED;
+  ingress_req_t req;
+  ingress_order_t *io = NULL;
+  order_t *order = NULL;
+  while (!c->closing && c->in_len - off >= C_REQ_FRAME){
+    memcpy(&len, c->in + off, sizeof(uint32_t));
+    /* an order is without a response while it is queued, and while its
+       response is not written, e.g. of an invalid order */
+    if (len != sizeof(ingress_req_t) ||
+	c->num_pending + c->out_len / C_RESP_FRAME >= (size_t)ing->window){
+      conn_fail(ing, c); /* unknown frame, or beyond the window */
+      break;
+    }
+    memcpy(&req, c->in + off + sizeof(uint32_t), sizeof(ingress_req_t));
+    io = c->free_orders;
+    io->tag = req.tag;
+    valid = (req.stock_id >= 0 && req.stock_id < ing->num_stocks &&
+	     req.quantity >= 0 && req.quantity <= ing->quantity &&
+	     req.action <= SELL && req.lane < NUM_LANES);
+    if (valid){
+      order = &io->order;
+      order->stock_id = req.stock_id;
+      order->quantity = req.quantity;
+      order->action = req.action;
+      order->lane = req.lane;
+      order->client_id = ing->client_id;
+      order->start_ns = now_ns;
+      order->deadline_ns = 0; /* no time in force */
+      order->batch = NULL;
+      order->rejected = FALSE;
+      ret = ing->b->queue_try_enqueue(ing->q, order);
+      if (ret == ENQUEUE_FULL){
+	/* keep the frame for a retry instead of blocking the event loop */
+	c->stalled = TRUE;
+	c->stall_ns = now_ns;
+	ing->num_stalled++;
+	ing->num_stalls++;
+	break;
+      }
+    }
+    /* the order of a trader does not refer to the free list */
+    off += C_REQ_FRAME;
+    c->free_orders = io->next;
+    n++;
+    ing->num_orders++;
+    if (!valid){
+      ing->num_invalid++;
+      conn_respond(c, io, INGRESS_INVALID, 0);
+    }else if (ret == ENQUEUE_REJECTED){
+      ing->num_rejected++;
+      conn_respond(c, io, INGRESS_REJECTED, 0);
+    }else{
+      c->num_pending++;
+    }
+  }
+  if (c->closing){
+    c->in_len = 0;
+  }else{
+    memmove(c->in, c->in + off, c->in_len - off);
+    c->in_len -= off;
+  }
+  return n;
+}
+
+/**
+   Reads a connection until its socket is drained or it is stalled, and
+   queues the orders of the received frames after each read.
+*/
+static void conn_read(ingress_t *ing, ingress_conn_t *c){
+  int n;
+  ssize_t k;
+  size_t cap = ing->window * C_REQ_FRAME;
+  while (!c->closing && !c->stalled){
+    k = read(c->fd, c->in + c->in_len, cap - c->in_len);
+    if (k < 0 && errno == EINTR) continue;
+    if (k < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+    if (k <= 0){
+      /* end of stream, or a reset by the process */
+      c->closing = TRUE;
+      if (k < 0) c->broken = TRUE;
+      return;
+    }
+    c->in_len += k;
+    n = conn_parse(ing, c, time_mono_ns_perror());
+    if (n > 0) ing->num_reads++;
+    if (n > ing->max_read_batch) ing->max_read_batch = n;
+  }
+}
+
+/**
+   Retries the frames of the stalled connections, with their read times.
+*/
+static void conn_retry(ingress_t *ing){
+  int i, n;
+  ingress_conn_t *c = NULL;
+  for (i = 0; i < ing->num_accepted && ing->num_stalled > 0; i++){
+    c = ing->conns[i];
+    if (c == NULL || !c->stalled) continue;
+    c->stalled = FALSE;
+    ing->num_stalled--;
+    n = conn_parse(ing, c, c->stall_ns);
+    if (n > 0) ing->num_reads++;
+    if (n > ing->max_read_batch) ing->max_read_batch = n;
+  }
+}
+
+/**
+   Writes the responses of a connection until the socket is full.
+*/
+static void conn_write(ingress_conn_t *c){
+  ssize_t k;
+  size_t off = 0;
+  while (!c->broken && off < c->out_len){
+    k = send(c->fd, c->out + off, c->out_len - off, MSG_NOSIGNAL);
+    if (k < 0 && errno == EINTR) continue;
+    if (k < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+    if (k < 0){
+      /* the process closed the connection; drop the responses */
+      c->broken = TRUE;
+      c->closing = TRUE;
+      c->out_len = 0;
+      return;
+    }
+    off += k;
+  }
+  memmove(c->out, c->out + off, c->out_len - off);
+  c->out_len -= off;
+}
+
+/**
+   Writes the responses of a connection and updates its registration, or
+   closes it if it is closing and has neither queued orders nor responses
+   left. Returns TRUE if the connection was closed.
+*/
+static boolean_t conn_update(ingress_t *ing, ingress_conn_t *c){
+  uint32_t events;
+  if (c->out_len > 0) conn_write(c);
+  if (c->closing && c->stalled){
+    /* the frames of a failed connection are not retried */
+    c->stalled = FALSE;
+    ing->num_stalled--;
+  }
+  if (c->closing && c->num_pending == 0 && c->out_len == 0){
+    if (c->events != 0){
+      epoll_ctl_perror(ing->epoll_fd, EPOLL_CTL_DEL, c->fd, 0, NULL);
+    }
+    if (close(c->fd) != 0){
+      perror("ingress close failed");
+      exit(EXIT_FAILURE);
+    }
+    free(c->orders);
+    free(c->in);
+    free(c->out);
+    free(c);
+    ing->num_closed++;
+    return TRUE;
+  }
+  /* unregister a connection without events, because a hangup is
+     reported regardless of the registered events */
+  events = ((c->closing || c->stalled) ? 0 : EPOLLIN) |
+    ((c->out_len > 0) ? EPOLLOUT : 0);
+  if (events != c->events){
+    epoll_ctl_perror(ing->epoll_fd,
+		     (events == 0) ? EPOLL_CTL_DEL :
+		     (c->events == 0) ? EPOLL_CTL_ADD : EPOLL_CTL_MOD,
+		     c->fd, events, c);
+    c->events = events;
+  }
+  return FALSE;
+}
+
+/**
+   Resets the eventfd, swaps the lists of completions, and responds to the
+   completed orders.
+*/
+static void ingress_drain(ingress_t *ing){
+  int i, n;
+  uint64_t val;
+  ingress_order_t **orders = NULL;
+  ingress_order_t *io = NULL;
+  if (read(ing->event_fd, &val, sizeof(uint64_t)) < 0 &&
+      errno != EAGAIN && errno != EINTR){
+    perror("ingress eventfd read failed");
+    exit(EXIT_FAILURE);
+  }
+  ing->num_wakeups++;
+  mutex_lock_perror(&ing->lock);
+  n = ing->num_done;
+  orders = ing->done_orders;
+  ing->done_orders = ing->spare_orders;
+  ing->spare_orders = orders;
+  ing->num_done = 0;
+  mutex_unlock_perror(&ing->lock);
+  for (i = 0; i < n; i++){
+    io = orders[i];
+    io->conn->num_pending--;
+    if (io->order.rejected){
+      ing->num_stage_rejected++;
+      conn_respond(io->conn, io, INGRESS_STAGE_REJECTED, 0);
+    }else{
+      conn_respond(io->conn, io, INGRESS_DONE,
+		   io->done_ns - io->order.start_ns);
+    }
+  }
+  ing->num_completions += n;
+}
+
+void *ingress_thread(void *arg){
+  int i, n;
+  ingress_t *ing = arg;
+  ingress_conn_t *c = NULL;
+  struct epoll_event events[MAX_EVENTS];
+  while (ing->num_closed < ing->num_conns){
+    n = epoll_wait(ing->epoll_fd, events, MAX_EVENTS,
+		   (ing->num_stalled > 0) ? STALL_POLL_MS : -1);
+    if (n < 0 && errno == EINTR) continue;
+    if (n < 0){
+      perror("ingress epoll_wait failed");
+      exit(EXIT_FAILURE);
+    }
+    for (i = 0; i < n; i++){
+      if (events[i].data.ptr == &ing->listen_fd){
+	conn_accept(ing);
+      }else if (events[i].data.ptr == &ing->event_fd){
+	ingress_drain(ing);
+      }else{
+	c = events[i].data.ptr;
+	if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)){
+	  conn_read(ing, c);
+	}
+      }
+    }
+    /* retry after completions, which dequeued orders, or a timeout */
+    if (ing->num_stalled > 0) conn_retry(ing);
+    /* write the responses of the events in one pass */
+    for (i = 0; i < ing->num_accepted; i++){
+      if (ing->conns[i] != NULL && conn_update(ing, ing->conns[i])){
+	ing->conns[i] = NULL;
+      }
+    }
+  }
+  return NULL;
+}
+
+void ingress_complete(ingress_t *ing, order_t *order, uint64_t now_ns){
+  boolean_t wake;
+  uint64_t one = 1;
+  ingress_order_t *io = (ingress_order_t *)order;
+  io->done_ns = now_ns;
+  mutex_lock_perror(&ing->lock);
+  ing->done_orders[ing->num_done++] = io;
+  /* the ingress thread is woken once until it swaps the list */
+  wake = (ing->num_done == 1);
+  if (wake) ing->num_signals++;
+  mutex_unlock_perror(&ing->lock);
+  if (wake && write(ing->event_fd, &one, sizeof(uint64_t)) < 0){
+    perror("ingress eventfd write failed");
+    exit(EXIT_FAILURE);
+  }
+}
+
+void ingress_free_perror(ingress_t *ing){
+  if ((ing->listen_fd >= 0 && close(ing->listen_fd) != 0) ||
+      close(ing->event_fd) != 0 ||
+      close(ing->epoll_fd) != 0){
+    perror("ingress close failed");
+    exit(EXIT_FAILURE);
+  }
+  if (unlink(ing->path) != 0){
+    perror("ingress unlink failed");
+    exit(EXIT_FAILURE);
+  }
+  free(ing->path);
+  free(ing->conns);
+  free(ing->done_orders);
+  free(ing->spare_orders);
+  ing->path = NULL;
+  ing->conns = NULL;
+  ing->done_orders = NULL;
+  ing->spare_orders = NULL;
+}
@@ -0,0 +1,173 @@
+/**
+   ingress.h
+
+   Declarations of an ingress front end of the bound-buf benchmark that
+   accepts orders from other local processes over Unix domain stream
+   sockets, e.g. the load generator ingress-gen (ingress-gen.c), in
+   addition to the orders of the client threads.
+
+   An ingress thread runs an epoll event loop over a listening socket, the
+   accepted connections, and an eventfd. Each read from a connection
+   drains the socket into a buffer, and the orders of the complete frames
+   in the buffer are queued with one client id, the ingress client id,
+   each with the admission policy of the queue, but without blocking the
+   event loop: if the queue is full, the frames are left in the buffer,
+   the connection is not read, and the order is retried after the next
+   wakeup of the event loop, at the latest after a poll interval. A
+   trader that fulfills an order of the ingress adds it to a list of
+   completions, and writes the eventfd only if the list was empty, so that
+   one wakeup of the event loop delivers the completions of several
+   traders. The event loop then writes a response frame for each completed
+   order to its connection.
+
+   Flow control is by credits: a connection may have at most window
+   orders without a response, and the orders of a connection are
+   preallocated at accept. A connection that sends more orders is closed;
+   the ingress counts a response as sent when it is written to the socket.
+
+   Wire format, in host byte order because both ends are local: a frame
+   is a 4-byte length of the payload, followed by the payload, i.e. an
+   ingress_req_t from a process to the ingress, or an ingress_resp_t from
+   the ingress to the process.
+*/
+
+#ifndef INGRESS_H
+#define INGRESS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "bound-buf.h"
+
+typedef enum{INGRESS_DONE, /* executed */
+	     INGRESS_REJECTED, /* rejected by the admission policy */
+	     INGRESS_INVALID, /* a field of the order is out of range */
+	     INGRESS_STAGE_REJECTED /* rejected by a pipeline stage */
+} ingress_status_t;
+
+typedef struct{
+  uint32_t tag; /* echoed in the response */
+  int32_t stock_id;
+  int32_t quantity;
+  uint8_t action; /* action_t */
+  uint8_t lane; /* lane_t */
+  uint8_t pad[2];
+} ingress_req_t;
+
+typedef struct{
+  uint32_t tag;
+  uint32_t status; /* ingress_status_t */
+  uint64_t latency_ns; /* from the read of the order to its fulfillment */
+} ingress_resp_t;
+
+/**
+   An order of a connection. order is the first member, so that the
+   completion handle of the order, which is its address, is the address
+   of the ingress order.
+*/
+typedef struct ingress_order{
+  order_t order;
+  struct ingress_conn *conn;
+  uint32_t tag;
+  uint64_t done_ns;
+  struct ingress_order *next; /* in the free list of the connection */
+} ingress_order_t;
+
+typedef struct ingress_conn{
+  int fd;
+  int num_pending; /* queued orders without a response */
+  boolean_t closing; /* no more orders are read */
+  boolean_t broken; /* responses are dropped */
+  boolean_t stalled; /* the first frame of in waits for a full queue */
+  uint64_t stall_ns; /* read time of the frames in in while stalled */
+  uint32_t events; /* registered epoll events; 0 if not registered */
+  ingress_order_t *orders; /* window orders */
+  ingress_order_t *free_orders;
+  char *in; /* received bytes of incomplete frames */
+  size_t in_len;
+  char *out; /* response frames not yet written */
+  size_t out_len;
+} ingress_conn_t;
+
+typedef struct{
+  char *path;
+  int listen_fd;
+  int epoll_fd;
+  int event_fd;
+  int num_conns; /* connections to accept before the ingress is done */
+  int window; /* orders without a response per connection */
+  int client_id;
+  int num_stocks;
+  int quantity; /* maximal quantity */
+  const backend_t *b;
+  void *q;
+  struct ingress_conn **conns; /* in accept order; NULL if closed */
+  /* completions, written by traders under lock */
+  pthread_mutex_t lock;
+  ingress_order_t **done_orders;
+  ingress_order_t **spare_orders;
+  int num_done;
+  unsigned long num_signals; /* eventfd writes */
+  /* written by the ingress thread */
+  int num_accepted;
+  int num_closed;
+  int num_protocol_errors;
+  int num_stalled; /* connections */
+  unsigned long num_stalls; /* frames left in the input at a full queue */
+  unsigned long num_orders;
+  unsigned long num_rejected;
+  unsigned long num_invalid;
+  unsigned long num_reads; /* reads or retries with at least one order */
+  int max_read_batch; /* orders */
+  unsigned long num_wakeups; /* eventfd reads */
+  unsigned long num_completions;
+  unsigned long num_stage_rejected; /* of the completions */
+} ingress_t;
+
+/**
+   Parse an ingress configuration "<path>[:<connections>[:<window>]]"
+   into a path of at most path_size bytes, the number of connections, and
+   the window of a connection. Returns 0 on success and -1 on invalid
+   input.
+*/
+int ingress_parse(char *path,
+		  size_t path_size,
+		  int *num_conns,
+		  int *window,
+		  const char *s);
+
+/**
+   Initialize an ingress, and bind and listen on its socket path, which is
+   replaced if it is a stale socket. Orders are queued on q of backend b
+   with client_id, and are validated against num_stocks and quantity.
+*/
+void ingress_init_perror(ingress_t *ing,
+			 const char *path,
+			 int num_conns,
+			 int window,
+			 int client_id,
+			 int num_stocks,
+			 int quantity,
+			 const backend_t *b,
+			 void *q);
+
+/**
+   Entry function of the ingress thread. Returns after num_conns
+   connections were accepted and closed, and all their orders were
+   fulfilled.
+*/
+void *ingress_thread(void *arg);
+
+/**
+   Called by a trader instead of the completion of the backend, for an
+   order of the ingress that was fulfilled at now_ns.
+*/
+void ingress_complete(ingress_t *ing, order_t *order, uint64_t now_ns);
+
+/**
+   Close the sockets of an ingress after its thread is joined, and remove
+   its socket path.
+*/
+void ingress_free_perror(ingress_t *ing);
+
+#endif
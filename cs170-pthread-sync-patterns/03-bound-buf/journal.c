@@ -0,0 +1,228 @@
+/**
+   journal.c
+
+   An append-only write-ahead journal with group commit for the bound-buf
+   benchmark.
+
+   The buffers are double buffered: traders append into the active
+   buffer under the lock of the journal, and the flusher swaps the active
+   buffer with its spare buffer under the lock, and writes and commits the
+   swapped buffer without the lock. A trader blocks on a full active
+   buffer until the next swap, so that the buffered records are bounded by
+   two buffers. The flusher and the traders are signaled only if waiting.
+*/
+
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "journal.h"
+#include "bound-buf.h"
+#include "utilities-mem.h"
+#include "utilities-pthread.h"
+#include "utilities-time.h"
+#include "utilities-hist.h"
+
+static const int C_DEF_MAX_BATCH = 1024;
+
+static const char *C_LEVEL_NAMES[] = {"write", "async", "sync"};
+
+/**
+   Writes n bytes with error checking, and retries partial writes.
+*/
+static void write_all_perror(int fd, const void *buf, size_t n){
+  ssize_t k;
+  const char *p = buf;
+  while (n > 0){
+    k = write(fd, p, n);
+    if (k < 0 && errno == EINTR) continue;
+    if (k < 0){
+      perror("journal write failed");
+      exit(EXIT_FAILURE);
+    }
+    p += k;
+    n -= k;
+  }
+}
+
+/**
+   Swaps the active buffer with the spare buffer while there are records
+   or the journal is not done, writes the records, commits them with
+   fdatasync unless the level is JOURNAL_WRITE, and, at the JOURNAL_SYNC
+   level, calls the durable function for the order of each record.
+*/
+static void *flusher_thread(void *arg){
+  int i, n;
+  uint64_t start, now;
+  journal_rec_t *recs = NULL;
+  order_rec_t *orders = NULL;
+  journal_t *j = arg;
+  mutex_lock_perror(&j->lock);
+  while (TRUE){
+    while (j->count == 0 && !j->done){
+      j->num_wait_nempty++;
+      cond_wait_perror(&j->cond_nempty, &j->lock);
+      j->num_wait_nempty--;
+    }
+    if (j->count == 0) break; /* done */
+    n = j->count;
+    recs = j->recs;
+    orders = j->orders;
+    j->recs = j->spare_recs;
+    j->orders = j->spare_orders;
+    j->count = 0;
+    if (j->num_wait_nfull > 0) cond_broadcast_perror(&j->cond_nfull);
+    mutex_unlock_perror(&j->lock);
+    start = time_mono_ns_perror();
+    write_all_perror(j->fd, recs, n * sizeof(journal_rec_t));
+    if (j->level != JOURNAL_WRITE){
+      if (fdatasync(j->fd) != 0){
+	perror("journal fdatasync failed");
+	exit(EXIT_FAILURE);
+      }
+      j->num_fsyncs++;
+    }
+    now = time_mono_ns_perror();
+    hist_add(&j->commit_hist, now - start);
+    j->num_commits++;
+    j->num_recs += n;
+    if (n > j->max_commit) j->max_commit = n;
+    if (j->level == JOURNAL_SYNC){
+      for (i = 0; i < n; i++){
+	j->durable(j->durable_arg, &orders[i], now);
+      }
+    }
+    mutex_lock_perror(&j->lock);
+    j->spare_recs = recs;
+    j->spare_orders = orders;
+  }
+  mutex_unlock_perror(&j->lock);
+  return NULL;
+}
+
+int journal_parse(char *path,
+		  size_t path_size,
+		  durability_t *level,
+		  int *max_batch,
+		  const char *s){
+  int n = 0;
+  size_t len;
+  const char *colon = strchr(s, ':');
+  *level = JOURNAL_SYNC;
+  *max_batch = C_DEF_MAX_BATCH;
+  len = (colon == NULL) ? strlen(s) : (size_t)(colon - s);
+  if (len == 0 || len >= path_size) return -1;
+  memcpy(path, s, len);
+  path[len] = '\0';
+  if (colon == NULL) return 0;
+  s = colon + 1;
+  if (strncmp(s, "write", 5) == 0){
+    *level = JOURNAL_WRITE;
+    s += 5;
+  }else if (strncmp(s, "async", 5) == 0){
+    *level = JOURNAL_ASYNC;
+    s += 5;
+  }else if (strncmp(s, "sync", 4) == 0){
+    *level = JOURNAL_SYNC;
+    s += 4;
+  }else{
+    return -1;
+  }
+  if (*s == ':'){
+    if (sscanf(s, ":%d%n", max_batch, &n) != 1) return -1;
+    s += n;
+  }
+  if (*s != '\0' || *max_batch < 1) return -1;
+  return 0;
+}
+
+void journal_open_perror(journal_t *j,
+			 const char *path,
+			 durability_t level,
+			 int max_batch,
+			 int num_stocks,
+			 void (*durable)(void *arg,
+					 const order_rec_t *rec,
+					 uint64_t now_ns),
+			 void *durable_arg){
+  journal_hdr_t hdr;
+  memset(j, 0, sizeof(journal_t));
+  j->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (j->fd < 0){
+    perror("journal open failed");
+    exit(EXIT_FAILURE);
+  }
+  memset(&hdr, 0, sizeof(journal_hdr_t));
+  memcpy(hdr.magic, JOURNAL_MAGIC, sizeof(hdr.magic));
+  hdr.rec_size = sizeof(journal_rec_t);
+  hdr.num_stocks = num_stocks;
+  write_all_perror(j->fd, &hdr, sizeof(journal_hdr_t));
+  j->level = level;
+  j->max_batch = max_batch;
+  j->count = 0;
+  j->done = FALSE;
+  j->next_lsn = 1;
+  j->recs = malloc_perror(max_batch, sizeof(journal_rec_t));
+  j->spare_recs = malloc_perror(max_batch, sizeof(journal_rec_t));
+  if (level == JOURNAL_SYNC){
+    j->orders = malloc_perror(max_batch, sizeof(order_rec_t));
+    j->spare_orders = malloc_perror(max_batch, sizeof(order_rec_t));
+  }
+  j->durable = durable;
+  j->durable_arg = durable_arg;
+  hist_init(&j->commit_hist);
+  mutex_init_perror(&j->lock);
+  cond_init_perror(&j->cond_nempty);
+  cond_init_perror(&j->cond_nfull);
+  thread_create_perror(&j->flusher, flusher_thread, j);
+}
+
+void journal_append(journal_t *j, journal_rec_t *jrec, const order_rec_t *rec){
+  mutex_lock_perror(&j->lock);
+  if (j->count == j->max_batch) j->num_blocked++;
+  while (j->count == j->max_batch){
+    j->num_wait_nfull++;
+    cond_wait_perror(&j->cond_nfull, &j->lock);
+    j->num_wait_nfull--;
+  }
+  jrec->lsn = j->next_lsn++;
+  j->recs[j->count] = *jrec;
+  if (j->level == JOURNAL_SYNC) j->orders[j->count] = *rec;
+  j->count++;
+  if (j->num_wait_nempty > 0) cond_signal_perror(&j->cond_nempty);
+  mutex_unlock_perror(&j->lock);
+}
+
+void journal_close_perror(journal_t *j){
+  mutex_lock_perror(&j->lock);
+  j->done = TRUE;
+  if (j->num_wait_nempty > 0) cond_signal_perror(&j->cond_nempty);
+  mutex_unlock_perror(&j->lock);
+  thread_join_perror(j->flusher, NULL);
+  if (close(j->fd) != 0){
+    perror("journal close failed");
+    exit(EXIT_FAILURE);
+  }
+  j->fd = -1;
+}
+
+void journal_free(journal_t *j){
+  free(j->recs);
+  free(j->spare_recs);
+  free(j->orders);
+  free(j->spare_orders);
+  hist_free(&j->commit_hist);
+  j->recs = NULL;
+  j->spare_recs = NULL;
+  j->orders = NULL;
+  j->spare_orders = NULL;
+}
+
+const char *journal_level_name(durability_t level){
+  return C_LEVEL_NAMES[level];
+}
@@ -0,0 +1,136 @@
+/**
+   journal.h
+
+   Declarations of an append-only write-ahead journal of the market
+   updates of the bound-buf benchmark, with group commit.
+
+   Traders append a fixed-size record for each applied order into a
+   shared buffer of up to max_batch records, and a flusher thread swaps
+   the buffer with a spare buffer, writes the records of the swapped
+   buffer with one write, and commits them with one fdatasync, while
+   traders append into the other buffer. The records that were appended
+   during a commit form the next commit, so that the number of records
+   per fdatasync grows with the load instead of one fdatasync per order.
+
+   Durability levels:
+   JOURNAL_WRITE : records are written to the file without fdatasync, and
+                   survive a process exit but not a system crash
+   JOURNAL_ASYNC : records are committed with fdatasync, and orders are
+                   fulfilled before their commit, so that the orders of
+                   the last commits may be lost on a system crash
+   JOURNAL_SYNC  : records are committed with fdatasync, and the flusher
+                   calls the durable function of the journal for the
+                   order of each record after its commit, so that an
+                   order is fulfilled only after it is durable
+
+   The file starts with a header, followed by the records in the order of
+   their log sequence numbers (LSN). The records of a stock are in the
+   order in which they were applied, if they are appended under the lock
+   of the stock.
+*/
+
+#ifndef JOURNAL_H
+#define JOURNAL_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include "bound-buf.h"
+#include "utilities-hist.h"
+
+#define JOURNAL_MAGIC "BBJRNL1" /* 8 bytes with the terminating null */
+
+typedef enum{JOURNAL_WRITE, JOURNAL_ASYNC, JOURNAL_SYNC} durability_t;
+
+typedef struct{
+  char magic[8];
+  uint32_t rec_size; /* sizeof(journal_rec_t) */
+  uint32_t num_stocks;
+} journal_hdr_t;
+
+typedef struct{
+  uint64_t lsn; /* from 1 */
+  int32_t stock_id;
+  int32_t quantity;
+  int32_t action;
+  int32_t client_id;
+  int32_t stock_quantity; /* quantity of the stock after the update */
+  int32_t pad;
+} journal_rec_t;
+
+typedef struct{
+  int fd;
+  durability_t level;
+  int max_batch; /* records per buffer */
+  int count; /* records in the active buffer */
+  boolean_t done;
+  uint64_t next_lsn;
+  journal_rec_t *recs; /* active buffer */
+  journal_rec_t *spare_recs; /* buffer of the flusher */
+  order_rec_t *orders; /* orders of the active buffer, JOURNAL_SYNC only */
+  order_rec_t *spare_orders;
+  void (*durable)(void *arg, const order_rec_t *rec, uint64_t now_ns);
+  void *durable_arg;
+  pthread_mutex_t lock;
+  pthread_cond_t cond_nempty; /* the flusher waits for records */
+  pthread_cond_t cond_nfull; /* traders wait for a swap of the buffer */
+  int num_wait_nempty;
+  int num_wait_nfull;
+  pthread_t flusher;
+  /* written by the flusher; read after journal_close */
+  unsigned long num_commits; /* writes of a batch */
+  unsigned long num_fsyncs;
+  unsigned long num_recs;
+  int max_commit; /* records */
+  hist_t commit_hist; /* write and fdatasync of a batch, ns */
+  /* written under lock */
+  unsigned long num_blocked; /* appends blocked on a full buffer */
+} journal_t;
+
+/**
+   Parse a journal configuration "<path>[:write|async|sync[:<max-batch>]]"
+   into a path of at most path_size bytes, a durability level, and the
+   maximal records per commit. Returns 0 on success and -1 on invalid
+   input.
+*/
+int journal_parse(char *path,
+		  size_t path_size,
+		  durability_t *level,
+		  int *max_batch,
+		  const char *s);
+
+/**
+   Create or truncate the journal file at path, write the header, and
+   start the flusher thread. durable is called by the flusher for each
+   committed order at the JOURNAL_SYNC level, and is NULL otherwise.
+*/
+void journal_open_perror(journal_t *j,
+			 const char *path,
+			 durability_t level,
+			 int max_batch,
+			 int num_stocks,
+			 void (*durable)(void *arg,
+					 const order_rec_t *rec,
+					 uint64_t now_ns),
+			 void *durable_arg);
+
+/**
+   Append a record with the next LSN, and, at the JOURNAL_SYNC level, the
+   order whose completion waits for the commit of the record. Blocks while
+   the buffer is full.
+*/
+void journal_append(journal_t *j, journal_rec_t *jrec, const order_rec_t *rec);
+
+/**
+   Stop the flusher after it commits the remaining records, and close the
+   file. Called after all appending threads returned.
+*/
+void journal_close_perror(journal_t *j);
+
+/**
+   Free the buffers and the statistics. The journal struct is not freed.
+*/
+void journal_free(journal_t *j);
+
+const char *journal_level_name(durability_t level);
+
+#endif
@@ -0,0 +1,104 @@
+/**
+   market-file.c
+
+   A program for creating and inspecting the memory-mapped market files
+   of bound-buf (market-map.h).
+
+   create  : creates a file for a number of stocks with an initial
+             quantity each (5000 by default), e.g. for a first run
+   inspect : prints the header, whether the last run closed the file
+             cleanly, the total, minimal, and maximal quantity, the number
+             of empty stocks, and the quantities of count stocks from a
+             first stock id (10 from 0 by default)
+
+   usage examples:
+   ./market-file create /tmp/market.bb 50000
+   ./market-file create /tmp/market.bb 50000 1000
+   ./bound-buf -b latch -c 3 -t 3 -q 16 -s 50000 -o 100000 -m /tmp/market.bb
+   ./market-file inspect /tmp/market.bb
+   ./market-file inspect /tmp/market.bb 100 20
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "market-map.h"
+
+const int C_DEF_QUANTITY = 5000;
+const int C_DEF_NUM_PRINT = 10;
+
+const char *C_USAGE =
+  "market-file create path number-stocks [quantity]\n"
+  "market-file inspect path [first-stock [count]]\n";
+
+/**
+   Parses an int that spans the whole string s. Returns 0 on success and
+   -1 on invalid input.
+*/
+int parse_int(const char *s, int *n){
+  char *end = NULL;
+  long l;
+  if (*s == '\0') return -1;
+  l = strtol(s, &end, 10);
+  if (*end != '\0' || l < 0 || l > 2147483647L) return -1;
+  *n = l;
+  return 0;
+}
+
+void market_inspect(const market_map_t *mm, int first, int count){
+  int i;
+  int min_q, max_q;
+  int num_empty = 0;
+  long total = 0;
+  const market_map_hdr_t *hdr = mm->hdr;
+  min_q = (hdr->num_stocks > 0) ? mm->quantities[0] : 0;
+  max_q = min_q;
+  for (i = 0; i < (int)hdr->num_stocks; i++){
+    total += mm->quantities[i];
+    if (mm->quantities[i] < min_q) min_q = mm->quantities[i];
+    if (mm->quantities[i] > max_q) max_q = mm->quantities[i];
+    if (mm->quantities[i] == 0) num_empty++;
+  }
+  printf("version: %u, stocks: %u, size: %lu bytes, opened by %u runs, %s\n",
+	 (unsigned)hdr->version,
+	 (unsigned)hdr->num_stocks,
+	 (unsigned long)hdr->size,
+	 (unsigned)hdr->num_opens,
+	 (hdr->state == MARKET_MAP_OPEN) ?
+	 "not closed cleanly by the last run" : "closed cleanly");
+  printf("quantity: total %ld, min %d, max %d, %d empty stocks\n",
+	 total, min_q, max_q, num_empty);
+  for (i = first; i - first < count && i < (int)hdr->num_stocks; i++){
+    printf("stock: %d, quantity: %d\n", i, mm->quantities[i]);
+  }
+}
+
+int main(int argc, char **argv){
+  int num_stocks;
+  int quantity = C_DEF_QUANTITY;
+  int first = 0;
+  int count = C_DEF_NUM_PRINT;
+  market_map_t mm;
+  if (argc >= 4 && argc <= 5 && strcmp(argv[1], "create") == 0){
+    if (parse_int(argv[3], &num_stocks) != 0 || num_stocks < 1 ||
+	(argc == 5 && parse_int(argv[4], &quantity) != 0)){
+      fprintf(stderr,"number of stocks must be > 0 and quantity >= 0\n");
+      exit(EXIT_FAILURE);
+    }
+    market_map_create_perror(&mm, argv[2], num_stocks, quantity);
+    market_inspect(&mm, 0, 0);
+  }else if (argc >= 3 && argc <= 5 && strcmp(argv[1], "inspect") == 0){
+    if ((argc >= 4 && parse_int(argv[3], &first) != 0) ||
+	(argc == 5 && parse_int(argv[4], &count) != 0)){
+      fprintf(stderr,"first stock and count must be >= 0\n");
+      exit(EXIT_FAILURE);
+    }
+    market_map_open_perror(&mm, argv[2]);
+    market_inspect(&mm, first, count);
+  }else{
+    fprintf(stderr,"usage:\n%s", C_USAGE);
+    exit(EXIT_FAILURE);
+  }
+  market_map_close_perror(&mm);
+  return 0;
+}
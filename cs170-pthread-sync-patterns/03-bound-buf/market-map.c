@@ -0,0 +1,120 @@
+/**
+   market-map.c
+
+   A memory-mapped market file for the bound-buf benchmark. A file is
+   created with ftruncate, which allocates zeroed pages without writing
+   them, and the quantities are then written through the mapping. The
+   header is validated against the size of the file before the
+   quantities are referred to.
+*/
+
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "market-map.h"
+
+/**
+   Returns the size of a file for num_stocks stocks.
+*/
+static size_t map_size(int num_stocks){
+  return sizeof(market_map_hdr_t) + (size_t)num_stocks * sizeof(int);
+}
+
+/**
+   Maps size bytes of the open file of mm, shared and writable.
+*/
+static void map_perror(market_map_t *mm, size_t size){
+  void *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, mm->fd, 0);
+  if (p == MAP_FAILED){
+    perror("market file mmap failed");
+    exit(EXIT_FAILURE);
+  }
+  mm->size = size;
+  mm->hdr = p;
+  mm->quantities = (int *)((char *)p + sizeof(market_map_hdr_t));
+}
+
+void market_map_create_perror(market_map_t *mm,
+			      const char *path,
+			      int num_stocks,
+			      int quantity){
+  int i;
+  size_t size = map_size(num_stocks);
+  mm->fd = open(path, O_RDWR | O_CREAT | O_EXCL, 0644);
+  if (mm->fd < 0){
+    perror("market file create failed");
+    exit(EXIT_FAILURE);
+  }
+  if (ftruncate(mm->fd, size) != 0){
+    perror("market file ftruncate failed");
+    exit(EXIT_FAILURE);
+  }
+  map_perror(mm, size);
+  memcpy(mm->hdr->magic, MARKET_MAP_MAGIC, sizeof(mm->hdr->magic));
+  mm->hdr->version = MARKET_MAP_VERSION;
+  mm->hdr->num_stocks = num_stocks;
+  mm->hdr->state = MARKET_MAP_CLOSED;
+  mm->hdr->num_opens = 0;
+  mm->hdr->size = size;
+  for (i = 0; i < num_stocks; i++){
+    mm->quantities[i] = quantity;
+  }
+}
+
+void market_map_open_perror(market_map_t *mm, const char *path){
+  struct stat st;
+  market_map_hdr_t hdr;
+  mm->fd = open(path, O_RDWR);
+  if (mm->fd < 0){
+    perror("market file open failed");
+    exit(EXIT_FAILURE);
+  }
+  if (fstat(mm->fd, &st) != 0){
+    perror("market file fstat failed");
+    exit(EXIT_FAILURE);
+  }
+  /* validate the header before mapping the quantities */
+  if ((size_t)st.st_size < sizeof(market_map_hdr_t) ||
+      pread(mm->fd, &hdr, sizeof(market_map_hdr_t), 0) !=
+      (ssize_t)sizeof(market_map_hdr_t) ||
+      memcmp(hdr.magic, MARKET_MAP_MAGIC, sizeof(hdr.magic)) != 0){
+    fprintf(stderr, "%s is not a market file\n", path);
+    exit(EXIT_FAILURE);
+  }
+  if (hdr.version != MARKET_MAP_VERSION){
+    fprintf(stderr, "%s has version %u instead of %u\n",
+	    path, (unsigned)hdr.version, (unsigned)MARKET_MAP_VERSION);
+    exit(EXIT_FAILURE);
+  }
+  if (hdr.size != map_size(hdr.num_stocks) ||
+      (uint64_t)st.st_size != hdr.size){
+    fprintf(stderr, "%s is truncated or corrupt\n", path);
+    exit(EXIT_FAILURE);
+  }
+  map_perror(mm, hdr.size);
+}
+
+void market_map_set_state(market_map_t *mm, market_map_state_t state){
+  mm->hdr->state = state;
+  if (state == MARKET_MAP_OPEN) mm->hdr->num_opens++;
+}
+
+void market_map_close_perror(market_map_t *mm){
+  if (munmap(mm->hdr, mm->size) != 0){
+    perror("market file munmap failed");
+    exit(EXIT_FAILURE);
+  }
+  if (close(mm->fd) != 0){
+    perror("market file close failed");
+    exit(EXIT_FAILURE);
+  }
+  mm->fd = -1;
+  mm->hdr = NULL;
+  mm->quantities = NULL;
+}
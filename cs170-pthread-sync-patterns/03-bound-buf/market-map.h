@@ -0,0 +1,70 @@
+/**
+   market-map.h
+
+   Declarations of a memory-mapped market file for the bound-buf
+   benchmark. The file consists of a header with the stock count and the
+   format version, followed by the quantities of the stocks as an array
+   of int. The array is mapped shared, so that the updates of a run are
+   in the file after the run without an explicit write, and a next run
+   maps the file instead of initializing the quantities, with no I/O
+   beyond the page faults of the stocks that it touches.
+
+   The header records whether the file is mapped by a run, so that a
+   file of a run that did not unmap it, e.g. after a crash, is reported as
+   not closed cleanly. The quantities are not synced to the disk, and
+   survive a process exit but not a system crash.
+*/
+
+#ifndef MARKET_MAP_H
+#define MARKET_MAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MARKET_MAP_MAGIC "BBMKT01" /* 8 bytes with the terminating null */
+#define MARKET_MAP_VERSION (1) /* used as uint32_t */
+
+typedef enum{MARKET_MAP_CLOSED, MARKET_MAP_OPEN} market_map_state_t;
+
+typedef struct{
+  char magic[8];
+  uint32_t version;
+  uint32_t num_stocks;
+  uint32_t state; /* market_map_state_t */
+  uint32_t num_opens; /* number of times the file was mapped by a run */
+  uint64_t size; /* of the file in bytes */
+} market_map_hdr_t;
+
+typedef struct{
+  int fd;
+  size_t size;
+  market_map_hdr_t *hdr; /* start of the mapping */
+  int *quantities; /* after the header */
+} market_map_t;
+
+/**
+   Create a file at path, which must not exist, for num_stocks stocks with
+   the given quantity each, and map it.
+*/
+void market_map_create_perror(market_map_t *mm,
+			      const char *path,
+			      int num_stocks,
+			      int quantity);
+
+/**
+   Map an existing file at path. Exits with an error message if the file
+   is not a market file of the current version.
+*/
+void market_map_open_perror(market_map_t *mm, const char *path);
+
+/**
+   Mark a file as mapped by a run, or as closed cleanly.
+*/
+void market_map_set_state(market_map_t *mm, market_map_state_t state);
+
+/**
+   Unmap and close a file.
+*/
+void market_map_close_perror(market_map_t *mm);
+
+#endif
@@ -0,0 +1,95 @@
+/**
+   market.c
+
+   The market of the bound-buf benchmark, with striped locks and
+   copy-on-write snapshots of stripes.
+*/
+
+#define _XOPEN_SOURCE 600
+
+#include <unistd.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "market.h"
+#include "utilities-mem.h"
+#include "utilities-pthread.h"
+
+boolean_t market_init(market_t *m,
+		      int num_stocks,
+		      int quantity,
+		      int num_locks,
+		      const char *map_path){
+  int i;
+  boolean_t warm = FALSE;
+  m->num_stocks = num_stocks;
+  m->num_locks = num_locks;
+  m->map = NULL;
+  if (map_path != NULL){
+    m->map = malloc_perror(1, sizeof(market_map_t));
+    if (access(map_path, F_OK) == 0){
+      market_map_open_perror(m->map, map_path);
+      warm = TRUE;
+    }else{
+      market_map_create_perror(m->map, map_path, num_stocks, quantity);
+    }
+    if (m->map->hdr->num_stocks != (uint32_t)num_stocks){
+      fprintf(stderr,"market file %s has %u stocks instead of %d\n",
+	      map_path, (unsigned)m->map->hdr->num_stocks, num_stocks);
+      exit(EXIT_FAILURE);
+    }
+    market_map_set_state(m->map, MARKET_MAP_OPEN);
+    m->quantities = m->map->quantities;
+  }else{
+    m->quantities = malloc_perror(num_stocks, sizeof(int));
+    for (i = 0; i < num_stocks; i++){
+      m->quantities[i] = quantity;
+    }
+  }
+  m->locks = malloc_perror(num_locks, sizeof(pthread_mutex_t));
+  m->snap_epoch = 0;
+  m->stripe_epochs = calloc_perror(num_locks, sizeof(uint64_t));
+  m->snap_quantities = malloc_perror(num_stocks, sizeof(int));
+  memcpy(m->snap_quantities, m->quantities, num_stocks * sizeof(int));
+  for (i = 0; i < num_locks; i++){
+    mutex_init_perror(&m->locks[i]);
+  }
+  return warm;
+}
+
+void market_free(market_t *m){
+  if (m->map != NULL){
+    market_map_set_state(m->map, MARKET_MAP_CLOSED);
+    market_map_close_perror(m->map);
+    free(m->map);
+    m->map = NULL;
+  }else{
+    free(m->quantities);
+  }
+  free(m->locks);
+  free(m->stripe_epochs);
+  free(m->snap_quantities);
+  m->quantities = NULL;
+  m->locks = NULL;
+  m->stripe_epochs = NULL;
+  m->snap_quantities = NULL;
+}
+
+void market_print(market_t *m){
+  int i;
+  for(i = 0; i < m->num_stocks; i++){
+    printf("stock: %d, quantity: %d\n", i , m->quantities[i]);
+  }
+}
+
+boolean_t market_stripe_copy(market_t *m, int stripe){
+  int i;
+  uint64_t epoch = __atomic_load_n(&m->snap_epoch, __ATOMIC_ACQUIRE);
+  if (m->stripe_epochs[stripe] == epoch) return FALSE;
+  for (i = stripe; i < m->num_stocks; i += m->num_locks){
+    m->snap_quantities[i] = m->quantities[i];
+  }
+  m->stripe_epochs[stripe] = epoch;
+  return TRUE;
+}
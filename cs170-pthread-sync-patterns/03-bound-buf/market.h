@@ -0,0 +1,62 @@
+/**
+   market.h
+
+   Declarations of the market of the bound-buf benchmark, i.e. the
+   quantities of the stocks that traders update under striped locks.
+   Stock i is locked with locks[i % num_locks], i.e. is in stripe
+   i % num_locks.
+
+   A snapshot is a copy of the quantities of all stocks at the time at
+   which snap_epoch is incremented (snapshot.h). Stripes are copied into
+   snap_quantities either by the snapshot thread or, copy-on-write, by the
+   first trader that updates a stripe after the increment, before the
+   update, so that the snapshot thread holds one stripe lock at a time and
+   a trader copies at most one stripe per snapshot.
+
+   The quantities are either allocated and initialized, or mapped from a
+   market file (market-map.h), which is created with the initial
+   quantities if it does not exist.
+*/
+
+#ifndef MARKET_H
+#define MARKET_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include "bound-buf.h"
+#include "market-map.h"
+
+typedef struct market{
+  int num_stocks;
+  int num_locks;
+  int *quantities;
+  pthread_mutex_t *locks;
+  uint64_t snap_epoch; /* of the latest snapshot; 0 if none */
+  uint64_t *stripe_epochs; /* latest copied epoch; under stripe lock */
+  int *snap_quantities; /* the latest snapshot */
+  market_map_t *map; /* NULL if the quantities are not mapped */
+} market_t;
+
+/**
+   Initialize a market, with the quantities mapped from the market file
+   at map_path if map_path is not NULL. Returns TRUE if an existing file
+   was mapped, and FALSE otherwise.
+*/
+boolean_t market_init(market_t *m,
+		      int num_stocks,
+		      int quantity,
+		      int num_locks,
+		      const char *map_path);
+
+void market_free(market_t *m);
+
+void market_print(market_t *m);
+
+/**
+   Copy the quantities of a stripe into the snapshot, if the stripe was
+   not copied since the latest increment of snap_epoch. Requires holding
+   the lock of the stripe. Returns TRUE if the stripe was copied.
+*/
+boolean_t market_stripe_copy(market_t *m, int stripe);
+
+#endif
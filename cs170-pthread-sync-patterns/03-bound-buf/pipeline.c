@@ -0,0 +1,242 @@
+/**
+   pipeline.c
+
+   The order pipeline of the bound-buf benchmark.
+*/
+
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "pipeline.h"
+#include "utilities-mem.h"
+#include "utilities-pthread.h"
+#include "utilities-time.h"
+
+static const char *C_STAGE_NAMES[] = {"validate", "risk", "execute",
+				      "settle"};
+static const long C_RISK_LIMIT = 1000; /* net position, in max quantities */
+
+int pipeline_parse(pipeline_t *p, const char *s){
+  int i;
+  int n = 0;
+  if (sscanf(s, "%d:%d:%d:%d%n",
+	     &p->counts[STAGE_VALIDATE],
+	     &p->counts[STAGE_RISK],
+	     &p->counts[STAGE_EXECUTE],
+	     &p->counts[STAGE_SETTLE],
+	     &n) != NUM_STAGES || s[n] != '\0'){
+    return -1;
+  }
+  p->num_threads = 0;
+  for (i = 0; i < NUM_STAGES; i++){
+    if (p->counts[i] < 1) return -1;
+    p->num_threads += p->counts[i];
+  }
+  return 0;
+}
+
+void pipeline_init(pipeline_t *p,
+		   const backend_t *b,
+		   const queue_conf_t *conf,
+		   void *q,
+		   int num_clients,
+		   int quantity,
+		   trader_arg_t *tas){
+  int i, j, k;
+  queue_conf_t stage_conf;
+  stage_arg_t *sa = NULL;
+  p->b = b;
+  stage_conf = *conf;
+  stage_conf.admit.policy = ADMIT_BLOCK;
+  p->qs[STAGE_VALIDATE] = q;
+  for (k = STAGE_VALIDATE + 1; k < NUM_STAGES; k++){
+    p->qs[k] = b->queue_new(&stage_conf);
+  }
+  p->accounts = malloc_perror(num_clients, sizeof(account_t));
+  for (i = 0; i < num_clients; i++){
+    p->accounts[i].position = 0;
+    p->accounts[i].settled = 0;
+    mutex_init_perror(&p->accounts[i].lock);
+  }
+  p->sas = malloc_perror(p->num_threads, sizeof(stage_arg_t));
+  /* counts[k] threads of stage k, in the order of the stages */
+  for (i = 0, k = 0; k < NUM_STAGES; k++){
+    for (j = 0; j < p->counts[k]; j++, i++){
+      sa = &p->sas[i];
+      sa->ta = &tas[i];
+      sa->ta->q = p->qs[k];
+      sa->stage = k;
+      sa->next_q = (k + 1 < NUM_STAGES) ? p->qs[k + 1] : NULL;
+      sa->accounts = p->accounts;
+      sa->risk_limit = C_RISK_LIMIT * quantity;
+      hist_init(&sa->stage_hist);
+      sa->num_stage_orders = 0;
+      sa->num_stage_rejected = 0;
+      sa->sum_depth = 0;
+      sa->max_depth = 0;
+    }
+  }
+}
+
+/**
+   Returns TRUE if an order refers to a stock of the market with a
+   quantity in [0, maximal quantity], as produced by the workload.
+*/
+static boolean_t stage_validate(stage_arg_t *sa, const order_rec_t *rec){
+  return (rec->stock_id >= 0 && rec->stock_id < sa->ta->w->num_stocks &&
+	  rec->quantity >= 0 && rec->quantity <= sa->ta->w->quantity);
+}
+
+/**
+   Returns TRUE and updates the net position of the client of an order if
+   the position stays within the risk limit, and FALSE otherwise.
+*/
+static boolean_t stage_risk(stage_arg_t *sa, const order_rec_t *rec){
+  long position;
+  account_t *a = &sa->accounts[rec->client_id];
+  mutex_lock_perror(&a->lock);
+  position = a->position +
+    ((rec->action == BUY) ? rec->quantity : -rec->quantity);
+  if (labs(position) > sa->risk_limit){
+    mutex_unlock_perror(&a->lock);
+    return FALSE;
+  }
+  a->position = position;
+  mutex_unlock_perror(&a->lock);
+  return TRUE;
+}
+
+/**
+   Reverses the update of the net position of the client of an order that
+   passed the risk check and is dropped before it is executed.
+*/
+static void stage_risk_undo(stage_arg_t *sa, const order_rec_t *rec){
+  account_t *a = &sa->accounts[rec->client_id];
+  mutex_lock_perror(&a->lock);
+  a->position -= (rec->action == BUY) ? rec->quantity : -rec->quantity;
+  mutex_unlock_perror(&a->lock);
+}
+
+/**
+   Settles an executed order on the account of its client.
+*/
+static void stage_settle(stage_arg_t *sa, const order_rec_t *rec){
+  account_t *a = &sa->accounts[rec->client_id];
+  mutex_lock_perror(&a->lock);
+  a->settled += rec->quantity;
+  mutex_unlock_perror(&a->lock);
+}
+
+void *stage_thread(void *arg){
+  int depth;
+  boolean_t pass;
+  uint64_t now_ns;
+  order_rec_t rec;
+  stage_arg_t *sa = arg;
+  trader_arg_t *ta = sa->ta;
+  while (ta->b->queue_dequeue(ta->q, &rec)){
+    depth = ta->b->queue_length(ta->q);
+    sa->sum_depth += depth;
+    if (depth > sa->max_depth) sa->max_depth = depth;
+    if (!trader_claim(ta, &rec)){
+      /* dropped after it passed risk; execution clears the deadline */
+      if (sa->stage > STAGE_RISK) stage_risk_undo(sa, &rec);
+      continue;
+    }
+    pass = TRUE;
+    switch (sa->stage){
+    case STAGE_VALIDATE:
+      pass = stage_validate(sa, &rec);
+      rec.stage_ns = rec.start_ns; /* queued by the client */
+      break;
+    case STAGE_RISK:
+      pass = stage_risk(sa, &rec);
+      break;
+    case STAGE_EXECUTE:
+      trader_execute(ta, &rec);
+      break;
+    default:
+      stage_settle(sa, &rec);
+    }
+    now_ns = time_mono_ns_perror();
+    hist_add(&sa->stage_hist, now_ns - rec.stage_ns);
+    sa->num_stage_orders++;
+    if (!pass){
+      sa->num_stage_rejected++;
+      trader_reject(ta, &rec, now_ns);
+    }else if (sa->next_q != NULL){
+      /* published to the next stage by its queue, which rejects an order
+	 only if it is still full at the deadline of the order */
+      rec.order->stage_ns = now_ns;
+      if (sa->stage == STAGE_EXECUTE) rec.order->deadline_ns = 0;
+      if (!ta->b->queue_enqueue(sa->next_q, rec.order)){
+	if (sa->stage >= STAGE_RISK) stage_risk_undo(sa, &rec);
+	trader_expire(ta, rec.order);
+      }
+    }else{
+      trader_fulfill(ta, &rec, now_ns);
+      trader_publish(ta, &rec, now_ns);
+    }
+  }
+  return NULL;
+}
+
+void pipeline_done(pipeline_t *p){
+  int k;
+  for (k = 0; k < NUM_STAGES; k++){
+    p->b->queue_done(p->qs[k]);
+  }
+}
+
+void pipeline_print(const pipeline_t *p, double sec){
+  int i, j, k;
+  int max_depth;
+  unsigned long num_orders, num_rejected, sum_depth;
+  hist_t hist;
+  for (i = 0, k = 0; k < NUM_STAGES; k++){
+    /* threads of stage k are at [i, i + counts[k]) */
+    num_orders = 0;
+    num_rejected = 0;
+    sum_depth = 0;
+    max_depth = 0;
+    hist_init(&hist);
+    for (j = 0; j < p->counts[k]; j++, i++){
+      num_orders += p->sas[i].num_stage_orders;
+      num_rejected += p->sas[i].num_stage_rejected;
+      sum_depth += p->sas[i].sum_depth;
+      if (p->sas[i].max_depth > max_depth) max_depth = p->sas[i].max_depth;
+      hist_merge(&hist, &p->sas[i].stage_hist);
+    }
+    printf("stage %s: %d threads, %f orders / sec, %lu rejected, "
+	   "depth mean %.2f max %d, latency (ns): p50 %lu, p99 %lu, "
+	   "max %lu\n",
+	   C_STAGE_NAMES[k],
+	   p->counts[k],
+	   num_orders / sec,
+	   num_rejected,
+	   (num_orders > 0) ? (double)sum_depth / num_orders : 0.0,
+	   max_depth,
+	   (unsigned long)hist_quantile(&hist, 0.5),
+	   (unsigned long)hist_quantile(&hist, 0.99),
+	   (unsigned long)hist.max);
+    hist_free(&hist);
+  }
+}
+
+void pipeline_free(pipeline_t *p){
+  int i, k;
+  for (i = 0; i < p->num_threads; i++){
+    hist_free(&p->sas[i].stage_hist);
+  }
+  for (k = STAGE_VALIDATE + 1; k < NUM_STAGES; k++){
+    p->b->queue_free(p->qs[k]);
+    p->qs[k] = NULL;
+  }
+  free(p->accounts);
+  free(p->sas);
+  p->accounts = NULL;
+  p->sas = NULL;
+}
@@ -0,0 +1,115 @@
+/**
+   pipeline.h
+
+   Declarations of the order pipeline of the bound-buf benchmark, in
+   which stage threads replace the traders. Each stage has an input queue
+   and threads, and passes an order to the input queue of the next stage:
+
+   validate : an order refers to a stock of the market with a quantity in
+              [0, maximal quantity]
+   risk     : the net position of the client stays within the risk limit
+   execute  : the order is executed on the market (trader.h)
+   settle   : the order is settled on the account of its client
+
+   An order that fails validation or the risk check is completed without
+   execution, and its client counts it as rejected, as an order that is
+   rejected by the admission policy, without a latency. The input queue
+   of the validate stage is the queue of the clients, and the other
+   queues block at capacity, so that an order that was admitted by the
+   pipeline is not rejected later, except at its deadline.
+*/
+
+#ifndef PIPELINE_H
+#define PIPELINE_H
+
+#include <pthread.h>
+#include "bound-buf.h"
+#include "trader.h"
+#include "utilities-hist.h"
+
+typedef enum{STAGE_VALIDATE,
+	     STAGE_RISK,
+	     STAGE_EXECUTE,
+	     STAGE_SETTLE,
+	     NUM_STAGES} stage_t;
+
+/**
+   Account of a client, for the risk and settle stages.
+*/
+typedef struct{
+  long position; /* net quantity bought in orders past risk, unless dropped */
+  long settled; /* quantity of settled orders */
+  pthread_mutex_t lock;
+} account_t;
+
+typedef struct{
+  trader_arg_t *ta; /* of the stage thread; ta->q is the input queue */
+  stage_t stage;
+  void *next_q; /* input queue of the next stage; NULL if last stage */
+  account_t *accounts; /* per client */
+  long risk_limit;
+  hist_t stage_hist; /* from queuing at the stage to the end of it, ns */
+  unsigned long num_stage_orders;
+  unsigned long num_stage_rejected;
+  unsigned long sum_depth; /* input queue length after a dequeue */
+  int max_depth;
+} stage_arg_t;
+
+typedef struct{
+  int counts[NUM_STAGES]; /* threads per stage */
+  int num_threads; /* 0 if no pipeline */
+  const backend_t *b;
+  void *qs[NUM_STAGES]; /* qs[STAGE_VALIDATE] is of the clients */
+  account_t *accounts; /* per client */
+  stage_arg_t *sas; /* of num_threads stage threads */
+} pipeline_t;
+
+/**
+   Parse the thread counts of the stages
+   "<validate>:<risk>:<execute>:<settle>" into an otherwise zeroed
+   pipeline. Returns 0 on success and -1 on invalid input.
+*/
+int pipeline_parse(pipeline_t *p, const char *s);
+
+/**
+   Initialize a pipeline with q as the input queue of the validate stage,
+   and the input queues of the other stages with the configuration of q.
+   The trader arguments tas of num_threads stage threads are assigned to
+   the stages in the order of the stages, and their queues are set.
+*/
+void pipeline_init(pipeline_t *p,
+		   const backend_t *b,
+		   const queue_conf_t *conf,
+		   void *q,
+		   int num_clients,
+		   int quantity,
+		   trader_arg_t *tas);
+
+/**
+   Dequeue orders from the input queue of a stage, as long as there are
+   orders, and queue each processed order at the next stage, or inform
+   the client after the last stage or a rejection. The time at the stage
+   and the input queue length are recorded. An order expires at the
+   stages before settlement, and a traded order is settled regardless of
+   its deadline. The argument is a stage argument of the pipeline.
+*/
+void *stage_thread(void *arg);
+
+/**
+   Set the queues of all stages done, after all orders were fulfilled.
+*/
+void pipeline_done(pipeline_t *p);
+
+/**
+   Print the throughput, rejections, queue depth, and latency of each
+   stage over sec seconds.
+*/
+void pipeline_print(const pipeline_t *p, double sec);
+
+/**
+   Free the stage queues and state of a pipeline. The queue of the
+   validate stage is freed by the caller.
+*/
+void pipeline_free(pipeline_t *p);
+
+#endif
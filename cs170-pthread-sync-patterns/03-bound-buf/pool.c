@@ -0,0 +1,176 @@
+/**
+   pool.c
+
+   An elastic pool of worker threads of the bound-buf benchmark, which is
+   resized by a supervisor thread according to the queue occupancy.
+*/
+
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "pool.h"
+#include "utilities-mem.h"
+#include "utilities-pthread.h"
+#include "utilities-time.h"
+
+static const uint64_t C_DEF_POOL_PERIOD_NS = 1000000;
+static const double C_POOL_HIGH = 0.5; /* queue occupancy for a scale-up */
+static const double C_POOL_LOW = 0.1; /* queue occupancy for a scale-down */
+static const double C_POOL_BUSY_LOW = 0.5; /* busy share for a scale-down */
+static const int C_POOL_DOWN_SAMPLES = 10; /* low samples in a row */
+
+int pool_parse(int *num_min, uint64_t *period_ns, const char *s){
+  int n = 0;
+  long period = (long)C_DEF_POOL_PERIOD_NS;
+  if (sscanf(s, "%d%n", num_min, &n) != 1) return -1;
+  if (s[n] == ':'){
+    s += n;
+    if (sscanf(s, ":%ld%n", &period, &n) != 1) return -1;
+  }
+  if (s[n] != '\0' || *num_min < 1 || period < 1) return -1;
+  *period_ns = period;
+  return 0;
+}
+
+void pool_init(pool_t *p, int num_min, int num_max, uint64_t period_ns){
+  memset(p, 0, sizeof(pool_t));
+  p->num_min = num_min;
+  p->num_max = num_max;
+  p->num_active = num_min;
+  p->num_spawned = num_min;
+  p->done = FALSE;
+  p->period_ns = period_ns;
+  mutex_init_perror(&p->lock);
+  cond_init_perror(&p->cond_active);
+  p->busy = malloc_align_perror(POOL_CACHE_LINE, num_max,
+				sizeof(pool_busy_t));
+  memset(p->busy, 0, num_max * sizeof(pool_busy_t));
+}
+
+void pool_free(pool_t *p){
+  free(p->busy);
+  p->busy = NULL;
+}
+
+/**
+   Sets the number of active workers, spawns the worker with id
+   num_spawned if a scale-up exceeds the spawned workers, and unparks the
+   workers. Returns without a change if the pool is done.
+*/
+static void pool_set_active(pool_t *p, int num_active){
+  mutex_lock_perror(&p->lock);
+  if (!p->done){
+    if (num_active > p->num_spawned){
+      thread_create_perror(&p->tids[p->num_spawned],
+			   p->worker,
+			   p->args + p->num_spawned * p->arg_size);
+      p->num_spawned++;
+    }
+    __atomic_store_n(&p->num_active, num_active, __ATOMIC_RELAXED);
+    cond_broadcast_perror(&p->cond_active);
+  }
+  mutex_unlock_perror(&p->lock);
+}
+
+/**
+   Samples the queue occupancy, i.e. the queue length relative to the
+   queue count, and the busy share of the active workers every period_ns.
+   Activates a worker if the occupancy is at least C_POOL_HIGH, and
+   retires the worker with the largest id if the occupancy is at most
+   C_POOL_LOW and the busy share is below C_POOL_BUSY_LOW for
+   C_POOL_DOWN_SAMPLES samples in a row, so that a burst is absorbed
+   within one period and a worker is not retired between the bursts of a
+   fluctuating load.
+*/
+static void *supervisor_thread(void *arg){
+  int i, n;
+  int num_low = 0;
+  double occupancy, busy;
+  uint64_t busy_ns;
+  uint64_t prev_busy_ns = 0;
+  pool_t *p = arg;
+  while (!__atomic_load_n(&p->done, __ATOMIC_RELAXED)){
+    time_wait_until_ns_perror(time_mono_ns_perror() + p->period_ns, 0);
+    n = p->num_active; /* only written by this thread */
+    busy_ns = 0;
+    for (i = 0; i < p->num_spawned; i++){
+      busy_ns += __atomic_load_n(&p->busy[i].ns, __ATOMIC_RELAXED);
+    }
+    occupancy = (double)p->b->queue_length(p->q) / p->queue_count;
+    busy = (double)(busy_ns - prev_busy_ns) / ((double)p->period_ns * n);
+    prev_busy_ns = busy_ns;
+    p->num_samples++;
+    p->sum_active += n;
+    if (occupancy >= C_POOL_HIGH && n < p->num_max){
+      pool_set_active(p, n + 1);
+      p->num_ups++;
+      num_low = 0;
+    }else if (occupancy <= C_POOL_LOW && busy < C_POOL_BUSY_LOW &&
+	      n > p->num_min){
+      num_low++;
+      if (num_low == C_POOL_DOWN_SAMPLES){
+	pool_set_active(p, n - 1);
+	p->num_downs++;
+	num_low = 0;
+      }
+    }else{
+      num_low = 0;
+    }
+  }
+  return NULL;
+}
+
+void pool_start(pool_t *p,
+		const backend_t *b,
+		void *q,
+		int queue_count,
+		void *(*worker)(void *),
+		void *args,
+		size_t arg_size,
+		pthread_t *tids){
+  p->b = b;
+  p->q = q;
+  p->queue_count = queue_count;
+  p->worker = worker;
+  p->args = args;
+  p->arg_size = arg_size;
+  p->tids = tids;
+  thread_create_perror(&p->sid, supervisor_thread, p);
+}
+
+boolean_t pool_wait_active(pool_t *p, int id){
+  boolean_t active;
+  if (id < __atomic_load_n(&p->num_active, __ATOMIC_RELAXED)) return TRUE;
+  mutex_lock_perror(&p->lock);
+  if (id >= p->num_active && !p->done) p->num_parks++;
+  while (id >= p->num_active && !p->done){
+    cond_wait_perror(&p->cond_active, &p->lock);
+  }
+  active = !p->done;
+  mutex_unlock_perror(&p->lock);
+  return active;
+}
+
+void pool_busy_add(pool_t *p, int id, uint64_t ns){
+  __atomic_store_n(&p->busy[id].ns, p->busy[id].ns + ns, __ATOMIC_RELAXED);
+}
+
+void pool_done(pool_t *p){
+  mutex_lock_perror(&p->lock);
+  __atomic_store_n(&p->done, TRUE, __ATOMIC_RELAXED);
+  cond_broadcast_perror(&p->cond_active);
+  mutex_unlock_perror(&p->lock);
+  thread_join_perror(p->sid, NULL);
+}
+
+void pool_print(const pool_t *p){
+  printf("pool: %d to %d traders, %d spawned, mean active %.2f, "
+	 "%lu scale-ups, %lu scale-downs, %lu parks\n",
+	 p->num_min, p->num_max, p->num_spawned,
+	 (p->num_samples > 0) ?
+	 (double)p->sum_active / p->num_samples : p->num_min,
+	 p->num_ups, p->num_downs, p->num_parks);
+}
@@ -0,0 +1,104 @@
+/**
+   pool.h
+
+   Declarations of an elastic pool of worker threads of the bound-buf
+   benchmark, e.g. traders, that is resized by a supervisor thread.
+
+   Workers with an id below num_active dequeue orders, and the other
+   spawned workers are parked on cond_active instead of exiting, so that
+   a scale-up unparks a thread if there is one. num_active is changed only
+   by the supervisor, between num_min and num_max. The supervisor samples
+   the occupancy of the queue and the busy share of the active workers,
+   and spawns a worker beyond the spawned workers on a scale-up.
+*/
+
+#ifndef POOL_H
+#define POOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "bound-buf.h"
+
+#define POOL_CACHE_LINE (64) /* used as int */
+
+typedef struct{
+  uint64_t ns; /* written by the worker; read atomically by supervisor */
+  char pad[POOL_CACHE_LINE - sizeof(uint64_t)];
+} pool_busy_t;
+
+typedef struct{
+  int num_min;
+  int num_max;
+  int num_active; /* written under lock; read atomically by workers */
+  int num_spawned; /* written by the supervisor under lock */
+  boolean_t done; /* written under lock; read atomically by supervisor */
+  uint64_t period_ns; /* sampling period of the supervisor */
+  pthread_mutex_t lock;
+  pthread_cond_t cond_active;
+  pool_busy_t *busy; /* of num_max workers */
+  int queue_count;
+  const backend_t *b;
+  void *q; /* sampled by the supervisor */
+  void *(*worker)(void *);
+  char *args; /* of num_max workers, arg_size bytes each */
+  size_t arg_size;
+  pthread_t *tids; /* of num_max workers */
+  pthread_t sid;
+  unsigned long num_ups;
+  unsigned long num_downs;
+  unsigned long num_parks;
+  unsigned long num_samples;
+  unsigned long sum_active; /* over samples */
+} pool_t;
+
+/**
+   Parse an elastic pool "<min-workers>[:<period-ns>]". Returns 0 on
+   success and -1 on invalid input.
+*/
+int pool_parse(int *num_min, uint64_t *period_ns, const char *s);
+
+/**
+   Initialize a pool with num_min active workers, which are spawned by
+   the caller, and free the pool after it is done.
+*/
+
+void pool_init(pool_t *p, int num_min, int num_max, uint64_t period_ns);
+
+void pool_free(pool_t *p);
+
+/**
+   Start the supervisor of a pool, which spawns the worker with id i as
+   worker(args + i * arg_size) in tids[i] on demand. q is of queue_count
+   orders.
+*/
+void pool_start(pool_t *p,
+		const backend_t *b,
+		void *q,
+		int queue_count,
+		void *(*worker)(void *),
+		void *args,
+		size_t arg_size,
+		pthread_t *tids);
+
+/**
+   Park a worker while its id is not below the number of active workers.
+   Returns FALSE if the pool is done, and TRUE otherwise.
+*/
+boolean_t pool_wait_active(pool_t *p, int id);
+
+/**
+   Add busy time of a worker, i.e. the time of processing an order.
+*/
+void pool_busy_add(pool_t *p, int id, uint64_t ns);
+
+/**
+   Set a pool done, unpark the parked workers for exiting, and join the
+   supervisor. No worker is spawned afterwards, and the workers are
+   joined by the caller.
+*/
+void pool_done(pool_t *p);
+
+void pool_print(const pool_t *p);
+
+#endif
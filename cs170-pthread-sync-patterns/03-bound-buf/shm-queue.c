@@ -0,0 +1,411 @@
+/**
+   shm-queue.c
+
+   A bounded order queue and a market in a POSIX shared memory segment for
+   the bound-buf benchmark. The queue is the condition variable queue of
+   bound-buf-condvar2.c, with client ids in the ring instead of order
+   pointers, and the completion of an order is the condition variable
+   completion of the condvar2 backend, in the record of its client.
+
+   The magic of a segment is written last by the creator, after all locks
+   and condition variables are initialized, so that a process that opens
+   the segment during its creation exits with an error message instead of
+   referring to an uninitialized lock.
+*/
+
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "shm-queue.h"
+#include "utilities-pthread.h"
+#include "utilities-time.h"
+
+static const size_t C_CACHE_LINE = 64;
+static const uint64_t C_CRASH_POLL_NS = 100000000; /* 100 ms */
+
+static size_t align_up(size_t n){
+  return (n + C_CACHE_LINE - 1) / C_CACHE_LINE * C_CACHE_LINE;
+}
+
+/**
+   Sets the offsets in a header and returns the size of a segment.
+*/
+static size_t layout(shmq_hdr_t *hdr){
+  size_t off = align_up(sizeof(shmq_hdr_t));
+  hdr->ring_off = off;
+  off = align_up(off + (size_t)hdr->count * sizeof(int));
+  hdr->clients_off = off;
+  off = align_up(off + (size_t)hdr->num_clients * sizeof(shmq_client_t));
+  hdr->locks_off = off;
+  off = align_up(off + (size_t)hdr->num_locks * sizeof(pthread_mutex_t));
+  hdr->quantities_off = off;
+  return align_up(off + (size_t)hdr->num_stocks * sizeof(int));
+}
+
+/**
+   Maps size bytes of the open segment of s, shared and writable.
+*/
+static void map_perror(shmq_t *s, size_t size){
+  char *p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, s->fd, 0);
+  if (p == MAP_FAILED){
+    perror("shared memory mmap failed");
+    exit(EXIT_FAILURE);
+  }
+  s->size = size;
+  s->hdr = (shmq_hdr_t *)p;
+}
+
+static void map_arrays(shmq_t *s){
+  char *p = (char *)s->hdr;
+  s->ring = (int *)(p + s->hdr->ring_off);
+  s->clients = (shmq_client_t *)(p + s->hdr->clients_off);
+  s->locks = (pthread_mutex_t *)(p + s->hdr->locks_off);
+  s->quantities = (int *)(p + s->hdr->quantities_off);
+}
+
+void shmq_create_perror(shmq_t *s,
+			const char *name,
+			int count,
+			int num_clients,
+			int num_stocks,
+			int quantity,
+			int num_locks){
+  int i;
+  size_t size;
+  shmq_hdr_t hdr;
+  memset(&hdr, 0, sizeof(shmq_hdr_t));
+  hdr.count = count + 1; /* + 1 due to fifo queue implementation */
+  hdr.num_clients = num_clients;
+  hdr.num_stocks = num_stocks;
+  hdr.quantity = quantity;
+  hdr.num_locks = num_locks;
+  size = layout(&hdr);
+  s->fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (s->fd < 0){
+    perror("shm_open create failed");
+    exit(EXIT_FAILURE);
+  }
+  if (ftruncate(s->fd, size) != 0){
+    perror("shared memory ftruncate failed");
+    exit(EXIT_FAILURE);
+  }
+  map_perror(s, size); /* zeroed pages */
+  memcpy(s->hdr, &hdr, sizeof(shmq_hdr_t));
+  s->hdr->version = SHMQ_VERSION;
+  s->hdr->size = size;
+  map_arrays(s);
+  mutex_init_pshared_perror(&s->hdr->lock);
+  cond_init_pshared_perror(&s->hdr->cond_nfull);
+  cond_init_pshared_perror(&s->hdr->cond_nempty);
+  cond_init_pshared_perror(&s->hdr->cond_finished);
+  for (i = 0; i < num_clients; i++){
+    mutex_init_pshared_perror(&s->clients[i].lock);
+    cond_init_pshared_perror(&s->clients[i].cond_fulfilled);
+  }
+  for (i = 0; i < num_locks; i++){
+    mutex_init_pshared_perror(&s->locks[i]);
+  }
+  for (i = 0; i < num_stocks; i++){
+    s->quantities[i] = quantity;
+  }
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  memcpy(s->hdr->magic, SHMQ_MAGIC, sizeof(s->hdr->magic));
+}
+
+void shmq_open_perror(shmq_t *s, const char *name){
+  struct stat st;
+  shmq_hdr_t hdr;
+  s->fd = shm_open(name, O_RDWR, 0);
+  if (s->fd < 0){
+    perror("shm_open failed");
+    exit(EXIT_FAILURE);
+  }
+  if (fstat(s->fd, &st) != 0){
+    perror("shared memory fstat failed");
+    exit(EXIT_FAILURE);
+  }
+  /* validate the header before mapping the segment */
+  if ((size_t)st.st_size < sizeof(shmq_hdr_t) ||
+      pread(s->fd, &hdr, sizeof(shmq_hdr_t), 0) !=
+      (ssize_t)sizeof(shmq_hdr_t) ||
+      memcmp(hdr.magic, SHMQ_MAGIC, sizeof(hdr.magic)) != 0){
+    fprintf(stderr, "%s is not an initialized order queue segment\n", name);
+    exit(EXIT_FAILURE);
+  }
+  if (hdr.version != SHMQ_VERSION){
+    fprintf(stderr, "%s has version %u instead of %u\n",
+	    name, (unsigned)hdr.version, (unsigned)SHMQ_VERSION);
+    exit(EXIT_FAILURE);
+  }
+  if (hdr.size != layout(&hdr) || (uint64_t)st.st_size != hdr.size){
+    fprintf(stderr, "%s is truncated or corrupt\n", name);
+    exit(EXIT_FAILURE);
+  }
+  map_perror(s, hdr.size);
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  map_arrays(s);
+}
+
+void shmq_close_perror(shmq_t *s){
+  if (munmap(s->hdr, s->size) != 0){
+    perror("shared memory munmap failed");
+    exit(EXIT_FAILURE);
+  }
+  if (close(s->fd) != 0){
+    perror("shared memory close failed");
+    exit(EXIT_FAILURE);
+  }
+  s->fd = -1;
+  s->hdr = NULL;
+  s->ring = NULL;
+  s->clients = NULL;
+  s->locks = NULL;
+  s->quantities = NULL;
+}
+
+void shmq_unlink_perror(const char *name){
+  if (shm_unlink(name) != 0){
+    perror("shm_unlink failed");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/**
+   Locks a robust lock of the segment, and counts the acquisitions after
+   the owner died. The counter is updated under the lock of the queue,
+   which is held on return if lock is the lock of the queue.
+*/
+static void lock_robust(shmq_hdr_t *hdr, pthread_mutex_t *lock){
+  if (mutex_lock_robust_perror(lock)){
+    if (lock != &hdr->lock) mutex_lock_robust_perror(&hdr->lock);
+    hdr->num_owner_dead++;
+    if (lock != &hdr->lock) mutex_unlock_perror(&hdr->lock);
+  }
+}
+
+/**
+   Waits on a condition with a robust lock of the segment, or until
+   deadline_ns if deadline_ns > 0. Returns -1 if the deadline passed.
+*/
+static int wait_robust(shmq_hdr_t *hdr,
+		       pthread_cond_t *cond,
+		       pthread_mutex_t *lock,
+		       uint64_t deadline_ns){
+  int ret;
+  if (deadline_ns > 0){
+    ret = cond_timedwait_robust_perror(cond, lock, deadline_ns);
+  }else{
+    ret = cond_wait_robust_perror(cond, lock);
+  }
+  if (ret == 1){
+    if (lock != &hdr->lock) mutex_lock_robust_perror(&hdr->lock);
+    hdr->num_owner_dead++;
+    if (lock != &hdr->lock) mutex_unlock_perror(&hdr->lock);
+  }
+  return ret;
+}
+
+int shmq_claim(shmq_t *s, int n){
+  int i;
+  int id = -1;
+  lock_robust(s->hdr, &s->hdr->lock);
+  if (n > 0 && s->hdr->num_claimed <= s->hdr->num_clients - n){
+    id = s->hdr->num_claimed;
+    s->hdr->num_claimed += n;
+    for (i = id; i < id + n; i++){
+      s->clients[i].pid = getpid();
+    }
+  }
+  mutex_unlock_perror(&s->hdr->lock);
+  return id;
+}
+
+/**
+   Signals cond if a process is waiting on cond, and counts the issued and
+   skipped signals. Requires holding the lock of the queue.
+*/
+static void signal_waiting(shmq_hdr_t *hdr, pthread_cond_t *cond,
+			   int num_wait){
+  if (num_wait > 0){
+    cond_signal_perror(cond);
+    hdr->num_signals++;
+  }else{
+    hdr->num_signals_skipped++;
+  }
+}
+
+void shmq_submit(shmq_t *s, int client_id){
+  int next;
+  shmq_hdr_t *hdr = s->hdr;
+  shmq_client_t *c = &s->clients[client_id];
+  c->fulfilled = FALSE; /* not referred to by a trader before queuing */
+  lock_robust(hdr, &hdr->lock);
+  next = (hdr->tail + 1) % hdr->count;
+  while (next == hdr->head){
+    hdr->num_wait_nfull++;
+    wait_robust(hdr, &hdr->cond_nfull, &hdr->lock, 0);
+    hdr->num_wait_nfull--;
+    next = (hdr->tail + 1) % hdr->count;
+  }
+  s->ring[next] = client_id;
+  hdr->tail = next;
+  signal_waiting(hdr, &hdr->cond_nempty, hdr->num_wait_nempty);
+  mutex_unlock_perror(&hdr->lock);
+  lock_robust(hdr, &c->lock);
+  while (!c->fulfilled){
+    wait_robust(hdr, &c->cond_fulfilled, &c->lock, 0);
+  }
+  mutex_unlock_perror(&c->lock);
+}
+
+int shmq_dequeue(shmq_t *s){
+  int next;
+  int client_id;
+  shmq_hdr_t *hdr = s->hdr;
+  lock_robust(hdr, &hdr->lock);
+  while (hdr->head == hdr->tail){
+    if (hdr->done){
+      mutex_unlock_perror(&hdr->lock);
+      return -1;
+    }
+    hdr->num_wait_nempty++;
+    wait_robust(hdr, &hdr->cond_nempty, &hdr->lock, 0);
+    hdr->num_wait_nempty--;
+  }
+  next = (hdr->head + 1) % hdr->count;
+  client_id = s->ring[next];
+  hdr->head = next;
+  signal_waiting(hdr, &hdr->cond_nfull, hdr->num_wait_nfull);
+  mutex_unlock_perror(&hdr->lock);
+  return client_id;
+}
+
+void shmq_fulfill(shmq_t *s, int client_id){
+  shmq_hdr_t *hdr = s->hdr;
+  shmq_client_t *c;
+  shmq_order_t order;
+  pthread_mutex_t *lock;
+  if (client_id < 0 || client_id >= hdr->num_clients){
+    lock_robust(hdr, &hdr->lock);
+    hdr->num_invalid++;
+    mutex_unlock_perror(&hdr->lock);
+    return;
+  }
+  c = &s->clients[client_id];
+  /* copy before validating, because the record is writable by the
+     client process */
+  memcpy(&order, &c->order, sizeof(shmq_order_t));
+  if (order.stock_id < 0 || order.stock_id >= hdr->num_stocks ||
+      order.quantity < 0 || order.quantity > hdr->quantity){
+    lock_robust(hdr, &hdr->lock);
+    hdr->num_invalid++;
+    mutex_unlock_perror(&hdr->lock);
+  }else{
+    lock = &s->locks[order.stock_id % hdr->num_locks];
+    lock_robust(hdr, lock);
+    if (order.action == BUY){
+      s->quantities[order.stock_id] -= order.quantity;
+      if (s->quantities[order.stock_id] < 0){
+	s->quantities[order.stock_id] = 0;
+      }
+    }else{
+      s->quantities[order.stock_id] += order.quantity;
+    }
+    mutex_unlock_perror(lock);
+  }
+  lock_robust(hdr, &c->lock);
+  c->fulfilled = TRUE;
+  cond_signal_perror(&c->cond_fulfilled);
+  mutex_unlock_perror(&c->lock);
+}
+
+void shmq_client_start(shmq_t *s, int client_id){
+  uint64_t now = time_mono_ns_perror();
+  lock_robust(s->hdr, &s->hdr->lock);
+  s->clients[client_id].pid = getpid();
+  if (s->hdr->start_ns == 0 || now < s->hdr->start_ns){
+    s->hdr->start_ns = now;
+  }
+  mutex_unlock_perror(&s->hdr->lock);
+}
+
+void shmq_client_finish(shmq_t *s, int client_id, const hist_t *h){
+  shmq_client_t *c = &s->clients[client_id];
+  c->num_orders = h->count;
+  c->min_ns = h->min;
+  c->max_ns = h->max;
+  c->sum_ns = h->sum;
+  memcpy(c->buckets, h->buckets, sizeof(c->buckets));
+  lock_robust(s->hdr, &s->hdr->lock);
+  c->finished = TRUE;
+  s->hdr->num_finished++;
+  s->hdr->end_ns = time_mono_ns_perror();
+  if (s->hdr->num_finished == s->hdr->num_clients){
+    cond_broadcast_perror(&s->hdr->cond_finished);
+  }
+  mutex_unlock_perror(&s->hdr->lock);
+}
+
+/**
+   Marks the claimed clients that did not finish and whose process no
+   longer exists as crashed, and returns the number of crashed clients.
+   Requires holding the lock of the queue. A process id may be reused
+   after the process exited, in which case the crash is detected after
+   the process with the reused id exited.
+*/
+static int mark_crashed(shmq_t *s){
+  int i;
+  int num_crashed = 0;
+  shmq_client_t *c;
+  for (i = 0; i < s->hdr->num_claimed; i++){
+    c = &s->clients[i];
+    if (!c->finished && !c->crashed && c->pid > 0 &&
+	kill(c->pid, 0) != 0 && errno == ESRCH){
+      c->crashed = TRUE;
+    }
+    if (c->crashed) num_crashed++;
+  }
+  return num_crashed;
+}
+
+int shmq_wait_clients(shmq_t *s){
+  int num_crashed = 0;
+  lock_robust(s->hdr, &s->hdr->lock);
+  while (s->hdr->num_finished + num_crashed < s->hdr->num_clients){
+    wait_robust(s->hdr, &s->hdr->cond_finished, &s->hdr->lock,
+		time_mono_ns_perror() + C_CRASH_POLL_NS);
+    num_crashed = mark_crashed(s);
+  }
+  mutex_unlock_perror(&s->hdr->lock);
+  return num_crashed;
+}
+
+void shmq_done(shmq_t *s){
+  /* broadcast cond_nempty because all traders may be blocked */
+  lock_robust(s->hdr, &s->hdr->lock);
+  s->hdr->done = TRUE;
+  if (s->hdr->num_wait_nempty > 0){
+    cond_broadcast_perror(&s->hdr->cond_nempty);
+    s->hdr->num_signals++;
+  }
+  mutex_unlock_perror(&s->hdr->lock);
+}
+
+void shmq_client_hist(const shmq_t *s, int client_id, hist_t *h){
+  hist_t src;
+  const shmq_client_t *c = &s->clients[client_id];
+  src.count = c->num_orders;
+  src.min = c->min_ns;
+  src.max = c->max_ns;
+  src.sum = c->sum_ns;
+  src.buckets = (uint64_t *)c->buckets; /* only read by hist_merge */
+  hist_merge(h, &src);
+}
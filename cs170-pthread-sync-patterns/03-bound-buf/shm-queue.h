@@ -0,0 +1,206 @@
+/**
+   shm-queue.h
+
+   Declarations of a bounded order queue and a market that live in a POSIX
+   shared memory segment, so that clients (producers) and traders
+   (consumers) can be separate processes, e.g. gateways and a matching
+   process that are isolated from each other.
+
+   A segment is created with shm_open by the process that runs the traders,
+   and is mapped by the processes of the clients. It consists of a header
+   with the queue and completion state, followed by
+   -  the ring of the queue, of client ids,
+   -  a record of each client, with the order of the client, its
+      completion, and its latency histogram,
+   -  the lock stripes and the quantities of the market,
+   each aligned to a cache line. All locks and condition variables are
+   initialized with the process-shared attribute, and the locks are
+   robust: a process that acquires a lock whose owner died makes it
+   consistent and continues, so that a crashed client does not block the
+   traders. A crashed trader is not detected, and blocks the clients with
+   an order that it dequeued until they are killed.
+
+   An order is handed off without copying: a client writes its order into
+   its own record in the segment and queues its client id, and a trader
+   reads the order in place, executes it on the market, and signals the
+   completion in the record. Because a client waits for its order to be
+   fulfilled before producing the next order, the order in a record is not
+   overwritten while it is queued. Offsets, instead of pointers, are
+   stored in the segment, because a segment is mapped at a different
+   address in each process.
+
+   A trader copies an order out of the record of its client before
+   validating it, and does not execute an order with an out-of-range
+   stock id or quantity, so that a faulty client process cannot write
+   outside of the market of the trader.
+*/
+
+#ifndef SHM_QUEUE_H
+#define SHM_QUEUE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/types.h>
+#include "bound-buf.h"
+#include "utilities-hist.h"
+
+#define SHMQ_MAGIC "BBSHMQ1" /* 8 bytes with the terminating null */
+#define SHMQ_VERSION (2) /* used as uint32_t */
+
+typedef struct{
+  int stock_id;
+  int quantity;
+  action_t action;
+  uint64_t start_ns; /* send time on the monotonic clock */
+} shmq_order_t;
+
+typedef struct{
+  char magic[8]; /* written last by the creator */
+  uint32_t version;
+  uint32_t pad;
+  uint64_t size; /* of the segment */
+  int count; /* count - 1 is the fixed count of the queue */
+  int num_clients;
+  int num_stocks;
+  int quantity; /* maximal quantity of an order */
+  int num_locks;
+  size_t ring_off; /* offsets from the start of the segment */
+  size_t clients_off;
+  size_t locks_off;
+  size_t quantities_off;
+  /* queue */
+  pthread_mutex_t lock;
+  pthread_cond_t cond_nfull;
+  pthread_cond_t cond_nempty;
+  int head;
+  int tail;
+  int num_wait_nfull; /* clients waiting on cond_nfull */
+  int num_wait_nempty; /* traders waiting on cond_nempty */
+  boolean_t done;
+  unsigned long num_signals; /* issued */
+  unsigned long num_signals_skipped; /* not issued without waiters */
+  unsigned long num_invalid; /* orders not executed */
+  unsigned long num_owner_dead; /* locks acquired after their owner died */
+  /* clients, under lock */
+  pthread_cond_t cond_finished;
+  int num_claimed; /* client ids in [0, num_claimed) are taken */
+  int num_finished;
+  uint64_t start_ns; /* of the first client */
+  uint64_t end_ns; /* of the last client */
+} shmq_hdr_t;
+
+/**
+   Record of a client. The histogram is copied by the client when it
+   finishes, and is merged with shmq_client_hist.
+*/
+typedef struct{
+  shmq_order_t order;
+  pid_t pid; /* of the client process, or of the run that claimed it */
+  boolean_t finished; /* under the lock of the queue */
+  boolean_t crashed; /* under the lock of the queue */
+  boolean_t fulfilled;
+  pthread_mutex_t lock;
+  pthread_cond_t cond_fulfilled;
+  uint64_t num_orders;
+  uint64_t min_ns;
+  uint64_t max_ns;
+  double sum_ns;
+  uint64_t buckets[HIST_NUM_BUCKETS];
+} shmq_client_t;
+
+typedef struct{
+  int fd;
+  size_t size;
+  shmq_hdr_t *hdr; /* start of the mapping */
+  int *ring;
+  shmq_client_t *clients;
+  pthread_mutex_t *locks;
+  int *quantities;
+} shmq_t;
+
+/**
+   Create a segment with a name that starts with '/' for a queue of count
+   orders, num_clients clients, and a market of num_stocks stocks with an
+   initial quantity each and num_locks lock stripes, and map it. Orders
+   with a quantity above the initial quantity are not executed. Exits
+   with an error message if a segment with the name exists.
+*/
+void shmq_create_perror(shmq_t *s,
+			const char *name,
+			int count,
+			int num_clients,
+			int num_stocks,
+			int quantity,
+			int num_locks);
+
+/**
+   Map an existing segment. Exits with an error message if the segment is
+   not an initialized segment of the current version.
+*/
+void shmq_open_perror(shmq_t *s, const char *name);
+
+/**
+   Unmap a segment, and remove the name of a segment; the memory of the
+   segment is released after the last process unmaps it.
+*/
+
+void shmq_close_perror(shmq_t *s);
+
+void shmq_unlink_perror(const char *name);
+
+/**
+   Claim n consecutive free client ids for the calling process, and return
+   the first id, or return -1 if fewer than n ids are free. The ids are
+   reserved under a single acquisition of the lock of the queue, so that
+   concurrent runs claim disjoint ranges.
+*/
+int shmq_claim(shmq_t *s, int n);
+
+/**
+   Queue the order in the record of a client, blocking while the queue is
+   full, and wait until a trader fulfilled the order.
+*/
+void shmq_submit(shmq_t *s, int client_id);
+
+/**
+   Dequeue the id of a client with a queued order, blocking while the
+   queue is empty. Returns -1 if the queue is empty and shmq_done was
+   called.
+*/
+int shmq_dequeue(shmq_t *s);
+
+/**
+   Execute the order of a client on the market under the lock of its
+   stock, and signal the completion of the order to the client. An order
+   with an out-of-range stock id or quantity is counted in num_invalid,
+   and completed without being executed.
+*/
+void shmq_fulfill(shmq_t *s, int client_id);
+
+/**
+   Record the start of a client in the calling process, and the finish of
+   a client with the latency histogram of its orders.
+*/
+
+void shmq_client_start(shmq_t *s, int client_id);
+
+void shmq_client_finish(shmq_t *s, int client_id, const hist_t *h);
+
+/**
+   Wait until each of the num_clients clients finished or crashed, and
+   return the number of crashed clients; a claimed client crashed if its
+   process, or the run that claimed it before forking it, no longer exists
+   without the client having finished. Unblock the traders.
+*/
+
+int shmq_wait_clients(shmq_t *s);
+
+void shmq_done(shmq_t *s);
+
+/**
+   Add the latency histogram of a finished client to a histogram.
+*/
+void shmq_client_hist(const shmq_t *s, int client_id, hist_t *h);
+
+#endif
@@ -0,0 +1,148 @@
+/**
+   snapshot.c
+
+   Periodic copy-on-write or stop-the-world snapshots of the market of the
+   bound-buf benchmark.
+*/
+
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "snapshot.h"
+#include "market.h"
+#include "utilities-pthread.h"
+#include "utilities-time.h"
+
+/**
+   Takes a snapshot by incrementing snap_epoch and copying the stripes
+   that traders did not copy, one stripe lock at a time. Adds the time
+   that stripe locks were held to hold_ns, and returns the longest hold.
+*/
+static uint64_t snapshot_cow(market_t *m, uint64_t *hold_ns){
+  int i;
+  uint64_t start, ns;
+  uint64_t max_ns = 0;
+  __atomic_add_fetch(&m->snap_epoch, 1, __ATOMIC_ACQ_REL);
+  for (i = 0; i < m->num_locks; i++){
+    mutex_lock_perror(&m->locks[i]);
+    start = time_mono_ns_perror();
+    market_stripe_copy(m, i);
+    ns = time_mono_ns_perror() - start;
+    mutex_unlock_perror(&m->locks[i]);
+    *hold_ns += ns;
+    if (ns > max_ns) max_ns = ns;
+  }
+  return max_ns;
+}
+
+/**
+   Takes a snapshot by holding all stripe locks while copying, which
+   pauses all traders. Adds the pause to hold_ns, and returns the pause.
+*/
+static uint64_t snapshot_stw(market_t *m, uint64_t *hold_ns){
+  int i;
+  uint64_t start, ns;
+  start = time_mono_ns_perror();
+  for (i = 0; i < m->num_locks; i++){
+    mutex_lock_perror(&m->locks[i]);
+  }
+  __atomic_add_fetch(&m->snap_epoch, 1, __ATOMIC_ACQ_REL);
+  for (i = 0; i < m->num_locks; i++){
+    market_stripe_copy(m, i);
+  }
+  for (i = m->num_locks - 1; i >= 0; i--){
+    mutex_unlock_perror(&m->locks[i]);
+  }
+  ns = time_mono_ns_perror() - start;
+  *hold_ns += ns;
+  return ns;
+}
+
+/**
+   Takes a snapshot every period_ns until done, and reports the total
+   quantity and the number of empty stocks of each snapshot, e.g. for
+   risk reporting. The snapshot is read without locking, because it is
+   written by traders only after the next increment of snap_epoch.
+*/
+static void *snapshot_thread(void *arg){
+  int i;
+  long total;
+  int num_empty;
+  uint64_t start, ns, hold_ns;
+  snapshot_t *sn = arg;
+  market_t *m = sn->m;
+  while (!__atomic_load_n(&sn->done, __ATOMIC_RELAXED)){
+    time_wait_until_ns_perror(time_mono_ns_perror() + sn->period_ns, 0);
+    start = time_mono_ns_perror();
+    if (sn->cow){
+      hold_ns = snapshot_cow(m, &sn->hold_ns);
+    }else{
+      hold_ns = snapshot_stw(m, &sn->hold_ns);
+    }
+    ns = time_mono_ns_perror() - start;
+    sn->num_snapshots++;
+    sn->sum_ns += ns;
+    if (ns > sn->max_ns) sn->max_ns = ns;
+    if (hold_ns > sn->max_hold_ns) sn->max_hold_ns = hold_ns;
+    total = 0;
+    num_empty = 0;
+    for (i = 0; i < m->num_stocks; i++){
+      total += m->snap_quantities[i];
+      if (m->snap_quantities[i] == 0) num_empty++;
+    }
+    sn->total = total;
+    sn->num_empty = num_empty;
+  }
+  return NULL;
+}
+
+int snapshot_parse(snapshot_t *sn, const char *s){
+  int n = 0;
+  long period = 0;
+  sn->cow = TRUE;
+  if (sscanf(s, "%ld%n", &period, &n) != 1 || period < 1) return -1;
+  sn->period_ns = period;
+  s += n;
+  if (*s == '\0') return 0;
+  if (strcmp(s, ":cow") == 0) return 0;
+  if (strcmp(s, ":stw") != 0) return -1;
+  sn->cow = FALSE;
+  return 0;
+}
+
+void snapshot_start(snapshot_t *sn, market_t *m){
+  sn->m = m;
+  sn->done = FALSE;
+  thread_create_perror(&sn->tid, snapshot_thread, sn);
+}
+
+void snapshot_stop(snapshot_t *sn){
+  __atomic_store_n(&sn->done, TRUE, __ATOMIC_RELAXED);
+  thread_join_perror(sn->tid, NULL);
+}
+
+void snapshot_print(const snapshot_t *sn,
+		    unsigned long num_cows,
+		    uint64_t cow_ns,
+		    uint64_t max_cow_ns){
+  printf("snapshot: %s, %lu snapshots, duration (ns) mean %.0f max %lu, "
+	 "lock hold (ns) mean %.0f max %lu\n",
+	 sn->cow ? "cow" : "stw",
+	 sn->num_snapshots,
+	 (sn->num_snapshots > 0) ?
+	 (double)sn->sum_ns / sn->num_snapshots : 0.0,
+	 (unsigned long)sn->max_ns,
+	 (sn->num_snapshots > 0) ?
+	 (double)sn->hold_ns /
+	 (sn->num_snapshots * (sn->cow ? sn->m->num_locks : 1)) : 0.0,
+	 (unsigned long)sn->max_hold_ns);
+  printf("snapshot: %lu stripes copied by traders, copy (ns) mean %.0f "
+	 "max %lu, latest total quantity %ld, %d empty stocks\n",
+	 num_cows,
+	 (num_cows > 0) ? (double)cow_ns / num_cows : 0.0,
+	 (unsigned long)max_cow_ns,
+	 sn->total,
+	 sn->num_empty);
+}
@@ -0,0 +1,64 @@
+/**
+   snapshot.h
+
+   Declarations of periodic snapshots of the market of the bound-buf
+   benchmark by a snapshot thread, and a risk report of each snapshot,
+   i.e. the total quantity and the number of empty stocks.
+
+   A copy-on-write (cow) snapshot increments the snapshot epoch of the
+   market and then copies the stripes that traders did not copy, one
+   stripe lock at a time (market.h). A stop-the-world (stw) snapshot
+   holds all stripe locks while copying, which pauses all traders.
+*/
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+#include <pthread.h>
+#include "bound-buf.h"
+#include "market.h"
+
+typedef struct{
+  boolean_t cow;
+  uint64_t period_ns; /* 0 if no snapshots */
+  boolean_t done; /* accessed atomically */
+  market_t *m;
+  pthread_t tid;
+  unsigned long num_snapshots;
+  uint64_t sum_ns; /* duration of the snapshots */
+  uint64_t max_ns;
+  uint64_t hold_ns; /* stripe locks held by the snapshot thread */
+  uint64_t max_hold_ns; /* longest hold of a stripe lock, or of all */
+  long total; /* total quantity of the latest snapshot */
+  int num_empty; /* stocks with quantity 0 in the latest snapshot */
+} snapshot_t;
+
+/**
+   Parse a snapshot configuration "<period-ns>[:cow|stw]". Returns 0 on
+   success and -1 on invalid input.
+*/
+int snapshot_parse(snapshot_t *sn, const char *s);
+
+/**
+   Start the snapshot thread of a market, which takes a snapshot every
+   period_ns.
+*/
+void snapshot_start(snapshot_t *sn, market_t *m);
+
+/**
+   Stop and join the snapshot thread.
+*/
+void snapshot_stop(snapshot_t *sn);
+
+/**
+   Print the statistics of the snapshots, and of the stripes that were
+   copied by traders in num_cows copies that took cow_ns in total and
+   max_cow_ns at most, after the snapshot thread is stopped.
+*/
+void snapshot_print(const snapshot_t *sn,
+		    unsigned long num_cows,
+		    uint64_t cow_ns,
+		    uint64_t max_cow_ns);
+
+#endif
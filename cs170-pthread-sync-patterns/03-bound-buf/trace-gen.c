@@ -0,0 +1,167 @@
+/**
+   trace-gen.c
+
+   A program for generating an order trace (trace.h) for replay by the
+   clients of bound-buf with -T. The orders of each client are drawn from
+   the workload (workload.h) with the same options as in bound-buf, and
+   from a non-overlapping stream of a generator that is seeded with -x
+   <seed>, so that a trace is reproducible from its options and seed.
+
+   usage examples:
+   ./trace-gen -c 3 -o 100000 -s 100 /tmp/orders.trace
+   ./trace-gen -c 3 -o 100000 -s 1000 -d zipf:1.2 -U 0.1 -x 42 /tmp/z.trace
+   ./bound-buf -b latch -t 3 -q 16 -T /tmp/orders.trace
+   ./bound-buf -b sema -t 3 -q 16 -T /tmp/orders.trace
+*/
+
+#define _XOPEN_SOURCE 600
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include "bound-buf.h"
+#include "workload.h"
+#include "trace.h"
+#include "utilities-mem.h"
+#include "utilities-rand.h"
+
+#define ARGS "c:o:s:d:p:Q:U:x:"
+
+const int C_DEF_NUM_CLIENTS = 1;
+const int C_DEF_ORDERS_PER_CLIENT = 1;
+const int C_DEF_NUM_STOCKS = 1;
+const int C_DEF_QUANTITY = 5000; /* as in bound-buf */
+
+const char *C_USAGE =
+  "trace-gen "
+  "-c clients "
+  "-o orders-per-client "
+  "-s number-stocks "
+  "-d uniform|zipf:s|hot:prob:frac "
+  "-p buy-probability "
+  "-Q uniform|pareto:alpha "
+  "-U urgent-probability "
+  "-x seed "
+  "path\n";
+
+int main(int argc, char **argv){
+  int i, j;
+  int c;
+  int num_clients = C_DEF_NUM_CLIENTS;
+  int orders_per_client = C_DEF_ORDERS_PER_CLIENT;
+  int num_stocks = C_DEF_NUM_STOCKS;
+  uint64_t seed = time(NULL);
+  FILE *stream = NULL;
+  workload_t *w = NULL;
+  trace_hdr_t hdr;
+  order_t order;
+  rng_t rng, client_rng;
+  w = malloc_perror(1, sizeof(workload_t));
+  workload_defaults(w);
+  while ((c = getopt(argc, argv, ARGS)) != -1){
+    switch (c){
+    case 'c':
+      num_clients = atoi(optarg);
+      if (num_clients < 1){
+	fprintf(stderr,"number of clients must be > 0\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'o':
+      orders_per_client = atoi(optarg);
+      if (orders_per_client < 0){
+	fprintf(stderr,"orders per client must be non-negative\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 's':
+      num_stocks = atoi(optarg);
+      if (num_stocks < 1){
+	fprintf(stderr,"number of stocks must be > 0\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'd':
+      if (workload_parse_stock(w, optarg) != 0){
+	fprintf(stderr,"stock distribution must be uniform, zipf:s with "
+		"s > 0, or hot:prob:frac with prob in [0, 1] and "
+		"frac in (0, 1]\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'p':
+      w->prob_buy = atof(optarg);
+      if (w->prob_buy < 0.0 || w->prob_buy > 1.0){
+	fprintf(stderr,"buy probability must be in [0, 1]\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'Q':
+      if (workload_parse_quantity(w, optarg) != 0){
+	fprintf(stderr,"quantity distribution must be uniform or "
+		"pareto:alpha with alpha > 0\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'U':
+      w->prob_urgent = atof(optarg);
+      if (w->prob_urgent < 0.0 || w->prob_urgent > 1.0){
+	fprintf(stderr,"urgent probability must be in [0, 1]\n");
+	exit(EXIT_FAILURE);
+      }
+      break;
+    case 'x':
+      seed = strtoull(optarg, NULL, 10);
+      break;
+    default:
+      fprintf(stderr, "unrecognized command %c\n", (char)c);
+      fprintf(stderr,"usage: %s", C_USAGE);
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (optind != argc - 1){
+    fprintf(stderr,"usage: %s", C_USAGE);
+    exit(EXIT_FAILURE);
+  }
+  workload_init(w, num_stocks, C_DEF_QUANTITY);
+  stream = fopen(argv[optind], "wb");
+  if (stream == NULL){
+    perror("trace fopen failed");
+    exit(EXIT_FAILURE);
+  }
+  memset(&hdr, 0, sizeof(trace_hdr_t));
+  memcpy(hdr.magic, TRACE_MAGIC, sizeof(hdr.magic));
+  hdr.version = TRACE_VERSION;
+  hdr.rec_size = sizeof(trace_rec_t);
+  hdr.num_clients = num_clients;
+  hdr.orders_per_client = orders_per_client;
+  hdr.num_stocks = num_stocks;
+  hdr.quantity = C_DEF_QUANTITY;
+  hdr.seed = seed;
+  trace_write_hdr_perror(stream, &hdr);
+  rng_seed(&rng, seed);
+  for (i = 0; i < num_clients; i++){
+    /* the stream of client i, as assigned to the clients of bound-buf */
+    client_rng = rng;
+    rng_jump(&rng);
+    for (j = 0; j < orders_per_client; j++){
+      workload_next(w, &client_rng, &order);
+      trace_write_rec_perror(stream, &order);
+    }
+  }
+  if (fclose(stream) != 0){
+    perror("trace fclose failed");
+    exit(EXIT_FAILURE);
+  }
+  printf("trace: %s, %d clients, %d orders per client, %d stocks, "
+	 "seed %lu\n",
+	 argv[optind], num_clients, orders_per_client, num_stocks,
+	 (unsigned long)seed);
+  workload_print(w);
+  workload_free(w);
+  free(w);
+  w = NULL;
+  return 0;
+}
@@ -0,0 +1,112 @@
+/**
+   trace.c
+
+   A binary order trace for the bound-buf benchmark. A trace is written
+   with buffered stdio by the generator and mapped with mmap by the
+   replaying clients. The header is validated against the size of the
+   file before the records are referred to.
+*/
+
+#define _XOPEN_SOURCE 600
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "trace.h"
+#include "bound-buf.h"
+
+void trace_write_hdr_perror(FILE *stream, const trace_hdr_t *hdr){
+  if (fwrite(hdr, sizeof(trace_hdr_t), 1, stream) != 1){
+    perror("trace write failed");
+    exit(EXIT_FAILURE);
+  }
+}
+
+void trace_write_rec_perror(FILE *stream, const order_t *order){
+  trace_rec_t rec;
+  memset(&rec, 0, sizeof(trace_rec_t));
+  rec.stock_id = order->stock_id;
+  rec.quantity = order->quantity;
+  rec.action = order->action;
+  rec.lane = order->lane;
+  if (fwrite(&rec, sizeof(trace_rec_t), 1, stream) != 1){
+    perror("trace write failed");
+    exit(EXIT_FAILURE);
+  }
+}
+
+void trace_map_perror(trace_t *tr, const char *path){
+  int err;
+  void *p = NULL;
+  struct stat st;
+  trace_hdr_t hdr;
+  tr->fd = open(path, O_RDONLY);
+  if (tr->fd < 0){
+    perror("trace open failed");
+    exit(EXIT_FAILURE);
+  }
+  if (fstat(tr->fd, &st) != 0){
+    perror("trace fstat failed");
+    exit(EXIT_FAILURE);
+  }
+  /* validate the header before mapping the records */
+  if ((size_t)st.st_size < sizeof(trace_hdr_t) ||
+      pread(tr->fd, &hdr, sizeof(trace_hdr_t), 0) !=
+      (ssize_t)sizeof(trace_hdr_t) ||
+      memcmp(hdr.magic, TRACE_MAGIC, sizeof(hdr.magic)) != 0){
+    fprintf(stderr, "%s is not an order trace\n", path);
+    exit(EXIT_FAILURE);
+  }
+  if (hdr.version != TRACE_VERSION || hdr.rec_size != sizeof(trace_rec_t)){
+    fprintf(stderr, "%s has version %u instead of %u\n",
+	    path, (unsigned)hdr.version, (unsigned)TRACE_VERSION);
+    exit(EXIT_FAILURE);
+  }
+  tr->size = sizeof(trace_hdr_t) +
+    (size_t)hdr.num_clients * hdr.orders_per_client * sizeof(trace_rec_t);
+  if ((uint64_t)st.st_size != tr->size){
+    fprintf(stderr, "%s is truncated or corrupt\n", path);
+    exit(EXIT_FAILURE);
+  }
+  p = mmap(NULL, tr->size, PROT_READ, MAP_PRIVATE, tr->fd, 0);
+  if (p == MAP_FAILED){
+    perror("trace mmap failed");
+    exit(EXIT_FAILURE);
+  }
+  err = posix_madvise(p, tr->size, POSIX_MADV_WILLNEED);
+  if (err != 0){
+    fprintf(stderr, "trace madvise failed: %s\n", strerror(err));
+    exit(EXIT_FAILURE);
+  }
+  tr->hdr = p;
+  tr->recs = (const trace_rec_t *)((const char *)p + sizeof(trace_hdr_t));
+}
+
+const trace_rec_t *trace_slice(const trace_t *tr, int client_id){
+  return &tr->recs[(size_t)client_id * tr->hdr->orders_per_client];
+}
+
+void trace_order(const trace_rec_t *rec, order_t *order){
+  order->stock_id = rec->stock_id;
+  order->quantity = rec->quantity;
+  order->action = rec->action;
+  order->lane = rec->lane;
+}
+
+void trace_unmap_perror(trace_t *tr){
+  if (munmap((void *)tr->hdr, tr->size) != 0){
+    perror("trace munmap failed");
+    exit(EXIT_FAILURE);
+  }
+  if (close(tr->fd) != 0){
+    perror("trace close failed");
+    exit(EXIT_FAILURE);
+  }
+  tr->fd = -1;
+  tr->hdr = NULL;
+  tr->recs = NULL;
+}
@@ -0,0 +1,84 @@
+/**
+   trace.h
+
+   Declarations of a binary order trace for the bound-buf benchmark. A
+   trace is generated once with trace-gen (trace-gen.c) and replayed by
+   the clients of bound-buf, so that runs, e.g. of different backends,
+   queue identical order streams, and the order generation is not part
+   of the measurement.
+
+   A trace consists of a header, followed by the fixed-size records of
+   the orders of each client in client order, so that the orders of a
+   client are a contiguous slice of the trace. A trace is mapped
+   read-only, and a client reads its orders from its slice in the mapping
+   without copying the trace.
+*/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "bound-buf.h"
+
+#define TRACE_MAGIC "BBTRC01" /* 8 bytes with the terminating null */
+#define TRACE_VERSION (1) /* used as uint32_t */
+
+typedef struct{
+  char magic[8];
+  uint32_t version;
+  uint32_t rec_size; /* sizeof(trace_rec_t) */
+  uint32_t num_clients;
+  uint32_t orders_per_client;
+  uint32_t num_stocks; /* stock ids are in [0, num_stocks) */
+  uint32_t quantity; /* maximal quantity */
+  uint64_t seed; /* of the generator */
+} trace_hdr_t;
+
+typedef struct{
+  uint32_t stock_id;
+  uint32_t quantity;
+  uint8_t action; /* action_t */
+  uint8_t lane; /* lane_t */
+  uint8_t pad[2];
+} trace_rec_t;
+
+typedef struct{
+  int fd;
+  size_t size;
+  const trace_hdr_t *hdr; /* start of the mapping */
+  const trace_rec_t *recs; /* after the header */
+} trace_t;
+
+/**
+   Write the header of a trace to a stream, which is followed by
+   num_clients * orders_per_client records written with trace_write_rec.
+*/
+void trace_write_hdr_perror(FILE *stream, const trace_hdr_t *hdr);
+
+/**
+   Write the record of an order to a stream.
+*/
+void trace_write_rec_perror(FILE *stream, const order_t *order);
+
+/**
+   Map a trace at path read-only, and advise the kernel to read it ahead.
+   Exits with an error message if the file is not a trace of the current
+   version.
+*/
+void trace_map_perror(trace_t *tr, const char *path);
+
+/**
+   Return the slice of the orders of a client.
+*/
+const trace_rec_t *trace_slice(const trace_t *tr, int client_id);
+
+/**
+   Copy a record into an order.
+*/
+void trace_order(const trace_rec_t *rec, order_t *order);
+
+void trace_unmap_perror(trace_t *tr);
+
+#endif
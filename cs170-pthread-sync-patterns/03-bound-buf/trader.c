@@ -0,0 +1,174 @@
+/**
+   trader.c
+
+   Traders (consumers) of the bound-buf benchmark.
+*/
+
+#define _XOPEN_SOURCE 600
+
+#include <stdlib.h>
+#include <stddef.h>
+#include <pthread.h>
+#include "trader.h"
+#include "utilities-pthread.h"
+#include "utilities-time.h"
+
+static const char *C_LOG_FULFILLED =
+  "trader: %ld fulfilled stock %ld for %ld\n";
+
+void trader_execute(trader_arg_t *ta, const order_rec_t *rec){
+  int stripe = rec->stock_id % ta->m->num_locks;
+  uint64_t start, ns;
+  journal_rec_t jrec;
+  pthread_mutex_t *lock = NULL;
+  lock = &ta->m->locks[stripe];
+  mutex_lock_perror(lock);
+  if (ta->m->stripe_epochs[stripe] !=
+      __atomic_load_n(&ta->m->snap_epoch, __ATOMIC_ACQUIRE)){
+    /* copy the stripe before the update for an ongoing snapshot */
+    start = time_mono_ns_perror();
+    market_stripe_copy(ta->m, stripe);
+    ns = time_mono_ns_perror() - start;
+    ta->num_cows++;
+    ta->cow_ns += ns;
+    if (ns > ta->max_cow_ns) ta->max_cow_ns = ns;
+  }
+  workload_service(ta->w);
+  if (rec->action == BUY){
+    ta->m->quantities[rec->stock_id] -= rec->quantity;
+    if (ta->m->quantities[rec->stock_id] < 0){
+      ta->m->quantities[rec->stock_id] = 0;
+    }
+  }else{
+    ta->m->quantities[rec->stock_id] += rec->quantity;
+  }
+  if (ta->journal != NULL){
+    jrec.stock_id = rec->stock_id;
+    jrec.quantity = rec->quantity;
+    jrec.action = rec->action;
+    jrec.client_id = rec->client_id;
+    jrec.stock_quantity = ta->m->quantities[rec->stock_id];
+    jrec.pad = 0;
+    journal_append(ta->journal, &jrec, rec);
+  }
+  mutex_unlock_perror(lock);
+  if (ta->verbose){
+    log_write(ta->log, ta->log_id, C_LOG_FULFILLED,
+	      ta->id, rec->stock_id, rec->quantity, 0);
+  }
+}
+
+/**
+   Informs the client of a completed order, or the ingress for an order of
+   the ingress.
+*/
+static void trader_inform(trader_arg_t *ta,
+			  const order_rec_t *rec,
+			  uint64_t now_ns){
+  if (ta->ingress != NULL && rec->client_id == ta->ingress->client_id){
+    ingress_complete(ta->ingress, rec->order, now_ns);
+  }else if (rec->batch == NULL){
+    ta->b->order_fulfill(rec->order);
+  }else if (__atomic_sub_fetch(&rec->batch->num_pending, 1,
+			       __ATOMIC_ACQ_REL) == 0){
+    /* the last pending order of the batch */
+    ta->b->order_fulfill(rec->batch->done);
+  }
+}
+
+void trader_fulfill(trader_arg_t *ta,
+		    const order_rec_t *rec,
+		    uint64_t now_ns){
+  uint64_t latency = now_ns - rec->start_ns;
+  hist_add(&ta->hists[rec->client_id], latency);
+  hist_add(&ta->lane_hists[rec->lane], latency);
+  trader_inform(ta, rec, now_ns);
+}
+
+void trader_reject(trader_arg_t *ta,
+		   const order_rec_t *rec,
+		   uint64_t now_ns){
+  rec->order->rejected = TRUE; /* published by the completion */
+  trader_inform(ta, rec, now_ns);
+}
+
+void trader_publish(trader_arg_t *ta,
+		    const order_rec_t *rec,
+		    uint64_t now_ns){
+  fill_t fill;
+  if (ta->bus == NULL) return;
+  fill.stock_id = rec->stock_id;
+  fill.quantity = rec->quantity;
+  fill.action = rec->action;
+  fill.client_id = rec->client_id;
+  fill.fill_ns = now_ns;
+  if (fill_bus_publish(ta->bus, &fill)) ta->num_bus_stalls++;
+}
+
+void journal_durable(void *arg, const order_rec_t *rec, uint64_t now_ns){
+  trader_arg_t *ta = arg;
+  trader_fulfill(ta, rec, now_ns);
+  trader_publish(ta, rec, now_ns);
+}
+
+void order_expire(wheel_timer_t *timer, void *arg){
+  int expected = ORDER_QUEUED;
+  const backend_t *b = arg;
+  order_t *order = (order_t *)((char *)timer - offsetof(order_t, expiry));
+  if (__atomic_compare_exchange_n(&order->state, &expected, ORDER_EXPIRED,
+				  0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)){
+    b->order_fulfill(order);
+  }
+}
+
+void trader_expire(trader_arg_t *ta, order_t *order){
+  ta->num_expired++;
+  __atomic_store_n(&order->state, ORDER_RELEASED, __ATOMIC_RELEASE);
+  ta->b->order_fulfill(order);
+}
+
+boolean_t trader_claim(trader_arg_t *ta, const order_rec_t *rec){
+  int expected = ORDER_QUEUED;
+  order_t *order = rec->order;
+  if (rec->deadline_ns == 0) return TRUE;
+  if (!__atomic_compare_exchange_n(&order->state, &expected, ORDER_CLAIMED,
+				   0, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE) &&
+      expected != ORDER_CLAIMED){
+    /* expired by the timer */
+    ta->num_expired++;
+    expected = ORDER_EXPIRED;
+    if (!__atomic_compare_exchange_n(&order->state, &expected,
+				     ORDER_RELEASED, 0,
+				     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)){
+      /* released by the client */
+      ta->b->order_free(order);
+      free(order);
+    }
+    return FALSE;
+  }
+  if (time_mono_ns_perror() < rec->deadline_ns) return TRUE;
+  trader_expire(ta, order);
+  return FALSE;
+}
+
+void *trader_thread(void *arg){
+  uint64_t now_ns;
+  uint64_t busy_start = 0;
+  order_rec_t rec;
+  trader_arg_t *ta = arg;
+  while ((ta->pool == NULL || pool_wait_active(ta->pool, ta->id)) &&
+	 ta->b->queue_dequeue(ta->q, &rec)){
+    if (!trader_claim(ta, &rec)) continue;
+    if (ta->pool != NULL) busy_start = time_mono_ns_perror();
+    trader_execute(ta, &rec);
+    now_ns = time_mono_ns_perror();
+    if (ta->pool != NULL){
+      pool_busy_add(ta->pool, ta->id, now_ns - busy_start);
+    }
+    if (ta->journal == NULL || ta->journal->level != JOURNAL_SYNC){
+      trader_fulfill(ta, &rec, now_ns);
+      trader_publish(ta, &rec, now_ns);
+    }
+  }
+  return NULL;
+}
@@ -0,0 +1,122 @@
+/**
+   trader.h
+
+   Declarations of the traders (consumers) of the bound-buf benchmark,
+   which dequeue orders, execute them on the market, and inform the
+   clients. A trader records the latencies of its orders, appends each
+   executed order to the journal and publishes its fill on the fill bus,
+   if any, and drops an order that expired before it was executed.
+
+   The functions other than trader_thread are also the steps of the stage
+   threads of the pipeline (pipeline.h), each with its own trader
+   argument.
+*/
+
+#ifndef TRADER_H
+#define TRADER_H
+
+#include <stdint.h>
+#include "bound-buf.h"
+#include "market.h"
+#include "pool.h"
+#include "workload.h"
+#include "journal.h"
+#include "fill-bus.h"
+#include "ingress.h"
+#include "utilities-log.h"
+#include "utilities-hist.h"
+
+typedef struct{
+  int id;
+  int log_id; /* ring id follows the client ring ids */
+  boolean_t verbose;
+  const backend_t *b;
+  void *q; /* clients (producers) and traders (consumers) */
+  market_t *m; /* only traders (consumers) */
+  const workload_t *w;
+  log_t *log; /* only if verbose */
+  hist_t *hists; /* latencies of fulfilled orders in ns, per client */
+  hist_t lane_hists[NUM_LANES]; /* latencies in ns, per lane */
+  pool_t *pool; /* NULL if the number of traders is fixed */
+  journal_t *journal; /* NULL if applied orders are not journaled */
+  fill_bus_t *bus; /* NULL if fills are not published */
+  unsigned long num_bus_stalls; /* publishes blocked on a full ring */
+  ingress_t *ingress; /* NULL if orders are not accepted from sockets */
+  unsigned long num_expired; /* dropped before trading */
+  unsigned long num_cows; /* stripes copied for a snapshot */
+  uint64_t cow_ns; /* time of the copies */
+  uint64_t max_cow_ns;
+} trader_arg_t;
+
+/**
+   Execute an order on the market under the lock of its stock, and
+   append it to the journal, if any, under the same lock.
+*/
+void trader_execute(trader_arg_t *ta, const order_rec_t *rec);
+
+/**
+   Record the latency of an order that completed at now_ns and inform
+   the client, or the ingress for an order of the ingress. The order is not
+   referred to afterwards.
+*/
+void trader_fulfill(trader_arg_t *ta,
+		    const order_rec_t *rec,
+		    uint64_t now_ns);
+
+/**
+   Inform the client of an order that was rejected by a pipeline stage,
+   or the ingress for an order of the ingress, without recording a
+   latency. The order is not referred to afterwards.
+*/
+void trader_reject(trader_arg_t *ta,
+		   const order_rec_t *rec,
+		   uint64_t now_ns);
+
+/**
+   Publish the fill of an executed order that was fulfilled at now_ns
+   on the fill bus, if any. Blocks while the ring is full.
+*/
+void trader_publish(trader_arg_t *ta,
+		    const order_rec_t *rec,
+		    uint64_t now_ns);
+
+/**
+   Drop an order that a trader claimed after its deadline, and inform
+   the client, which reuses the order.
+*/
+void trader_expire(trader_arg_t *ta, order_t *order);
+
+/**
+   Claim a dequeued order with a deadline, and return TRUE if the order
+   is to be processed. An order that expired while queued is dropped, and
+   freed if its client released it, and an order that is dequeued after
+   its deadline is dropped and its client is informed. An order without a
+   deadline, or claimed at a previous pipeline stage, is not claimed
+   again.
+*/
+boolean_t trader_claim(trader_arg_t *ta, const order_rec_t *rec);
+
+/**
+   Dequeue and consume orders, as long as there are orders and the
+   trader is active, or park the trader if it is retired. With a pool,
+   the busy time from a dequeue to the execution is accumulated. At the
+   sync level of the journal, an order is fulfilled by the flusher. An
+   expired order is dropped before it is executed.
+*/
+void *trader_thread(void *arg);
+
+/**
+   Fulfill an order after the commit of its journal record at the sync
+   level. Called by the flusher thread of the journal, with a trader
+   argument that is used only by the flusher.
+*/
+void journal_durable(void *arg, const order_rec_t *rec, uint64_t now_ns);
+
+/**
+   Expire an order that is still queued at its deadline, and inform its
+   client. Called by the timer thread of the wheel under the lock of the
+   wheel, with the backend as argument.
+*/
+void order_expire(wheel_timer_t *timer, void *arg);
+
+#endif
@@ -0,0 +1,195 @@
+/**
+   workload.c
+
+   A configurable order workload for the bound-buf benchmark, including
+   1) a uniform, Zipf, or hotspot distribution of stock ids,
+   2) a configurable probability of BUY orders, and of urgent orders,
+   3) a uniform or bounded Pareto (heavy-tailed) distribution of order
+      quantities, and
+   4) a per-order service time, spent by a trader on a stock.
+
+   Zipf stock ids are drawn by a binary search in a table of cumulative
+   probabilities that is computed once by workload_init, where stock id 0
+   has rank 1. Bounded Pareto quantities are drawn by inverse transform
+   sampling.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "workload.h"
+#include "bound-buf.h"
+#include "utilities-mem.h"
+#include "utilities-rand.h"
+#include "utilities-time.h"
+
+static const double C_DEF_PROB_BUY = 0.5;
+
+/**
+   Parses a double that spans the whole string s. Returns 0 on success and
+   -1 on invalid input.
+*/
+static int parse_double(const char *s, double *d){
+  char *end = NULL;
+  if (*s == '\0') return -1;
+  *d = strtod(s, &end);
+  if (*end != '\0') return -1;
+  return 0;
+}
+
+void workload_defaults(workload_t *w){
+  memset(w, 0, sizeof(workload_t));
+  w->prob_buy = C_DEF_PROB_BUY;
+  w->prob_urgent = 0.0;
+  w->stock_dist = STOCK_UNIFORM;
+  w->quantity_dist = QUANTITY_UNIFORM;
+  w->service_ns = 0;
+  w->zipf_cdf = NULL;
+}
+
+int workload_parse_stock(workload_t *w, const char *s){
+  int n = 0;
+  if (strcmp(s, "uniform") == 0){
+    w->stock_dist = STOCK_UNIFORM;
+  }else if (strncmp(s, "zipf:", 5) == 0){
+    if (parse_double(s + 5, &w->zipf_s) != 0 || w->zipf_s <= 0.0) return -1;
+    w->stock_dist = STOCK_ZIPF;
+  }else if (strncmp(s, "hot:", 4) == 0){
+    if (sscanf(s, "hot:%lf:%lf%n", &w->hot_prob, &w->hot_frac, &n) != 2 ||
+	s[n] != '\0' ||
+	w->hot_prob < 0.0 || w->hot_prob > 1.0 ||
+	w->hot_frac <= 0.0 || w->hot_frac > 1.0){
+      return -1;
+    }
+    w->stock_dist = STOCK_HOTSPOT;
+  }else{
+    return -1;
+  }
+  return 0;
+}
+
+int workload_parse_quantity(workload_t *w, const char *s){
+  if (strcmp(s, "uniform") == 0){
+    w->quantity_dist = QUANTITY_UNIFORM;
+  }else if (strncmp(s, "pareto:", 7) == 0){
+    if (parse_double(s + 7, &w->pareto_alpha) != 0 ||
+	w->pareto_alpha <= 0.0){
+      return -1;
+    }
+    w->quantity_dist = QUANTITY_PARETO;
+  }else{
+    return -1;
+  }
+  return 0;
+}
+
+void workload_init(workload_t *w, int num_stocks, int quantity){
+  int i;
+  double sum = 0.0;
+  w->num_stocks = num_stocks;
+  w->quantity = quantity;
+  if (w->stock_dist == STOCK_ZIPF){
+    w->zipf_cdf = malloc_perror(num_stocks, sizeof(double));
+    for (i = 0; i < num_stocks; i++){
+      sum += 1.0 / pow(i + 1, w->zipf_s);
+      w->zipf_cdf[i] = sum;
+    }
+    for (i = 0; i < num_stocks; i++){
+      w->zipf_cdf[i] /= sum;
+    }
+    w->zipf_cdf[num_stocks - 1] = 1.0; /* no rounding past the last id */
+  }else if (w->stock_dist == STOCK_HOTSPOT){
+    w->num_hot = (int)(w->hot_frac * num_stocks + 0.5);
+    if (w->num_hot < 1) w->num_hot = 1;
+    if (w->num_hot > num_stocks) w->num_hot = num_stocks;
+  }
+}
+
+/**
+   Returns a stock id according to the stock distribution.
+*/
+static int next_stock(const workload_t *w, rng_t *rng){
+  int lo, hi, mid;
+  double u = rng_unif(rng);
+  switch (w->stock_dist){
+  case STOCK_ZIPF:
+    /* first id with a cumulative probability > u */
+    lo = 0;
+    hi = w->num_stocks - 1;
+    while (lo < hi){
+      mid = lo + (hi - lo) / 2;
+      if (w->zipf_cdf[mid] > u){
+	hi = mid;
+      }else{
+	lo = mid + 1;
+      }
+    }
+    return lo;
+  case STOCK_HOTSPOT:
+    if (u < w->hot_prob || w->num_hot == w->num_stocks){
+      return rng_unif(rng) * w->num_hot;
+    }
+    return w->num_hot + rng_unif(rng) * (w->num_stocks - w->num_hot);
+  default:
+    return u * w->num_stocks;
+  }
+}
+
+/**
+   Returns a quantity according to the quantity distribution.
+*/
+static int next_quantity(const workload_t *w, rng_t *rng){
+  double u = rng_unif(rng);
+  double x;
+  if (w->quantity_dist == QUANTITY_PARETO){
+    if (w->quantity <= 1) return w->quantity;
+    /* bounded Pareto on [1, quantity] */
+    x = pow(1.0 - u * (1.0 - pow(1.0 / w->quantity, w->pareto_alpha)),
+	    -1.0 / w->pareto_alpha);
+    return (x > w->quantity) ? w->quantity : (int)x;
+  }
+  return u * w->quantity;
+}
+
+void workload_next(const workload_t *w, rng_t *rng, order_t *order){
+  order->stock_id = next_stock(w, rng);
+  order->quantity = next_quantity(w, rng);
+  order->action = (rng_unif(rng) < w->prob_buy) ? BUY : SELL;
+  order->lane = (w->prob_urgent > 0.0 && rng_unif(rng) < w->prob_urgent) ?
+    LANE_URGENT : LANE_NORMAL;
+}
+
+void workload_service(const workload_t *w){
+  uint64_t start;
+  if (w->service_ns == 0) return;
+  start = time_mono_ns_perror();
+  while (time_mono_ns_perror() - start < w->service_ns);
+}
+
+void workload_print(const workload_t *w){
+  printf("workload: stocks ");
+  switch (w->stock_dist){
+  case STOCK_ZIPF:
+    printf("zipf:%g", w->zipf_s);
+    break;
+  case STOCK_HOTSPOT:
+    printf("hot:%g:%g (%d hot)", w->hot_prob, w->hot_frac, w->num_hot);
+    break;
+  default:
+    printf("uniform");
+  }
+  printf(", buy probability %g, urgent probability %g, quantities ",
+	 w->prob_buy, w->prob_urgent);
+  if (w->quantity_dist == QUANTITY_PARETO){
+    printf("pareto:%g", w->pareto_alpha);
+  }else{
+    printf("uniform");
+  }
+  printf(", service %lu ns\n", (unsigned long)w->service_ns);
+}
+
+void workload_free(workload_t *w){
+  free(w->zipf_cdf);
+  w->zipf_cdf = NULL;
+}
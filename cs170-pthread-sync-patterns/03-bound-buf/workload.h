@@ -0,0 +1,89 @@
+/**
+   workload.h
+
+   Declarations of a configurable order workload for the bound-buf
+   benchmark, including
+   1) a uniform, Zipf, or hotspot distribution of stock ids,
+   2) a configurable probability of BUY orders, and of urgent orders,
+   3) a uniform or bounded Pareto (heavy-tailed) distribution of order
+      quantities, and
+   4) a per-order service time, spent by a trader on a stock.
+
+   A workload is configured with workload_parse_stock and
+   workload_parse_quantity from option strings, and then initialized with
+   workload_init. An initialized workload is read-only and is shared by
+   all client threads, each drawing from its own generator state.
+*/
+
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <stdint.h>
+#include "bound-buf.h"
+#include "utilities-rand.h"
+
+typedef enum{STOCK_UNIFORM, STOCK_ZIPF, STOCK_HOTSPOT} stock_dist_t;
+typedef enum{QUANTITY_UNIFORM, QUANTITY_PARETO} quantity_dist_t;
+
+typedef struct{
+  int num_stocks;
+  int quantity; /* maximal quantity */
+  double prob_buy;
+  double prob_urgent;
+  stock_dist_t stock_dist;
+  double zipf_s; /* Zipf exponent, > 0 */
+  double hot_prob; /* probability that an order is for a hot stock */
+  double hot_frac; /* fraction of stocks that are hot */
+  int num_hot;
+  double *zipf_cdf; /* cumulative probabilities of stock ids */
+  quantity_dist_t quantity_dist;
+  double pareto_alpha; /* Pareto shape, > 0; smaller is heavier tailed */
+  uint64_t service_ns;
+} workload_t;
+
+/**
+   Set a uniform stock distribution, probability 0.5 of BUY orders, no
+   urgent orders, a uniform quantity distribution, and no service time.
+*/
+void workload_defaults(workload_t *w);
+
+/**
+   Parse a stock distribution in one of the formats
+   uniform, zipf:<s>, or hot:<hot_prob>:<hot_frac>
+   e.g. hot:0.9:0.1 for 90 percent of orders on 10 percent of stocks.
+   Returns 0 on success and -1 on invalid input.
+*/
+int workload_parse_stock(workload_t *w, const char *s);
+
+/**
+   Parse a quantity distribution in one of the formats
+   uniform, or pareto:<alpha>
+   where pareto is bounded to [1, quantity]. Returns 0 on success and -1
+   on invalid input.
+*/
+int workload_parse_quantity(workload_t *w, const char *s);
+
+/**
+   Initialize a configured workload for num_stocks stocks and a maximal
+   quantity.
+*/
+void workload_init(workload_t *w, int num_stocks, int quantity);
+
+/**
+   Produce the stock id, quantity, action, and lane of an order.
+*/
+void workload_next(const workload_t *w, rng_t *rng, order_t *order);
+
+/**
+   Spend the service time of an order by busy waiting.
+*/
+void workload_service(const workload_t *w);
+
+/**
+   Print a one-line description of a workload.
+*/
+void workload_print(const workload_t *w);
+
+void workload_free(workload_t *w);
+
+#endif
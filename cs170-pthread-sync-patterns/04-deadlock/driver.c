@@ -14,7 +14,15 @@
       a thread as parameters; the thread argument struct is moved to
       driver.c, where the thread entry function is defined,
    -  some variables are renamed or eliminated; some functions are
-      renamed.
+      renamed,
+   -  block times are measured with a monotonic nanosecond timer, summed
+      in nanoseconds, and reported in milliseconds, because blocking in
+      state_pickup is typically shorter than the one second resolution of
+      time(NULL) and often shorter than a millisecond,
+   -  state changes are written by each thread into its own ring of an
+      asynchronous log and formatted by the flusher thread of the log, so
+      that threads do not serialize on the lock of stdout; timestamps are
+      in seconds since the start.
 */
 
 #define _XOPEN_SOURCE 600
@@ -27,6 +35,8 @@
 #include "deadlock.h"
 #include "utilities-mem.h"
 #include "utilities-pthread.h"
+#include "utilities-time.h"
+#include "utilities-log.h"
 
 #define RANDOM_SEED() do{srandom(time(NULL));}while (0)
 #define RANDOM() (random()) /* basic Linux random number generator */
@@ -35,48 +45,47 @@
 typedef enum{FALSE, TRUE} boolean_t;
 
 const int C_PRINT_INTERVAL = 10;
+const uint64_t C_NS_PER_MS = 1000000;
+const int C_LOG_RING_COUNT = 64;
+const char *C_LOG_THINKING = "Philosopher %ld thinking for %ld seconds\n";
+const char *C_LOG_PICKUP = "Philosopher %ld calling state_pickup\n";
+const char *C_LOG_EATING = "Philosopher %ld eating for %ld seconds\n";
+const char *C_LOG_PUTDOWN = "Philosopher %ld calling state_putdown\n";
 const char *C_USAGE = "./executable num_phil_threads max_dur";
 
 typedef struct{
   int id;
   int num_phil_threads;
-  long start_time;
   long max_dur; /* max time for thinking/eating */
-  long *block_times; /* total time each thread is blocked */
+  uint64_t *block_times; /* total time in ns each thread is blocked */
   void *state; /* synchronization state wrt pickup and putdown ops */
   pthread_mutex_t *lock_block_times; /* updating and printing */
+  log_t *log; /* ring id is id */
 } phil_arg_t;
 
 void *phil_thread(void *arg){
   long t;
+  uint64_t t_ns;
   phil_arg_t *pa = arg;
   while (TRUE){
     /* think */
     t = RANDOM() % pa->max_dur + 1; /* at least 1 */
-    printf("%3ld Philosopher %d thinking for %ld seconds\n", 
-                time(NULL) - pa->start_time, pa->id, t);
-    fflush(stdout);
+    log_write(pa->log, pa->id, C_LOG_THINKING, pa->id, t, 0, 0);
     sleep(t);
     /* pick up */
-    printf("%3ld Philosopher %d calling state_pickup\n", 
-            time(NULL) - pa->start_time, pa->id);
-    fflush(stdout);
-    t = time(NULL);
+    log_write(pa->log, pa->id, C_LOG_PICKUP, pa->id, 0, 0, 0);
+    t_ns = time_mono_ns_perror();
     state_pickup(pa->state, pa->id);
-    t = time(NULL) - t;
+    t_ns = time_mono_ns_perror() - t_ns;
     mutex_lock_perror(pa->lock_block_times);
-    pa->block_times[pa->id] += t;
+    pa->block_times[pa->id] += t_ns;
     mutex_unlock_perror(pa->lock_block_times);
     /* eat */
     t = RANDOM() % pa->max_dur + 1; /* at least 1 */
-    printf("%3ld Philosopher %d eating for %ld seconds\n", 
-                time(NULL) - pa->start_time, pa->id, t);
-    fflush(stdout);
+    log_write(pa->log, pa->id, C_LOG_EATING, pa->id, t, 0, 0);
     sleep(t);
     /* put down */
-    printf("%3ld Philosopher %d calling state_putdown\n", 
-            time(NULL) - pa->start_time, pa->id);
-    fflush(stdout);
+    log_write(pa->log, pa->id, C_LOG_PUTDOWN, pa->id, 0, 0, 0);
     state_putdown(pa->state, pa->id);
   }
 }
@@ -87,12 +96,13 @@ int main(int argc, char **argv){
   int i, num_phil_threads;
   long max_dur;
   long start_time = time(NULL);
-  long *block_times = NULL;
-  long total_block_time = 0;
+  uint64_t *block_times = NULL;
+  uint64_t total_block_time = 0; /* ns */
   void *state = NULL;
   pthread_t *pids = NULL;
   phil_arg_t *pas = NULL;
   pthread_mutex_t lock_block_times;
+  log_t log;
   RANDOM_SEED();
   if (argc != 3) {
     fprintf(stderr, "usage: %s\n", C_USAGE);
@@ -110,18 +120,19 @@ int main(int argc, char **argv){
     fprintf(stderr, "maximal eating/thinking duration must be positive\n");
     exit(EXIT_FAILURE);
   }
-  block_times = calloc_perror(num_phil_threads, sizeof(long));
+  block_times = calloc_perror(num_phil_threads, sizeof(uint64_t));
   pids = malloc_perror(num_phil_threads, sizeof(pthread_t));
   pas = malloc_perror(num_phil_threads, sizeof(phil_arg_t));
   state = state_new(num_phil_threads);
   mutex_init_perror(&lock_block_times);
+  log_init_perror(&log, num_phil_threads, C_LOG_RING_COUNT, stdout);
   for (i = 0; i < num_phil_threads; i++){
     pas[i].id = i;
-    pas[i].start_time = start_time;;
     pas[i].max_dur = max_dur;
     pas[i].block_times = block_times;
     pas[i].state = state;
     pas[i].lock_block_times = &lock_block_times;
+    pas[i].log = &log;
     thread_create_perror(&pids[i], phil_thread, &pas[i]);
   }
   while (TRUE){
@@ -131,11 +142,12 @@ int main(int argc, char **argv){
     for(i = 0; i < num_phil_threads; i++){
       total_block_time += block_times[i];
     }
-    sprintf(cur,"%3ld Total blocktime: %5ld : ",
-	    time(NULL) - start_time, total_block_time);
+    sprintf(cur,"%3ld Total blocktime (ms): %7lu : ",
+	    time(NULL) - start_time,
+	    (unsigned long)(total_block_time / C_NS_PER_MS));
     cur = s + strlen(s);
     for(i = 0; i < num_phil_threads; i++){
-    	sprintf(cur, "%5ld ", block_times[i]);
+    	sprintf(cur, "%7lu ", (unsigned long)(block_times[i] / C_NS_PER_MS));
 	cur = s + strlen(s);
     }
     mutex_unlock_perror(&lock_block_times);
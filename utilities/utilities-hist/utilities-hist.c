@@ -0,0 +1,106 @@
+/**
+   utilities-hist.c
+
+   Utility functions for a log-linear histogram of 64-bit values, e.g.
+   latencies in nanoseconds, with a bounded relative error of quantiles.
+
+   With s = HIST_SUB_BITS, the values in [0, 2^(s + 1)) are counted
+   exactly. A value v >= 2^(s + 1) with the most significant bit at
+   position p is counted in the bucket of the s + 1 bits m = v >> (p - s),
+   i.e. buckets are linear within each power of two, resulting in
+   (65 - s) * 2^s buckets.
+*/
+
+#include <stdlib.h>
+#include <stdint.h>
+#include "utilities-hist.h"
+#include "utilities-mem.h"
+
+static const int C_SUB_COUNT = 1 << HIST_SUB_BITS;
+static const int C_NUM_BUCKETS = HIST_NUM_BUCKETS;
+
+static int bucket_index(uint64_t v){
+  int shift;
+  if (v < (uint64_t)(2 * C_SUB_COUNT)) return (int)v;
+  shift = 63 - __builtin_clzll(v) - HIST_SUB_BITS;
+  return shift * C_SUB_COUNT + (int)(v >> shift);
+}
+
+static uint64_t bucket_upper(int i){
+  int shift;
+  uint64_t m;
+  if (i < 2 * C_SUB_COUNT) return (uint64_t)i;
+  shift = i / C_SUB_COUNT - 1;
+  m = C_SUB_COUNT + i % C_SUB_COUNT;
+  return ((m + 1) << shift) - 1;
+}
+
+/**
+   Initialize an empty histogram, and free the buckets of a histogram.
+*/
+
+void hist_init(hist_t *h){
+  h->count = 0;
+  h->min = (uint64_t)-1;
+  h->max = 0;
+  h->sum = 0.0;
+  h->buckets = calloc_perror(C_NUM_BUCKETS, sizeof(uint64_t));
+}
+
+void hist_free(hist_t *h){
+  free(h->buckets);
+  h->buckets = NULL;
+}
+
+/**
+   Record a value.
+*/
+void hist_add(hist_t *h, uint64_t v){
+  h->buckets[bucket_index(v)]++;
+  h->count++;
+  h->sum += v;
+  if (v < h->min) h->min = v;
+  if (v > h->max) h->max = v;
+}
+
+/**
+   Add the counts of src to dst.
+*/
+void hist_merge(hist_t *dst, const hist_t *src){
+  int i;
+  for (i = 0; i < C_NUM_BUCKETS; i++){
+    dst->buckets[i] += src->buckets[i];
+  }
+  dst->count += src->count;
+  dst->sum += src->sum;
+  if (src->min < dst->min) dst->min = src->min;
+  if (src->max > dst->max) dst->max = src->max;
+}
+
+/**
+   Return the value at quantile q, i.e. the upper bound of the bucket of
+   the value, bounded by the maximal recorded value.
+*/
+uint64_t hist_quantile(const hist_t *h, double q){
+  int i;
+  uint64_t rank;
+  uint64_t n = 0;
+  if (h->count == 0) return 0;
+  if (q <= 0.0) return h->min;
+  rank = (uint64_t)(q * h->count);
+  if (rank < q * h->count) rank++; /* ceiling */
+  if (rank > h->count) rank = h->count;
+  for (i = 0; i < C_NUM_BUCKETS; i++){
+    n += h->buckets[i];
+    if (n >= rank) break;
+  }
+  return (bucket_upper(i) < h->max) ? bucket_upper(i) : h->max;
+}
+
+/**
+   Return the mean of the recorded values.
+*/
+double hist_mean(const hist_t *h){
+  if (h->count == 0) return 0.0;
+  return h->sum / h->count;
+}
@@ -0,0 +1,60 @@
+/**
+   utilities-hist.h
+
+   Declarations of accessible utility functions for a log-linear histogram
+   of 64-bit values, e.g. latencies in nanoseconds, with a bounded relative
+   error of quantiles. A value is counted in a bucket determined by the
+   position of its most significant bit and the HIST_SUB_BITS bits that
+   follow it, resulting in a relative error of at most 2^-HIST_SUB_BITS.
+
+   A histogram is not synchronized. Each thread records into its own
+   histogram, and the histograms are merged after the threads are joined.
+*/
+
+#ifndef UTILITIES_HIST_H
+#define UTILITIES_HIST_H
+
+#include <stdint.h>
+
+#define HIST_SUB_BITS (5) /* used as int */
+#define HIST_NUM_BUCKETS ((65 - HIST_SUB_BITS) << HIST_SUB_BITS)
+
+typedef struct{
+  uint64_t count;
+  uint64_t min;
+  uint64_t max;
+  double sum;
+  uint64_t *buckets; /* HIST_NUM_BUCKETS counts */
+} hist_t;
+
+/**
+   Initialize an empty histogram, and free the buckets of a histogram.
+*/
+
+void hist_init(hist_t *h);
+
+void hist_free(hist_t *h);
+
+/**
+   Record a value.
+*/
+void hist_add(hist_t *h, uint64_t v);
+
+/**
+   Add the counts of src to dst.
+*/
+void hist_merge(hist_t *dst, const hist_t *src);
+
+/**
+   Return the value at quantile q in [0.0, 1.0], i.e. the upper bound of
+   the bucket of the value, or 0 if the histogram is empty.
+*/
+uint64_t hist_quantile(const hist_t *h, double q);
+
+/**
+   Return the mean of the recorded values, or 0.0 if the histogram is
+   empty.
+*/
+double hist_mean(const hist_t *h);
+
+#endif
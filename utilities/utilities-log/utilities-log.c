@@ -0,0 +1,169 @@
+/**
+   utilities-log.c
+
+   Utility functions for asynchronous logging. Each thread writes
+   fixed-size binary records into its own single-producer single-consumer
+   ring without locks and without system calls, and a background flusher
+   thread merges the rings in timestamp order, formats the records, and
+   writes them to a stream. If a ring is full, a record is dropped and
+   counted instead of blocking the writing thread.
+
+   The tail of a ring is published with a release store by the owning
+   thread after a record is written, and the head is published with a
+   release store by the flusher thread after a record is formatted, so that
+   a slot is never read and written concurrently. The head and tail are on
+   separate cache lines.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include "utilities-log.h"
+#include "utilities-mem.h"
+#include "utilities-pthread.h"
+#include "utilities-time.h"
+
+static const long C_FLUSH_INTERVAL_NS = 1000000;
+static const double C_NS_PER_SEC = 1000000000.0;
+
+/**
+   Write all records that are currently in the rings, in timestamp order
+   across the rings. Returns the number of written records.
+*/
+static unsigned long log_drain(log_t *log){
+  int i, min_i;
+  unsigned long n = 0;
+  unsigned long head;
+  unsigned long *tails = log->tails;
+  log_rec_t *rec = NULL;
+  log_rec_t *min_rec = NULL;
+  for (i = 0; i < log->num_rings; i++){
+    tails[i] = __atomic_load_n(&log->rings[i].tail, __ATOMIC_ACQUIRE);
+  }
+  while (1){
+    min_i = -1;
+    min_rec = NULL;
+    for (i = 0; i < log->num_rings; i++){
+      head = log->rings[i].head;
+      if (head == tails[i]) continue;
+      rec = &log->rings[i].recs[head & log->mask];
+      if (min_rec == NULL || rec->time_ns < min_rec->time_ns){
+	min_i = i;
+	min_rec = rec;
+      }
+    }
+    if (min_rec == NULL) break;
+    fprintf(log->stream, "%10.6f ",
+	    (min_rec->time_ns - log->start_ns) / C_NS_PER_SEC);
+    fprintf(log->stream, min_rec->fmt,
+	    min_rec->args[0],
+	    min_rec->args[1],
+	    min_rec->args[2],
+	    min_rec->args[3]);
+    __atomic_store_n(&log->rings[min_i].head,
+		     log->rings[min_i].head + 1,
+		     __ATOMIC_RELEASE);
+    n++;
+  }
+  if (n > 0) fflush(log->stream);
+  return n;
+}
+
+/**
+   Drains the rings until done is set and the rings are empty. Sleeps
+   for a flush interval if the rings are empty.
+*/
+static void *flusher_thread(void *arg){
+  struct timespec ts;
+  log_t *log = arg;
+  ts.tv_sec = 0;
+  ts.tv_nsec = C_FLUSH_INTERVAL_NS;
+  while (1){
+    if (__atomic_load_n(&log->done, __ATOMIC_ACQUIRE)){
+      /* records written before done was set are visible */
+      while (log_drain(log) > 0);
+      return NULL;
+    }
+    if (log_drain(log) == 0) nanosleep(&ts, NULL);
+  }
+}
+
+/**
+   Initialize a log and start a flusher thread.
+*/
+void log_init_perror(log_t *log, int num_rings, int ring_count, FILE *stream){
+  int i;
+  unsigned long count = 1;
+  while (count < (unsigned long)ring_count) count *= 2;
+  log->num_rings = num_rings;
+  log->done = 0;
+  log->mask = count - 1;
+  log->start_ns = time_mono_ns_perror();
+  log->stream = stream;
+  log->rings = calloc_perror(num_rings, sizeof(log_ring_t));
+  log->tails = malloc_perror(num_rings, sizeof(unsigned long));
+  for (i = 0; i < num_rings; i++){
+    log->rings[i].recs = malloc_perror(count, sizeof(log_rec_t));
+  }
+  thread_create_perror(&log->flusher, flusher_thread, log);
+}
+
+/**
+   Write a record into the ring with ring id.
+*/
+void log_write(log_t *log,
+	       int id,
+	       const char *fmt,
+	       long a0, long a1, long a2, long a3){
+  log_ring_t *ring = &log->rings[id];
+  log_rec_t *rec = NULL;
+  unsigned long tail = ring->tail;
+  if (tail - ring->head_cache > log->mask){
+    ring->head_cache = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    if (tail - ring->head_cache > log->mask){
+      __atomic_store_n(&ring->num_dropped,
+		       ring->num_dropped + 1,
+		       __ATOMIC_RELAXED);
+      return;
+    }
+  }
+  rec = &ring->recs[tail & log->mask];
+  rec->time_ns = time_mono_ns_perror();
+  rec->fmt = fmt;
+  rec->args[0] = a0;
+  rec->args[1] = a1;
+  rec->args[2] = a2;
+  rec->args[3] = a3;
+  __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+}
+
+/**
+   Return the total number of dropped records across all rings.
+*/
+unsigned long log_num_dropped(log_t *log){
+  int i;
+  unsigned long n = 0;
+  for (i = 0; i < log->num_rings; i++){
+    n += __atomic_load_n(&log->rings[i].num_dropped, __ATOMIC_RELAXED);
+  }
+  return n;
+}
+
+/**
+   Stop the flusher thread and free the rings.
+*/
+void log_free_perror(log_t *log){
+  int i;
+  __atomic_store_n(&log->done, 1, __ATOMIC_RELEASE);
+  thread_join_perror(log->flusher, NULL);
+  for (i = 0; i < log->num_rings; i++){
+    free(log->rings[i].recs);
+    log->rings[i].recs = NULL;
+  }
+  free(log->rings);
+  free(log->tails);
+  log->rings = NULL;
+  log->tails = NULL;
+}
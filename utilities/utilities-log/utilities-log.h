@@ -0,0 +1,83 @@
+/**
+   utilities-log.h
+
+   Declarations of accessible utility functions for asynchronous logging.
+   Each thread writes fixed-size binary records into its own single-producer
+   single-consumer ring without locks and without system calls, and a
+   background flusher thread merges the rings in timestamp order, formats
+   the records, and writes them to a stream. If a ring is full, a record is
+   dropped and counted instead of blocking the writing thread.
+
+   A record consists of a timestamp, a pointer to a format string with
+   static storage duration (e.g. a string literal), and LOG_NUM_ARGS long
+   arguments. The format string must only reference long arguments (%ld,
+   %lu, %lx) because the arguments are passed to the formatting function
+   as long values.
+*/
+
+#ifndef UTILITIES_LOG_H
+#define UTILITIES_LOG_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <pthread.h>
+
+#define LOG_NUM_ARGS (4) /* used as int */
+#define LOG_CACHE_LINE (64) /* used as int */
+
+typedef struct{
+  uint64_t time_ns;
+  const char *fmt;
+  long args[LOG_NUM_ARGS];
+} log_rec_t;
+
+typedef struct{
+  unsigned long tail; /* written only by the owning thread */
+  unsigned long head_cache; /* owner's copy of head to reduce sharing */
+  unsigned long num_dropped; /* written only by the owning thread */
+  char pad0[LOG_CACHE_LINE - 3 * sizeof(unsigned long)];
+  unsigned long head; /* written only by the flusher thread */
+  char pad1[LOG_CACHE_LINE - sizeof(unsigned long)];
+  log_rec_t *recs;
+} log_ring_t;
+
+typedef struct{
+  int num_rings;
+  int done; /* accessed atomically */
+  unsigned long mask; /* ring count - 1, ring count is a power of two */
+  uint64_t start_ns; /* timestamps are reported relative to start_ns */
+  log_ring_t *rings;
+  unsigned long *tails; /* flusher's snapshot of the tails of the rings */
+  FILE *stream;
+  pthread_t flusher;
+} log_t;
+
+/**
+   Initialize a log with num_rings rings, each with at least ring_count
+   records, and start a flusher thread that writes to stream. Ring id is
+   in [0, num_rings) and each ring must have at most one writing thread.
+*/
+void log_init_perror(log_t *log, int num_rings, int ring_count, FILE *stream);
+
+/**
+   Write a record into the ring with ring id. Does not block and does not
+   acquire a lock.
+*/
+void log_write(log_t *log,
+	       int id,
+	       const char *fmt,
+	       long a0, long a1, long a2, long a3);
+
+/**
+   Return the total number of dropped records across all rings. The result
+   is exact after all writing threads are joined.
+*/
+unsigned long log_num_dropped(log_t *log);
+
+/**
+   Stop the flusher thread after it writes all remaining records, and free
+   the rings. The log struct is not freed.
+*/
+void log_free_perror(log_t *log);
+
+#endif
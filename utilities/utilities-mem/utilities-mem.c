@@ -6,6 +6,7 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <errno.h>
 #include "utilities-mem.h"
 
 static const size_t C_SIZE_MAX = (size_t)-1;
@@ -78,3 +79,23 @@ void *calloc_perror(size_t num, size_t size){
   }
   return ptr;
 }
+
+/**
+   Malloc of a block that is aligned to align bytes, with wrapped error
+   checking, including integer overflow checking.
+*/
+void *malloc_align_perror(size_t align, size_t num, size_t size){
+  int err;
+  void *ptr = NULL;
+  if (num > C_SIZE_MAX / size){
+    perror("posix_memalign integer overflow");
+    exit(EXIT_FAILURE);
+  }
+  err = posix_memalign(&ptr, align, num * size);
+  if (err != 0){
+    errno = err;
+    perror("posix_memalign failed");
+    exit(EXIT_FAILURE);
+  }
+  return ptr;
+}
@@ -30,4 +30,11 @@ void *realloc_perror(void *ptr, size_t num, size_t size);
 
 void *calloc_perror(size_t num, size_t size);
 
+/**
+   Malloc of a block that is aligned to align bytes, with wrapped error
+   checking, including integer overflow checking. align is a power of two
+   multiple of sizeof(void *). The block is freed with free.
+*/
+void *malloc_align_perror(size_t align, size_t num, size_t size);
+
 #endif
@@ -5,15 +5,33 @@
    1) pthread functions with wrapped error checking, and
    2) an implementation of semaphore operations based on 1),
    adopted from The Little Book of Semaphores by Allen B. Downey
-   (Version 2.2.1) with modifications.
+   (Version 2.2.1) with modifications, and
+   3) a one-shot completion (latch) of a single 32-bit word, with an
+   optional spin before sleeping on a futex on Linux. On other platforms
+   a waiting thread yields instead of sleeping, and
+   4) a hierarchical timing wheel of one-shot timers, driven by a timer
+   thread.
 */
 
 #include <unistd.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <sched.h>
 #include <pthread.h>
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#endif
 #include "utilities-pthread.h"
 
+static const uint64_t C_NS_PER_SEC = 1000000000;
+static const uint32_t C_LATCH_UNSET = 0;
+static const uint32_t C_LATCH_SET = 1;
+static const uint32_t C_LATCH_SLEEPING = 2; /* unset with a sleeping waiter */
+
 /**
    Create a thread with default attributes and error checking. Join a thread
    with error checking.
@@ -68,7 +86,8 @@ void mutex_unlock_perror(pthread_mutex_t *mutex){
 
 /**
    Initialize a condition variable with default attributes and
-   error checking. Wait on and signal a condition with error checking.
+   error checking. Wait on, signal, and broadcast a condition with error
+   checking.
 */
 
 void cond_init_perror(pthread_cond_t *cond){
@@ -95,6 +114,173 @@ void cond_signal_perror(pthread_cond_t *cond){
   }
 }
 
+void cond_broadcast_perror(pthread_cond_t *cond){
+  int err = pthread_cond_broadcast(cond);
+  if (err != 0){
+    perror("pthread_cond_broadcast failed");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/**
+   Initialize a condition variable for timed waits on the monotonic clock,
+   and wait on it until a deadline, with error checking.
+*/
+
+void cond_init_mono_perror(pthread_cond_t *cond){
+  int err;
+  pthread_condattr_t attr;
+  err = pthread_condattr_init(&attr);
+  if (err != 0){
+    errno = err;
+    perror("pthread_condattr_init failed");
+    exit(EXIT_FAILURE);
+  }
+  err = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  if (err != 0){
+    errno = err;
+    perror("pthread_condattr_setclock failed");
+    exit(EXIT_FAILURE);
+  }
+  err = pthread_cond_init(cond, &attr);
+  if (err != 0){
+    errno = err;
+    perror("pthread_cond_init failed");
+    exit(EXIT_FAILURE);
+  }
+  pthread_condattr_destroy(&attr);
+}
+
+int cond_timedwait_mono_perror(pthread_cond_t *cond,
+			       pthread_mutex_t *mutex,
+			       uint64_t deadline_ns){
+  int err;
+  struct timespec ts;
+  ts.tv_sec = deadline_ns / C_NS_PER_SEC;
+  ts.tv_nsec = deadline_ns % C_NS_PER_SEC;
+  err = pthread_cond_timedwait(cond, mutex, &ts);
+  if (err == ETIMEDOUT) return -1;
+  if (err != 0){
+    errno = err;
+    perror("pthread_cond_timedwait failed");
+    exit(EXIT_FAILURE);
+  }
+  return 0;
+}
+
+/**
+   Initialize a mutex and a condition variable that are shared between
+   processes, with error checking. The mutex is robust, and the condition
+   variable waits on the monotonic clock. A robust mutex whose owner died
+   is made consistent by the next thread that acquires it.
+*/
+
+void mutex_init_pshared_perror(pthread_mutex_t *mutex){
+  int err;
+  pthread_mutexattr_t attr;
+  err = pthread_mutexattr_init(&attr);
+  if (err != 0){
+    errno = err;
+    perror("pthread_mutexattr_init failed");
+    exit(EXIT_FAILURE);
+  }
+  err = pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+  if (err != 0){
+    errno = err;
+    perror("pthread_mutexattr_setpshared failed");
+    exit(EXIT_FAILURE);
+  }
+  err = pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+  if (err != 0){
+    errno = err;
+    perror("pthread_mutexattr_setrobust failed");
+    exit(EXIT_FAILURE);
+  }
+  err = pthread_mutex_init(mutex, &attr);
+  if (err != 0){
+    errno = err;
+    perror("pthread_mutex_init failed");
+    exit(EXIT_FAILURE);
+  }
+  pthread_mutexattr_destroy(&attr);
+}
+
+void cond_init_pshared_perror(pthread_cond_t *cond){
+  int err;
+  pthread_condattr_t attr;
+  err = pthread_condattr_init(&attr);
+  if (err != 0){
+    errno = err;
+    perror("pthread_condattr_init failed");
+    exit(EXIT_FAILURE);
+  }
+  err = pthread_condattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+  if (err != 0){
+    errno = err;
+    perror("pthread_condattr_setpshared failed");
+    exit(EXIT_FAILURE);
+  }
+  err = pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+  if (err != 0){
+    errno = err;
+    perror("pthread_condattr_setclock failed");
+    exit(EXIT_FAILURE);
+  }
+  err = pthread_cond_init(cond, &attr);
+  if (err != 0){
+    errno = err;
+    perror("pthread_cond_init failed");
+    exit(EXIT_FAILURE);
+  }
+  pthread_condattr_destroy(&attr);
+}
+
+/**
+   Returns 1 after marking a robust mutex consistent if err is EOWNERDEAD,
+   i.e. the mutex was acquired after its owner died, and 0 if err is 0.
+*/
+static int robust_check_perror(pthread_mutex_t *mutex,
+			       int err,
+			       const char *msg){
+  if (err == EOWNERDEAD){
+    err = pthread_mutex_consistent(mutex);
+    if (err != 0){
+      errno = err;
+      perror("pthread_mutex_consistent failed");
+      exit(EXIT_FAILURE);
+    }
+    return 1;
+  }
+  if (err != 0){
+    errno = err;
+    perror(msg);
+    exit(EXIT_FAILURE);
+  }
+  return 0;
+}
+
+int mutex_lock_robust_perror(pthread_mutex_t *mutex){
+  return robust_check_perror(mutex, pthread_mutex_lock(mutex),
+			     "pthread_mutex_lock failed");
+}
+
+int cond_wait_robust_perror(pthread_cond_t *cond, pthread_mutex_t *mutex){
+  return robust_check_perror(mutex, pthread_cond_wait(cond, mutex),
+			     "pthread_cond_wait failed");
+}
+
+int cond_timedwait_robust_perror(pthread_cond_t *cond,
+				 pthread_mutex_t *mutex,
+				 uint64_t deadline_ns){
+  int err;
+  struct timespec ts;
+  ts.tv_sec = deadline_ns / C_NS_PER_SEC;
+  ts.tv_nsec = deadline_ns % C_NS_PER_SEC;
+  err = pthread_cond_timedwait(cond, mutex, &ts);
+  if (err == ETIMEDOUT) return -1;
+  return robust_check_perror(mutex, err, "pthread_cond_timedwait failed");
+}
+
 /**
    Initialize, wait on, and signal a semaphore with error checking
    provided by mutex and condition variable operations.
@@ -129,3 +315,301 @@ void sema_signal_perror(sema_t *sema){
   }
   mutex_unlock_perror(&sema->mutex);
 }
+
+int sema_trywait_n_perror(sema_t *sema, int n){
+  int k = 0;
+  mutex_lock_perror(&sema->mutex);
+  if (sema->value > 0){
+    /* no waiting threads; the value remains non-negative */
+    k = (sema->value < n) ? sema->value : n;
+    sema->value -= k;
+  }
+  mutex_unlock_perror(&sema->mutex);
+  return k;
+}
+
+void sema_signal_n_perror(sema_t *sema, int n){
+  int i;
+  mutex_lock_perror(&sema->mutex);
+  for (i = 0; i < n; i++){
+    sema->value++;
+    if (sema->value <= 0){
+      sema->num_wakeups++;
+      cond_signal_perror(&sema->cond);
+    }
+  }
+  mutex_unlock_perror(&sema->mutex);
+}
+
+/**
+   Hint to the processor that the calling thread is in a spin-wait loop.
+*/
+void cpu_pause(void){
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#else
+  __atomic_signal_fence(__ATOMIC_SEQ_CST);
+#endif
+}
+
+/**
+   Initialize, wait on, set, and reset a one-shot latch for one waiting
+   thread. The waiting thread announces that it sleeps by exchanging
+   unset for sleeping, so that a setting thread issues a wakeup system
+   call only if the previous state was sleeping.
+*/
+
+void latch_init(latch_t *latch){
+  latch->state = C_LATCH_UNSET;
+}
+
+static void futex_wait_perror(uint32_t *addr, uint32_t val){
+#ifdef __linux__
+  if (syscall(SYS_futex, addr, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0) != 0 &&
+      errno != EAGAIN &&
+      errno != EINTR){
+    perror("futex wait failed");
+    exit(EXIT_FAILURE);
+  }
+#else
+  (void)addr;
+  (void)val;
+  sched_yield();
+#endif
+}
+
+static void futex_wake_perror(uint32_t *addr){
+#ifdef __linux__
+  if (syscall(SYS_futex, addr, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0) < 0){
+    perror("futex wake failed");
+    exit(EXIT_FAILURE);
+  }
+#else
+  (void)addr;
+#endif
+}
+
+void latch_wait_perror(latch_t *latch, int num_spins){
+  int i;
+  uint32_t expected = C_LATCH_UNSET;
+  for (i = 0; i < num_spins; i++){
+    if (__atomic_load_n(&latch->state, __ATOMIC_ACQUIRE) == C_LATCH_SET){
+      return;
+    }
+    cpu_pause();
+  }
+  if (!__atomic_compare_exchange_n(&latch->state, &expected,
+				   C_LATCH_SLEEPING, 0,
+				   __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)){
+    return; /* expected is set */
+  }
+  while (__atomic_load_n(&latch->state, __ATOMIC_ACQUIRE) != C_LATCH_SET){
+    futex_wait_perror(&latch->state, C_LATCH_SLEEPING);
+  }
+}
+
+void latch_set_perror(latch_t *latch){
+  if (__atomic_exchange_n(&latch->state, C_LATCH_SET, __ATOMIC_RELEASE) ==
+      C_LATCH_SLEEPING){
+    futex_wake_perror(&latch->state);
+  }
+}
+
+void latch_reset(latch_t *latch){
+  __atomic_store_n(&latch->state, C_LATCH_UNSET, __ATOMIC_RELAXED);
+}
+
+/**
+   Hierarchical timing wheel. A slot of level l spans WHEEL_SLOTS^l ticks,
+   and a timer that expires delta ticks after the next tick is placed in
+   the lowest level l with delta < WHEEL_SLOTS^(l + 1), in the slot of the
+   bits [l * WHEEL_BITS, (l + 1) * WHEEL_BITS) of its expiry tick. When
+   the next tick is the first tick of a slot of a level l > 0, the timers
+   of the slot are placed again, in a lower level (cascaded), before the
+   timers of the slot of the tick in level 0 are expired. A timer beyond
+   the range of the wheel is placed in the farthest slot of the top level,
+   and is placed again when it is cascaded.
+
+   The timer thread sleeps until the next tick while timers are armed,
+   and otherwise until a timer is added. The ticks of an empty wheel are
+   skipped by advancing the next tick when a timer is added.
+*/
+
+static const uint64_t C_WHEEL_RANGE = (uint64_t)1 << (WHEEL_BITS *
+							WHEEL_LEVELS);
+
+static uint64_t wheel_now_ns_perror(void){
+  struct timespec ts;
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0){
+    perror("clock_gettime failed");
+    exit(EXIT_FAILURE);
+  }
+  return (uint64_t)ts.tv_sec * C_NS_PER_SEC + ts.tv_nsec;
+}
+
+static uint64_t wheel_due_ns(const wheel_t *wheel){
+  return wheel->start_ns + wheel->tick * wheel->tick_ns;
+}
+
+static void wheel_unlink(wheel_timer_t *timer){
+  timer->prev->next = timer->next;
+  timer->next->prev = timer->prev;
+  timer->prev = NULL;
+  timer->next = NULL;
+}
+
+/**
+   Places a timer at the tail of the slot that covers its expiry. Requires
+   holding the lock of the wheel.
+*/
+static void wheel_place(wheel_t *wheel, wheel_timer_t *timer){
+  int level = 0;
+  uint64_t delta;
+  uint64_t tick = wheel->tick;
+  wheel_timer_t *head = NULL;
+  if (timer->expiry_ns > wheel->start_ns){
+    /* the first tick at or after the expiry */
+    tick = ((timer->expiry_ns - wheel->start_ns + wheel->tick_ns - 1) /
+	    wheel->tick_ns);
+    if (tick < wheel->tick) tick = wheel->tick;
+  }
+  delta = tick - wheel->tick;
+  if (delta >= C_WHEEL_RANGE){
+    delta = C_WHEEL_RANGE - 1;
+    tick = wheel->tick + delta;
+  }
+  while ((delta >> (WHEEL_BITS * (level + 1))) != 0) level++;
+  head = &wheel->slots[level][(tick >> (WHEEL_BITS * level)) &
+			      (WHEEL_SLOTS - 1)];
+  timer->prev = head->prev;
+  timer->next = head;
+  head->prev->next = timer;
+  head->prev = timer;
+}
+
+/**
+   Cascades the slots that start at the next tick, and expires the timers
+   of the next tick. Requires holding the lock of the wheel.
+*/
+static void wheel_tick(wheel_t *wheel){
+  int level;
+  uint64_t t = wheel->tick;
+  wheel_timer_t *head = NULL;
+  wheel_timer_t *timer = NULL;
+  for (level = 1; level < WHEEL_LEVELS; level++){
+    if ((t & (((uint64_t)1 << (WHEEL_BITS * level)) - 1)) != 0) break;
+    head = &wheel->slots[level][(t >> (WHEEL_BITS * level)) &
+				(WHEEL_SLOTS - 1)];
+    while (head->next != head){
+      timer = head->next;
+      wheel_unlink(timer);
+      wheel_place(wheel, timer);
+      wheel->num_cascades++;
+    }
+  }
+  head = &wheel->slots[0][t & (WHEEL_SLOTS - 1)];
+  while (head->next != head){
+    timer = head->next;
+    wheel_unlink(timer);
+    wheel->num_armed--;
+    wheel->num_expiries++;
+    wheel->expire(timer, wheel->arg);
+  }
+  wheel->tick = t + 1;
+  wheel->num_ticks++;
+}
+
+static void *wheel_thread(void *arg){
+  uint64_t now;
+  wheel_t *wheel = arg;
+  mutex_lock_perror(&wheel->lock);
+  while (!wheel->done){
+    if (wheel->num_armed == 0){
+      cond_wait_perror(&wheel->cond, &wheel->lock);
+      continue;
+    }
+    now = wheel_now_ns_perror();
+    while (wheel->num_armed > 0 && wheel_due_ns(wheel) <= now){
+      wheel_tick(wheel);
+    }
+    if (wheel->num_armed > 0){
+      cond_timedwait_mono_perror(&wheel->cond, &wheel->lock,
+				 wheel_due_ns(wheel));
+    }
+  }
+  mutex_unlock_perror(&wheel->lock);
+  return NULL;
+}
+
+void wheel_timer_init(wheel_timer_t *timer){
+  timer->prev = NULL;
+  timer->next = NULL;
+  timer->expiry_ns = 0;
+}
+
+void wheel_init_perror(wheel_t *wheel,
+		       uint64_t tick_ns,
+		       void (*expire)(wheel_timer_t *timer, void *arg),
+		       void *arg){
+  int i, j;
+  wheel->tick_ns = tick_ns;
+  wheel->start_ns = wheel_now_ns_perror();
+  wheel->tick = 0;
+  wheel->num_armed = 0;
+  wheel->done = 0;
+  wheel->expire = expire;
+  wheel->arg = arg;
+  for (i = 0; i < WHEEL_LEVELS; i++){
+    for (j = 0; j < WHEEL_SLOTS; j++){
+      wheel->slots[i][j].prev = &wheel->slots[i][j];
+      wheel->slots[i][j].next = &wheel->slots[i][j];
+      wheel->slots[i][j].expiry_ns = 0;
+    }
+  }
+  wheel->num_adds = 0;
+  wheel->num_cancels = 0;
+  wheel->num_expiries = 0;
+  wheel->num_cascades = 0;
+  wheel->num_ticks = 0;
+  mutex_init_perror(&wheel->lock);
+  cond_init_mono_perror(&wheel->cond);
+  thread_create_perror(&wheel->thread, wheel_thread, wheel);
+}
+
+void wheel_add_perror(wheel_t *wheel,
+		      wheel_timer_t *timer,
+		      uint64_t expiry_ns){
+  mutex_lock_perror(&wheel->lock);
+  if (wheel->num_armed == 0){
+    /* skip the ticks of the empty wheel, and wake up the timer thread */
+    wheel->tick = ((wheel_now_ns_perror() - wheel->start_ns) /
+		   wheel->tick_ns + 1);
+    cond_signal_perror(&wheel->cond);
+  }
+  timer->expiry_ns = expiry_ns;
+  wheel_place(wheel, timer);
+  wheel->num_armed++;
+  wheel->num_adds++;
+  mutex_unlock_perror(&wheel->lock);
+}
+
+int wheel_cancel_perror(wheel_t *wheel, wheel_timer_t *timer){
+  int armed;
+  mutex_lock_perror(&wheel->lock);
+  armed = (timer->next != NULL);
+  if (armed){
+    wheel_unlink(timer);
+    wheel->num_armed--;
+    wheel->num_cancels++;
+  }
+  mutex_unlock_perror(&wheel->lock);
+  return armed;
+}
+
+void wheel_free_perror(wheel_t *wheel){
+  mutex_lock_perror(&wheel->lock);
+  wheel->done = 1;
+  cond_signal_perror(&wheel->cond);
+  mutex_unlock_perror(&wheel->lock);
+  thread_join_perror(wheel->thread, NULL);
+}
@@ -5,12 +5,17 @@
    1) pthread functions with wrapped error checking, and
    2) an implementation of semaphore operations based on 1),
    adopted from The Little Book of Semaphores by Allen B. Downey
-   (Version 2.2.1) with modifications.
+   (Version 2.2.1) with modifications, and
+   3) a one-shot completion (latch) of a single 32-bit word, with an
+   optional spin before sleeping on a futex on Linux, and
+   4) a hierarchical timing wheel of one-shot timers, with constant-time
+   adding and cancelling of a timer, driven by a timer thread.
 */
 
 #ifndef UTILITIES_PTHREAD_H
 #define UTILITIES_PTHREAD_H
 
+#include <stdint.h>
 #include <pthread.h>
 
 typedef struct{
@@ -20,6 +25,44 @@ typedef struct{
   pthread_cond_t cond; /* the result of referring to a copy is undefined */
 } sema_t; /* the result of referring to a copy of an instance is undefined */
 
+typedef struct{
+  uint32_t state; /* unset, set, or unset with a sleeping waiter */
+} latch_t; /* the result of referring to a copy of an instance is undefined */
+
+#define WHEEL_BITS (6)
+#define WHEEL_SLOTS (1 << WHEEL_BITS) /* per level */
+#define WHEEL_LEVELS (4) /* WHEEL_SLOTS^WHEEL_LEVELS ticks ahead */
+
+/**
+   A timer of a timing wheel, embedded in the object that it times. A
+   timer is armed while it is in a list of a slot, i.e. while next is not
+   NULL.
+*/
+typedef struct wheel_timer{
+  struct wheel_timer *prev;
+  struct wheel_timer *next;
+  uint64_t expiry_ns; /* of the monotonic clock */
+} wheel_timer_t;
+
+typedef struct{
+  uint64_t tick_ns;
+  uint64_t start_ns; /* start of tick 0 */
+  uint64_t tick; /* next tick to expire */
+  int num_armed;
+  int done;
+  void (*expire)(wheel_timer_t *timer, void *arg);
+  void *arg;
+  wheel_timer_t slots[WHEEL_LEVELS][WHEEL_SLOTS]; /* list heads */
+  pthread_mutex_t lock; /* the result of referring to a copy is undefined */
+  pthread_cond_t cond; /* the result of referring to a copy is undefined */
+  pthread_t thread;
+  unsigned long num_adds;
+  unsigned long num_cancels;
+  unsigned long num_expiries;
+  unsigned long num_cascades; /* timers moved to a lower level */
+  unsigned long num_ticks; /* ticks expired while timers were armed */
+} wheel_t; /* the result of referring to a copy of an instance is undefined */
+
 
 /**
    Create a thread with default attributes and error checking. Join a thread
@@ -44,7 +87,8 @@ void mutex_unlock_perror(pthread_mutex_t *mutex);
 
 /**
    Initialize a condition variable with default attributes and
-   error checking. Wait on and signal a condition with error checking.
+   error checking. Wait on, signal, and broadcast a condition with error
+   checking.
 */
 
 void cond_init_perror(pthread_cond_t *cond);
@@ -53,9 +97,54 @@ void cond_wait_perror(pthread_cond_t *cond, pthread_mutex_t *mutex);
 
 void cond_signal_perror(pthread_cond_t *cond);
 
+void cond_broadcast_perror(pthread_cond_t *cond);
+
+/**
+   Initialize a condition variable for timed waits on the monotonic clock
+   with error checking. Wait on such a condition until deadline_ns of the
+   monotonic clock with error checking; returns 0 if woken up before the
+   deadline, and -1 if the deadline passed.
+*/
+
+void cond_init_mono_perror(pthread_cond_t *cond);
+
+int cond_timedwait_mono_perror(pthread_cond_t *cond,
+			       pthread_mutex_t *mutex,
+			       uint64_t deadline_ns);
+
+/**
+   Initialize a mutex and a condition variable with the process-shared
+   attribute and error checking, e.g. in a shared memory segment that is
+   mapped by several processes. The mutex is robust, so that a process
+   that dies while holding it does not block the other processes, and the
+   condition variable waits on the monotonic clock.
+
+   Lock such a mutex, and wait on such a condition until signaled or until
+   deadline_ns of the monotonic clock, with error checking. Each returns 1
+   if the mutex was acquired after its owner died, in which case the mutex
+   is made consistent and the state that it protects may be partially
+   updated, and 0 otherwise; the timed wait returns -1 if the deadline
+   passed. Unlocked and signaled with the functions above.
+*/
+
+void mutex_init_pshared_perror(pthread_mutex_t *mutex);
+
+void cond_init_pshared_perror(pthread_cond_t *cond);
+
+int mutex_lock_robust_perror(pthread_mutex_t *mutex);
+
+int cond_wait_robust_perror(pthread_cond_t *cond, pthread_mutex_t *mutex);
+
+int cond_timedwait_robust_perror(pthread_cond_t *cond,
+				 pthread_mutex_t *mutex,
+				 uint64_t deadline_ns);
+
 /**
    Initialize, wait on, and signal a semaphore with error checking
    provided by mutex and condition variable operations.
+   sema_trywait_n_perror decrements the semaphore by up to n without
+   blocking and returns the decrement, and sema_signal_n_perror
+   increments the semaphore by n, each with a single mutex acquisition.
 */
 
 void sema_init_perror(sema_t *sema, int value);
@@ -64,4 +153,66 @@ void sema_wait_perror(sema_t *sema);
 
 void sema_signal_perror(sema_t *sema);
 
+int sema_trywait_n_perror(sema_t *sema, int n);
+
+void sema_signal_n_perror(sema_t *sema, int n);
+
+/**
+   Hint to the processor that the calling thread is in a spin-wait loop,
+   with the pause instruction on x86, in order to reduce the power and
+   the memory-order violation penalty of the loop.
+*/
+void cpu_pause(void);
+
+/**
+   Initialize, wait on, set, and reset a one-shot latch for one waiting
+   thread. latch_wait_perror returns after latch_set_perror was called,
+   and polls the latch up to num_spins times before sleeping. Setting a
+   latch is an atomic exchange, followed by a wakeup only if the waiting
+   thread is asleep. A latch may be reused after latch_reset is called by
+   the waiting thread after latch_wait_perror returns.
+*/
+
+void latch_init(latch_t *latch);
+
+void latch_wait_perror(latch_t *latch, int num_spins);
+
+void latch_set_perror(latch_t *latch);
+
+void latch_reset(latch_t *latch);
+
+/**
+   Initialize a timer, disarmed. Initialize a timing wheel with a tick of
+   tick_ns, and start its timer thread, which calls expire(timer, arg) on
+   each timer at the first tick at or after its expiry. expire is called
+   under the lock of the wheel, after the timer is disarmed, and must not
+   call the functions of the wheel.
+
+   wheel_add_perror arms a disarmed timer to expire at expiry_ns of the
+   monotonic clock, where an expiry in the past expires at the next tick.
+   wheel_cancel_perror disarms a timer, and returns 1 if the timer was
+   armed, and 0 if it was expired or not armed; after it returns, expire
+   is not running on the timer. Both run in constant time: a timer is
+   placed in the level of the wheel that covers its expiry, and is moved
+   down a level at most WHEEL_LEVELS - 1 times before it expires.
+
+   wheel_free_perror stops and joins the timer thread; timers that are
+   still armed are not expired.
+*/
+
+void wheel_timer_init(wheel_timer_t *timer);
+
+void wheel_init_perror(wheel_t *wheel,
+		       uint64_t tick_ns,
+		       void (*expire)(wheel_timer_t *timer, void *arg),
+		       void *arg);
+
+void wheel_add_perror(wheel_t *wheel,
+		      wheel_timer_t *timer,
+		      uint64_t expiry_ns);
+
+int wheel_cancel_perror(wheel_t *wheel, wheel_timer_t *timer);
+
+void wheel_free_perror(wheel_t *wheel);
+
 #endif
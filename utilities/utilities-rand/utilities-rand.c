@@ -0,0 +1,102 @@
+/**
+   utilities-rand.c
+
+   Utility functions for pseudo-random number generation without hidden
+   shared state, including
+   1) the xoshiro256** generator by David Blackman and Sebastiano Vigna,
+   with a state that is explicitly seeded and owned by a thread, and a jump
+   function for non-overlapping parallel streams, and
+   2) a stateless counter-based generator, where the n-th number of a
+   stream is a function of a key and n, for reproducible parallel streams
+   independent of the number of threads.
+
+   The generators are adopted from https://prng.di.unimi.it/ with
+   modifications. The counter-based generator applies two rounds of the
+   splitmix64 finalizer to a Weyl sequence offset by the key.
+*/
+
+#include <stdint.h>
+#include "utilities-rand.h"
+
+static const uint64_t C_GOLDEN_GAMMA = 0x9e3779b97f4a7c15UL;
+static const double C_TWO_POW_NEG_53 = 1.0 / 9007199254740992.0;
+
+static uint64_t rotl(uint64_t x, int k){
+  return (x << k) | (x >> (64 - k));
+}
+
+static uint64_t mix64(uint64_t z){
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9UL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebUL;
+  return z ^ (z >> 31);
+}
+
+/**
+   Seed a generator state from a 64-bit seed by using splitmix64.
+*/
+void rng_seed(rng_t *rng, uint64_t seed){
+  int i;
+  for (i = 0; i < 4; i++){
+    seed += C_GOLDEN_GAMMA;
+    rng->s[i] = mix64(seed);
+  }
+}
+
+/**
+   Advance a generator state by 2^128 numbers.
+*/
+void rng_jump(rng_t *rng){
+  static const uint64_t c_jump[4] = {0x180ec6d33cfd0abaUL,
+				     0xd5a61266f0c9392cUL,
+				     0xa9582618e03fc9aaUL,
+				     0x39abdc4529b1661cUL};
+  int i, j;
+  uint64_t s[4] = {0, 0, 0, 0};
+  for (i = 0; i < 4; i++){
+    for (j = 0; j < 64; j++){
+      if (c_jump[i] & (uint64_t)1 << j){
+	s[0] ^= rng->s[0];
+	s[1] ^= rng->s[1];
+	s[2] ^= rng->s[2];
+	s[3] ^= rng->s[3];
+      }
+      rng_next(rng);
+    }
+  }
+  for (i = 0; i < 4; i++){
+    rng->s[i] = s[i];
+  }
+}
+
+/**
+   Return the next 64-bit number, and the next double on [0.0, 1.0).
+*/
+
+uint64_t rng_next(rng_t *rng){
+  uint64_t res = rotl(rng->s[1] * 5, 7) * 9;
+  uint64_t t = rng->s[1] << 17;
+  rng->s[2] ^= rng->s[0];
+  rng->s[3] ^= rng->s[1];
+  rng->s[1] ^= rng->s[2];
+  rng->s[0] ^= rng->s[3];
+  rng->s[2] ^= t;
+  rng->s[3] = rotl(rng->s[3], 45);
+  return res;
+}
+
+double rng_unif(rng_t *rng){
+  return (rng_next(rng) >> 11) * C_TWO_POW_NEG_53;
+}
+
+/**
+   Return the ctr-th 64-bit number and double on [0.0, 1.0) of the stream
+   identified by key.
+*/
+
+uint64_t rng_ctr(uint64_t key, uint64_t ctr){
+  return mix64(mix64(key) + (ctr + 1) * C_GOLDEN_GAMMA);
+}
+
+double rng_ctr_unif(uint64_t key, uint64_t ctr){
+  return (rng_ctr(key, ctr) >> 11) * C_TWO_POW_NEG_53;
+}
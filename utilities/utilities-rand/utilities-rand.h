@@ -0,0 +1,53 @@
+/**
+   utilities-rand.h
+
+   Declarations of accessible utility functions for pseudo-random number
+   generation without hidden shared state, including
+   1) the xoshiro256** generator by David Blackman and Sebastiano Vigna,
+   with a state that is explicitly seeded and owned by a thread, and a jump
+   function for non-overlapping parallel streams, and
+   2) a stateless counter-based generator, where the n-th number of a
+   stream is a function of a key and n, for reproducible parallel streams
+   independent of the number of threads.
+*/
+
+#ifndef UTILITIES_RAND_H
+#define UTILITIES_RAND_H
+
+#include <stdint.h>
+
+typedef struct{
+  uint64_t s[4];
+} rng_t;
+
+/**
+   Seed a generator state from a 64-bit seed by using splitmix64, so that
+   similar seeds result in uncorrelated states.
+*/
+void rng_seed(rng_t *rng, uint64_t seed);
+
+/**
+   Advance a generator state by 2^128 numbers. Calling rng_jump on a copy
+   of a state yields a non-overlapping stream for another thread.
+*/
+void rng_jump(rng_t *rng);
+
+/**
+   Return the next 64-bit number, and the next double on [0.0, 1.0) with
+   53 random bits.
+*/
+
+uint64_t rng_next(rng_t *rng);
+
+double rng_unif(rng_t *rng);
+
+/**
+   Return the ctr-th 64-bit number and double on [0.0, 1.0) of the stream
+   identified by key.
+*/
+
+uint64_t rng_ctr(uint64_t key, uint64_t ctr);
+
+double rng_ctr_unif(uint64_t key, uint64_t ctr);
+
+#endif
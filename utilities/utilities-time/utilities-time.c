@@ -0,0 +1,144 @@
+/**
+   utilities-time.c
+
+   Utility functions for timing, including
+   1) a monotonic nanosecond timer based on clock_gettime with
+   CLOCK_MONOTONIC and wrapped error checking, and
+   2) a time-stamp counter (TSC) cycle counter calibrated against 1), with
+   an overhead-corrected elapsed cycle count. On non-x86 platforms the
+   cycle counter falls back to 1) at one cycle per nanosecond.
+
+   The start and end reads on x86 follow the lfence/rdtsc and rdtscp/lfence
+   pattern to prevent the reordering of the timed instructions with
+   the reads.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include "utilities-time.h"
+
+static const uint64_t C_NS_PER_SEC = 1000000000;
+static const uint64_t C_CAL_NS = 10000000; /* calibration interval */
+static const int C_CAL_OVERHEAD_ITER = 1000;
+
+/**
+   Read the monotonic clock in nanoseconds and in seconds with error
+   checking.
+*/
+
+uint64_t time_mono_ns_perror(void){
+  struct timespec ts;
+  if (clock_gettime(CLOCK_MONOTONIC, &ts) != 0){
+    perror("clock_gettime failed");
+    exit(EXIT_FAILURE);
+  }
+  return (uint64_t)ts.tv_sec * C_NS_PER_SEC + (uint64_t)ts.tv_nsec;
+}
+
+double time_mono_sec_perror(void){
+  return time_mono_ns_perror() / (double)C_NS_PER_SEC;
+}
+
+/**
+   Wait until the monotonic clock reaches t_ns, by sleeping until spin_ns
+   before t_ns and busy waiting afterwards.
+*/
+void time_wait_until_ns_perror(uint64_t t_ns, uint64_t spin_ns){
+  int err;
+  struct timespec ts;
+  if (t_ns > spin_ns && time_mono_ns_perror() < t_ns - spin_ns){
+    ts.tv_sec = (t_ns - spin_ns) / C_NS_PER_SEC;
+    ts.tv_nsec = (t_ns - spin_ns) % C_NS_PER_SEC;
+    do{
+      err = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    }while (err == EINTR);
+    if (err != 0){
+      errno = err;
+      perror("clock_nanosleep failed");
+      exit(EXIT_FAILURE);
+    }
+  }
+  while (time_mono_ns_perror() < t_ns);
+}
+
+/**
+   Read the cycle counter at the start and at the end of a timed interval.
+*/
+
+#if defined(__x86_64__) || defined(__i386__)
+
+uint64_t tsc_start(void){
+  uint32_t lo, hi;
+  __asm__ __volatile__ ("lfence\n\t"
+			"rdtsc"
+			: "=a" (lo), "=d" (hi)
+			:
+			: "memory");
+  return ((uint64_t)hi << 32) | lo;
+}
+
+uint64_t tsc_end(void){
+  uint32_t lo, hi;
+  __asm__ __volatile__ ("rdtscp\n\t"
+			"lfence"
+			: "=a" (lo), "=d" (hi)
+			:
+			: "ecx", "memory");
+  return ((uint64_t)hi << 32) | lo;
+}
+
+#else
+
+uint64_t tsc_start(void){
+  return time_mono_ns_perror();
+}
+
+uint64_t tsc_end(void){
+  return time_mono_ns_perror();
+}
+
+#endif
+
+/**
+   Calibrate the cycle counter against the monotonic clock and measure the
+   overhead of a start/end read pair as the minimum over a number of
+   back-to-back pairs, in order to exclude interrupts and migrations.
+*/
+void tsc_calibrate(tsc_cal_t *cal){
+  int i;
+  uint64_t t0, t1, c0, c1;
+  uint64_t start, end;
+  t0 = time_mono_ns_perror();
+  c0 = tsc_start();
+  do{
+    t1 = time_mono_ns_perror();
+  }while (t1 - t0 < C_CAL_NS);
+  c1 = tsc_end();
+  cal->cycles_per_ns = (double)(c1 - c0) / (t1 - t0);
+  cal->overhead = (uint64_t)-1;
+  for (i = 0; i < C_CAL_OVERHEAD_ITER; i++){
+    start = tsc_start();
+    end = tsc_end();
+    if (end >= start && end - start < cal->overhead){
+      cal->overhead = end - start;
+    }
+  }
+  if (cal->overhead == (uint64_t)-1) cal->overhead = 0;
+}
+
+/**
+   Return the overhead-corrected number of cycles between start and end
+   reads, and convert a number of cycles to nanoseconds.
+*/
+
+uint64_t tsc_elapsed(const tsc_cal_t *cal, uint64_t start, uint64_t end){
+  if (end < start || end - start < cal->overhead) return 0;
+  return end - start - cal->overhead;
+}
+
+double tsc_to_ns(const tsc_cal_t *cal, uint64_t cycles){
+  return cycles / cal->cycles_per_ns;
+}
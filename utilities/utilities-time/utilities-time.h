@@ -0,0 +1,65 @@
+/**
+   utilities-time.h
+
+   Declarations of accessible utility functions for timing, including
+   1) a monotonic nanosecond timer based on clock_gettime with
+   CLOCK_MONOTONIC and wrapped error checking, and
+   2) a time-stamp counter (TSC) cycle counter calibrated against 1), with
+   an overhead-corrected elapsed cycle count. On non-x86 platforms the
+   cycle counter falls back to 1) at one cycle per nanosecond.
+*/
+
+#ifndef UTILITIES_TIME_H
+#define UTILITIES_TIME_H
+
+#include <stdint.h>
+
+typedef struct{
+  double cycles_per_ns;
+  uint64_t overhead; /* cycles of a back-to-back start/end read pair */
+} tsc_cal_t;
+
+/**
+   Read the monotonic clock in nanoseconds and in seconds with error
+   checking. The values are relative to an unspecified point in the past
+   and are not affected by discontinuous jumps in the system time.
+*/
+
+uint64_t time_mono_ns_perror(void);
+
+double time_mono_sec_perror(void);
+
+/**
+   Wait until the monotonic clock reaches t_ns, by sleeping until spin_ns
+   before t_ns and busy waiting afterwards, for accuracy beyond the wakeup
+   latency of a sleep. Returns immediately if t_ns is in the past.
+*/
+void time_wait_until_ns_perror(uint64_t t_ns, uint64_t spin_ns);
+
+/**
+   Read the cycle counter at the start and at the end of a timed interval.
+   The start read is not reordered with the subsequent instructions and
+   the end read is not reordered with the preceding instructions.
+*/
+
+uint64_t tsc_start(void);
+
+uint64_t tsc_end(void);
+
+/**
+   Calibrate the cycle counter against the monotonic clock and measure the
+   overhead of a start/end read pair. Calibration takes about 10 ms.
+*/
+
+void tsc_calibrate(tsc_cal_t *cal);
+
+/**
+   Return the overhead-corrected number of cycles between start and end
+   reads, and convert a number of cycles to nanoseconds.
+*/
+
+uint64_t tsc_elapsed(const tsc_cal_t *cal, uint64_t start, uint64_t end);
+
+double tsc_to_ns(const tsc_cal_t *cal, uint64_t cycles);
+
+#endif